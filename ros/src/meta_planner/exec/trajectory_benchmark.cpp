@@ -0,0 +1,313 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Benchmarks Trajectory, stored as shared contiguous segments, against a
+// std::map of per-waypoint heap-allocated states. Times stitching
+// segments together (as in WaypointTree::BestTrajectory), round trips
+// through ROS messages (nested and flat) and interpolation, reports heap and
+// wire bytes per waypoint, and checks that both layouts agree.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <meta_planner/trajectory.h>
+
+#include <ros/ros.h>
+#include <ros/serialization.h>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <map>
+#include <random>
+
+// Count heap bytes requested through operator new, portably. Each block
+// records its size just before the pointer handed out.
+namespace {
+
+std::atomic<size_t> heap_in_use(0);
+const size_t kHeapPrefix = 16;
+
+// Bytes of heap currently in use, not counting allocator overhead.
+size_t HeapInUse() { return heap_in_use; }
+
+} //\namespace
+
+void* operator new(size_t size) {
+  char* block = static_cast<char*>(std::malloc(size + kHeapPrefix));
+  if (!block)
+    throw std::bad_alloc();
+
+  *reinterpret_cast<size_t*>(block) = size;
+  heap_in_use += size;
+  return block + kHeapPrefix;
+}
+
+void* operator new[](size_t size) { return operator new(size); }
+
+void operator delete(void* ptr) noexcept {
+  if (!ptr)
+    return;
+
+  char* block = static_cast<char*>(ptr) - kHeapPrefix;
+  heap_in_use -= *reinterpret_cast<size_t*>(block);
+  std::free(block);
+}
+
+void operator delete[](void* ptr) noexcept { operator delete(ptr); }
+
+namespace {
+
+// Map-based trajectory, laid out as Trajectory used to be.
+struct MapTrajectory {
+  struct StateValue {
+    meta::VectorXd state_;
+    meta::ValueFunctionId control_value_;
+    meta::ValueFunctionId bound_value_;
+  };
+
+  std::map<double, StateValue> map_;
+
+  void Add(double time, const meta::VectorXd& state,
+           meta::ValueFunctionId control_value,
+           meta::ValueFunctionId bound_value) {
+    map_.insert({ time, StateValue{ state, control_value, bound_value } });
+  }
+
+  void Add(const MapTrajectory& other) {
+    map_.insert(other.map_.begin(), other.map_.end());
+  }
+
+  meta::VectorXd GetState(double time) const {
+    auto iter = map_.lower_bound(time);
+    if (iter == map_.end())
+      return (--iter)->second.state_;
+    if (iter->first == time || iter == map_.begin())
+      return iter->second.state_;
+
+    const double upper_time = iter->first;
+    const meta::VectorXd& upper_state = iter->second.state_;
+    iter--;
+    return iter->second.state_ + (upper_state - iter->second.state_) *
+      (time - iter->first) / (upper_time - iter->first);
+  }
+
+  meta_planner_msgs::Trajectory ToRosMessage() const {
+    meta_planner_msgs::Trajectory msg;
+    msg.num_waypoints = map_.size();
+    for (const auto& pair : map_) {
+      msg.states.push_back(meta::utils::PackState(pair.second.state_));
+      msg.times.push_back(pair.first);
+      msg.control_value_function_ids.push_back(pair.second.control_value_);
+      msg.bound_value_function_ids.push_back(pair.second.bound_value_);
+    }
+
+    return msg;
+  }
+
+  static MapTrajectory Create(const meta_planner_msgs::Trajectory& msg) {
+    MapTrajectory traj;
+    for (size_t ii = 0; ii < msg.num_waypoints; ii++)
+      traj.Add(msg.times[ii], meta::utils::Unpack(msg.states[ii]),
+               msg.control_value_function_ids[ii],
+               msg.bound_value_function_ids[ii]);
+
+    return traj;
+  }
+};
+
+} //\namespace
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "trajectory_benchmark");
+  ros::NodeHandle n("~");
+
+  int num_segments, segment_size, state_dim, num_queries, num_trials, seed;
+  n.param("num_segments", num_segments, 100);
+  n.param("segment_size", segment_size, 20);
+  n.param("state_dim", state_dim, 6);
+  n.param("num_queries", num_queries, 100000);
+  n.param("num_trials", num_trials, 20);
+  n.param("random/seed", seed, 0);
+
+  if (num_segments < 1 || segment_size < 2 || state_dim < 3) {
+    ROS_ERROR("%s: Need at least one segment of two 3D waypoints.",
+              ros::this_node::getName().c_str());
+    return EXIT_FAILURE;
+  }
+
+  typedef std::chrono::steady_clock Clock;
+  const auto seconds = [](const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  };
+
+  // Random segments which meet end to end, one time unit each, as a
+  // planner would produce between waypoints.
+  std::default_random_engine rng(seed);
+  std::uniform_real_distribution<double> unif(-1.0, 1.0);
+
+  std::vector<meta::Trajectory::ConstPtr> segments;
+  std::vector<MapTrajectory> map_segments(num_segments);
+  meta::VectorXd state = meta::VectorXd::Zero(state_dim);
+  for (int ii = 0; ii < num_segments; ii++) {
+    const meta::Trajectory::Ptr segment = meta::Trajectory::Create();
+    for (int jj = 0; jj < segment_size; jj++) {
+      const double time = ii + static_cast<double>(jj) / (segment_size - 1);
+      if (jj > 0)
+        state += 0.1 * meta::VectorXd::NullaryExpr(state_dim, [&]() {
+          return unif(rng); });
+
+      segment->Add(time, state, ii, ii);
+      map_segments[ii].Add(time, state, ii, ii);
+    }
+
+    segments.push_back(segment);
+  }
+
+  // (1) Stitch segments together, as WaypointTree::BestTrajectory does. The
+  // map was built by adding segments back to front.
+  meta::Trajectory::Ptr traj;
+  auto start = Clock::now();
+  for (int kk = 0; kk < num_trials; kk++)
+    traj = meta::Trajectory::Create(segments);
+  const double stitch_time = seconds(start) / num_trials;
+
+  MapTrajectory map_traj;
+  start = Clock::now();
+  for (int kk = 0; kk < num_trials; kk++) {
+    map_traj = MapTrajectory();
+    for (int ii = num_segments - 1; ii >= 0; ii--)
+      map_traj.Add(map_segments[ii]);
+  }
+  const double map_stitch_time = seconds(start) / num_trials;
+
+  // Heap held by one more copy of each.
+  size_t bytes = HeapInUse();
+  const meta::Trajectory::ConstPtr traj_copy =
+    meta::Trajectory::Create(segments);
+  const double bytes_per_waypoint =
+    static_cast<double>(HeapInUse() - bytes) / traj_copy->Size();
+
+  bytes = HeapInUse();
+  MapTrajectory map_traj_copy;
+  for (int ii = num_segments - 1; ii >= 0; ii--)
+    map_traj_copy.Add(map_segments[ii]);
+  const double map_bytes_per_waypoint =
+    static_cast<double>(HeapInUse() - bytes) / map_traj_copy.map_.size();
+
+  // (2) Round trip through a ROS message.
+  start = Clock::now();
+  for (int kk = 0; kk < num_trials; kk++) {
+    const meta_planner_msgs::Trajectory::ConstPtr msg(
+      new meta_planner_msgs::Trajectory(traj->ToRosMessage()));
+    traj = meta::Trajectory::Create(msg);
+  }
+  const double message_time = seconds(start) / num_trials;
+
+  start = Clock::now();
+  for (int kk = 0; kk < num_trials; kk++) {
+    const meta_planner_msgs::FlatTrajectory::ConstPtr msg(
+      new meta_planner_msgs::FlatTrajectory(traj->ToFlatRosMessage()));
+    traj = meta::Trajectory::Create(msg);
+  }
+  const double flat_message_time = seconds(start) / num_trials;
+
+  // Serialized size of each message format.
+  const double wire_bytes_per_waypoint = static_cast<double>(
+    ros::serialization::serializationLength(traj->ToRosMessage())) /
+    traj->Size();
+  const double flat_wire_bytes_per_waypoint = static_cast<double>(
+    ros::serialization::serializationLength(traj->ToFlatRosMessage())) /
+    traj->Size();
+
+  start = Clock::now();
+  for (int kk = 0; kk < num_trials; kk++)
+    map_traj = MapTrajectory::Create(map_traj.ToRosMessage());
+  const double map_message_time = seconds(start) / num_trials;
+
+  // (3) Interpolate at random times.
+  std::uniform_real_distribution<double> unif_time(
+    traj->FirstTime(), traj->LastTime());
+  std::vector<double> times(num_queries);
+  for (auto& time : times)
+    time = unif_time(rng);
+
+  double checksum = 0.0;
+  start = Clock::now();
+  for (const double time : times)
+    checksum += traj->GetState(time)(0);
+  const double query_time = seconds(start);
+
+  double map_checksum = 0.0;
+  start = Clock::now();
+  for (const double time : times)
+    map_checksum += map_traj.GetState(time)(0);
+  const double map_query_time = seconds(start);
+
+  // Check that both layouts hold the same trajectory.
+  double max_difference = std::abs(checksum - map_checksum);
+  bool same_waypoints = traj->Size() == map_traj.map_.size();
+  for (const double time : times)
+    max_difference = std::max(max_difference, (traj->GetState(time) -
+                                               map_traj.GetState(time))
+                              .cwiseAbs().maxCoeff());
+  for (const auto& pair : map_traj.map_)
+    same_waypoints &= traj->GetControlValueFunction(pair.first) ==
+      pair.second.control_value_;
+
+  ROS_INFO("%s: %zu waypoints of dimension %d.",
+           ros::this_node::getName().c_str(), traj->Size(), state_dim);
+  ROS_INFO("Stitch: map %.3g ms, trajectory %.3g ms (%.2fx).",
+           1e3 * map_stitch_time, 1e3 * stitch_time,
+           map_stitch_time / stitch_time);
+  ROS_INFO("Message round trip: map %.3g ms, trajectory %.3g ms (%.2fx), "
+           "flat %.3g ms (%.2fx).",
+           1e3 * map_message_time, 1e3 * message_time,
+           map_message_time / message_time, 1e3 * flat_message_time,
+           map_message_time / flat_message_time);
+  ROS_INFO("Wire bytes per waypoint: nested %.1f, flat %.1f.",
+           wire_bytes_per_waypoint, flat_wire_bytes_per_waypoint);
+  ROS_INFO("GetState: map %.3g ns, trajectory %.3g ns (%.2fx).",
+           1e9 * map_query_time / num_queries,
+           1e9 * query_time / num_queries, map_query_time / query_time);
+  ROS_INFO("Heap bytes per waypoint: map %.1f, trajectory %.1f.",
+           map_bytes_per_waypoint, bytes_per_waypoint);
+  ROS_INFO("Waypoints %s, max state difference %g.",
+           same_waypoints ? "match" : "DIFFER", max_difference);
+
+  return same_waypoints ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -49,6 +49,7 @@
 #include <utils/types.h>
 
 #include <vector>
+#include <map>
 
 namespace meta {
 
@@ -69,6 +70,12 @@ public:
                ValueFunctionId incoming_value,
                ValueFunctionId outgoing_value) const;
 
+  // Check a whole segment exactly, by sweeping the tracking bound along it
+  // against each obstacle. Takes in incoming and outgoing value functions.
+  bool IsValidSegment(const Vector3d& start, const Vector3d& stop,
+                      ValueFunctionId incoming_value,
+                      ValueFunctionId outgoing_value) const;
+
   // Check for obstacles within a sensing radius. Returns true if at least
   // one obstacle was sensed.
   bool SenseObstacles(const Vector3d& position, double sensor_radius,
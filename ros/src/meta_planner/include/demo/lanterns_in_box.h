@@ -68,7 +68,8 @@ public:
 
   // Set the frame ids and radius of all lanterns. Optionally change the rate
   // at which we query tf for new obstacle locations.
-  bool Initialize(const ros::NodeHandle& n);
+  bool Initialize(const ros::NodeHandle& n,
+                  const ValueFunctionProvider::ConstPtr& values);
   
   // Timer callback to update lantern positions.
   void TimerCallback(const ros::TimerEvent& e);
@@ -82,6 +83,12 @@ public:
                ValueFunctionId incoming_value,
                ValueFunctionId outgoing_value) const;
 
+  // Check a whole segment exactly, by sweeping the tracking bound along it
+  // against each obstacle. Takes in incoming and outgoing value functions.
+  bool IsValidSegment(const Vector3d& start, const Vector3d& stop,
+                      ValueFunctionId incoming_value,
+                      ValueFunctionId outgoing_value) const;
+
   // Check for obstacles within a sensing radius. Returns true if at least
   // one obstacle was sensed.
   bool SenseObstacles(const Vector3d& position, double sensor_radius,
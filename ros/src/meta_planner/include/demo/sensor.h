@@ -104,6 +104,9 @@ private:
   ros::Timer timer_;
   double time_step_;
 
+  // Environment visualization is rate limited, and skipped if unchanged.
+  double env_vis_period_;
+
   // Publishers/subscribers and related topics.
   ros::Publisher sensor_radius_pub_;
   ros::Publisher environment_pub_;
@@ -50,6 +50,9 @@
 #include <memory>
 #include <algorithm>
 #include <random>
+#include <array>
+#include <limits>
+#include <cmath>
 
 namespace meta {
 
@@ -65,7 +68,8 @@ public:
   virtual ~Box() {}
 
   // Inherited from Environment, but can be overwritten by child classes.
-  virtual Vector3d Sample() const;
+  using Environment::Sample;
+  virtual Vector3d Sample(std::default_random_engine& rng) const;
 
   // Inherited from Environment, but can be overwritten by child classes.
   // Returns true if the state is a valid configuration.
@@ -74,6 +78,12 @@ public:
                        ValueFunctionId incoming_value,
                        ValueFunctionId outgoing_value) const;
 
+  // Inherited from Environment, but can be overwritten by child classes.
+  // Since the box is convex, a segment is valid if its endpoints are.
+  virtual bool IsValidSegment(const Vector3d& start, const Vector3d& stop,
+                              ValueFunctionId incoming_value,
+                              ValueFunctionId outgoing_value) const;
+
   // Inherited by Environment, but can be overwritten by child classes.
   // Assumes that the first <=3 dimensions correspond to R^3.
   virtual void Visualize(const ros::Publisher& pub,
@@ -89,6 +99,13 @@ public:
 protected:
   explicit Box();
 
+  // Squared distance from a point to a box with the given half-widths,
+  // swept along the segment from start to stop.
+  static double SweptBoxSquaredDistance(const Vector3d& start,
+                                        const Vector3d& stop,
+                                        const Vector3d& bound,
+                                        const Vector3d& point);
+
   // Bounds.
   Vector3d lower_;
   Vector3d upper_;
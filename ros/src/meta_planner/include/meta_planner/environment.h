@@ -45,11 +45,11 @@
 
 #include <utils/types.h>
 #include <utils/uncopyable.h>
-
-#include <value_function_srvs/SwitchingTrackingBoundBox.h>
+#include <value_function/value_function_provider.h>
 
 #include <ros/ros.h>
 #include <visualization_msgs/Marker.h>
+#include <visualization_msgs/MarkerArray.h>
 #include <random>
 #include <string>
 
@@ -59,14 +59,21 @@ class Environment : private Uncopyable {
 public:
   virtual ~Environment() {}
 
-  // Initialize this class from a ROS node.
-  virtual bool Initialize(const ros::NodeHandle& n);
+  // Initialize this class from a ROS node. The value function provider is
+  // used for collision checking and may be null if IsValid is never called.
+  virtual bool Initialize(const ros::NodeHandle& n,
+                          const ValueFunctionProvider::ConstPtr& values);
 
   // Re-seed the random engine.
   inline void Seed(unsigned int seed) const { rng_.seed(seed); }
 
-  // Derived classes must be able to sample uniformly from the state space.
-  virtual Vector3d Sample() const = 0;
+  // Derived classes must be able to sample uniformly from the state space,
+  // using the given random engine. Threads sampling at once must each
+  // bring their own.
+  virtual Vector3d Sample(std::default_random_engine& rng) const = 0;
+
+  // Sample with this environment's own random engine.
+  inline Vector3d Sample() const { return Sample(rng_); }
 
   // Derived classes must provide a collision checker which returns true if
   // and only if the provided position is a valid collision-free configuration.
@@ -75,27 +82,50 @@ public:
                        ValueFunctionId incoming_value,
                        ValueFunctionId outgoing_value) const = 0;
 
-  // Derived classes must have some sort of visualization through RVIZ.
+  // Derived classes must also check whole straight-line segments exactly,
+  // returning true if and only if every position on the segment is valid.
+  virtual bool IsValidSegment(const Vector3d& start, const Vector3d& stop,
+                              ValueFunctionId incoming_value,
+                              ValueFunctionId outgoing_value) const = 0;
+
+  // Derived classes must have some sort of visualization through RVIZ,
+  // published as a single visualization_msgs::MarkerArray.
   virtual void Visualize(const ros::Publisher& pub,
                          const std::string& frame_id) const = 0;
 
+  // Visualize, but only if this environment has changed since it was last
+  // visualized, and no sooner than min_period seconds after that.
+  void ThrottledVisualize(const ros::Publisher& pub,
+                          const std::string& frame_id,
+                          double min_period) const;
+
+  // Number of times the obstacles or bounds have changed.
+  inline size_t Version() const { return version_; }
+
 protected:
   explicit Environment()
     : rng_(rd_()),
+      version_(1),
+      visualized_version_(0),
       initialized_(false) {}
 
   // Load parameters and register callbacks.
   virtual bool LoadParameters(const ros::NodeHandle& n);
   virtual bool RegisterCallbacks(const ros::NodeHandle& n);
 
-  // Server to query value functions for tracking bound.
-  mutable ros::ServiceClient switching_bound_srv_;
-  std::string switching_bound_name_;
+  // Value functions, queried for tracking bound.
+  ValueFunctionProvider::ConstPtr values_;
 
   // Random number generation.
   std::random_device rd_;
   mutable std::default_random_engine rng_;
 
+  // Derived classes must increment the version whenever they change. The
+  // version and time of the last visualization are kept for throttling.
+  size_t version_;
+  mutable size_t visualized_version_;
+  mutable ros::Time visualized_time_;
+
   // Initialization and naming.
   bool initialized_;
   std::string name_;
@@ -48,26 +48,31 @@
 #include <meta_planner/waypoint_tree.h>
 #include <meta_planner/waypoint.h>
 #include <meta_planner/ompl_planner.h>
+#include <meta_planner/polynomial_trajectory.h>
 #include <meta_planner/environment.h>
 #include <value_function/near_hover_quad_no_yaw.h>
+#include <value_function/value_function_provider.h>
 #include <utils/types.h>
 #include <utils/uncopyable.h>
 #include <demo/balls_in_box.h>
 
 #include <meta_planner_msgs/Trajectory.h>
+#include <meta_planner_msgs/FlatTrajectory.h>
+#include <meta_planner_msgs/TrajectoryPatch.h>
+#include <meta_planner_msgs/PolynomialTrajectory.h>
 #include <meta_planner_msgs/TrajectoryRequest.h>
 #include <meta_planner_msgs/SensorMeasurement.h>
 #include <crazyflie_msgs/PositionVelocityStateStamped.h>
 
-#include <value_function_srvs/TrackingBoundBox.h>
-#include <value_function_srvs/GeometricPlannerTime.h>
-#include <value_function_srvs/GuaranteedSwitchingTime.h>
-#include <value_function_srvs/GuaranteedSwitchingDistance.h>
-
 #include <ros/ros.h>
 #include <std_msgs/Empty.h>
 #include <vector>
 #include <limits>
+#include <algorithm>
+#include <random>
+#include <atomic>
+#include <thread>
+#include <future>
 
 namespace meta {
 
@@ -110,6 +115,21 @@ private:
   // meta planning was successful.
   bool Plan(const Vector3d& start, const Vector3d& stop, double start_time);
 
+  // Plan from start to stop with all the given planners at once, listed in
+  // order of preference. Returns the first success in that order, and sets
+  // the ID of the planner which found it.
+  PolynomialTrajectory::Ptr PlanSpeculatively(
+    const std::vector<size_t>& candidates,
+    const Vector3d& start, const Vector3d& stop,
+    double start_time, size_t& planner_id) const;
+
+  // Publish a trajectory in each format that anyone is listening for: the
+  // polynomials as planned, or sampled at their knots. As a patch, it only
+  // carries what changed since the last trajectory sent, so call this before
+  // updating traj_.
+  void Publish(const Trajectory::ConstPtr& traj,
+               const PolynomialTrajectory::ConstPtr& poly) const;
+
   // Dynamics.
   NearHoverQuadNoYaw::ConstPtr dynamics_;
 
@@ -144,20 +164,25 @@ private:
   // Maximum distance between waypoints.
   double max_connection_radius_;
 
-  // Services and names.
-  ros::ServiceClient bound_srv_;
-  ros::ServiceClient best_time_srv_;
-  ros::ServiceClient switching_time_srv_;
-  ros::ServiceClient switching_distance_srv_;
+  // Number of threads extending the tree at once, and where their random
+  // engines' seeds come from.
+  size_t num_threads_;
+  std::default_random_engine rng_;
+
+  // Whether to run all candidate planners for a sample at once, rather than
+  // one after another.
+  bool speculative_planning_;
 
-  std::string bound_name_;
-  std::string best_time_name_;
-  std::string switching_time_name_;
-  std::string switching_distance_name_;
+  // Value functions, either in-process or behind a server.
+  ValueFunctionProvider::ConstPtr values_;
 
   // Publishers/subscribers and related topics.
   ros::Publisher traj_pub_;
+  ros::Publisher flat_traj_pub_;
+  ros::Publisher traj_patch_pub_;
+  ros::Publisher poly_traj_pub_;
   ros::Publisher env_pub_;
+  double env_vis_period_;
   ros::Publisher trigger_replan_pub_;
   ros::Subscriber state_sub_;
   ros::Subscriber sensor_sub_;
@@ -165,6 +190,9 @@ private:
   ros::Subscriber in_flight_sub_;
 
   std::string traj_topic_;
+  std::string flat_traj_topic_;
+  std::string traj_patch_topic_;
+  std::string poly_traj_topic_;
   std::string env_topic_;
   std::string state_topic_;
   std::string sensor_topic_;
@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the OmplMotionValidator class, which checks whole straight-line
+// motions for OMPL planners exactly, by sweeping the tracking bound along
+// each motion against the environment. This replaces OMPL's default
+// discrete motion validator, which checks many states along each motion
+// and can miss obstacles that fall between them.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef META_PLANNER_OMPL_MOTION_VALIDATOR_H
+#define META_PLANNER_OMPL_MOTION_VALIDATOR_H
+
+#include <meta_planner/box.h>
+#include <utils/types.h>
+
+#include <ompl/base/MotionValidator.h>
+#include <ompl/base/SpaceInformation.h>
+#include <ompl/base/spaces/RealVectorStateSpace.h>
+#include <memory>
+#include <utility>
+
+namespace meta {
+
+namespace ob = ompl::base;
+
+class OmplMotionValidator : public ob::MotionValidator {
+public:
+  typedef std::shared_ptr<OmplMotionValidator> Ptr;
+  typedef std::shared_ptr<const OmplMotionValidator> ConstPtr;
+
+  ~OmplMotionValidator() {}
+
+  // Factory method. Use this instead of the constructor. Motions are checked
+  // in the given environment with the given value functions.
+  static Ptr Create(const ob::SpaceInformationPtr& si,
+                    const Box::ConstPtr& space,
+                    ValueFunctionId incoming_value,
+                    ValueFunctionId outgoing_value);
+
+  // Check whether the straight motion from s1 to s2 is valid.
+  bool checkMotion(const ob::State* s1, const ob::State* s2) const;
+
+  // Same, but if it is not valid, also find the last valid state and the
+  // fraction of the motion where it occurs.
+  bool checkMotion(const ob::State* s1, const ob::State* s2,
+                   std::pair<ob::State*, double>& last_valid) const;
+
+private:
+  explicit OmplMotionValidator(const ob::SpaceInformationPtr& si,
+                               const Box::ConstPtr& space,
+                               ValueFunctionId incoming_value,
+                               ValueFunctionId outgoing_value);
+
+  // Convert between OMPL states and Vector3ds.
+  static Vector3d FromOmplState(const ob::State* state);
+
+  // Environment and value functions to check against.
+  const Box::ConstPtr space_;
+  const ValueFunctionId incoming_value_;
+  const ValueFunctionId outgoing_value_;
+};
+
+} //\namespace meta
+
+#endif
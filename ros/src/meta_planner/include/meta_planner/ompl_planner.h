@@ -42,7 +42,13 @@
 // an instance of the Box subclass of Environment.
 //
 // We follow these ( http://ompl.kavrakilab.org/geometricPlanningSE3.html )
-// instructions for using OMPL geometric planners.
+// instructions for using OMPL geometric planners, except that motions are
+// checked exactly by an OmplMotionValidator. Before searching, we try
+// connecting start and stop directly with a straight line, since most
+// queries are short and often unobstructed. Since planning queries
+// arrive many times per meta-plan and from several threads at once, each
+// OmplPlanner keeps a pool of fully configured OMPL setups which are only
+// cleared between queries.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
@@ -51,16 +57,20 @@
 
 #include <meta_planner/planner.h>
 #include <meta_planner/box.h>
+#include <meta_planner/ompl_motion_validator.h>
 #include <utils/types.h>
 
 #include <ompl/geometric/planners/rrt/RRTConnect.h>
 #include <ompl/geometric/planners/bitstar/BITstar.h>
 
 #include <ompl/geometric/SimpleSetup.h>
+#include <ompl/base/PlannerTerminationCondition.h>
 #include <ompl/base/TypedSpaceInformation.h>
 #include <ompl/base/SpaceInformation.h>
 #include <ompl/base/spaces/RealVectorStateSpace.h>
 #include <memory>
+#include <mutex>
+#include <vector>
 
 namespace meta {
 
@@ -78,10 +88,10 @@ public:
                              const Dynamics::ConstPtr& dynamics);
 
   // Derived classes must plan trajectories between two points.
-  Trajectory::Ptr Plan(const Vector3d& start,
-                       const Vector3d& stop,
-                       double start_time = 0.0,
-                       double budget = 1.0) const;
+  PolynomialTrajectory::Ptr PlanPolynomial(
+    const Vector3d& start, const Vector3d& stop,
+    double start_time = 0.0, double budget = 1.0,
+    const CancelFunction& cancel = CancelFunction()) const;
 
 private:
   explicit OmplPlanner(ValueFunctionId incoming_value,
@@ -91,6 +101,25 @@ private:
 
   // Convert between OMPL states and Vector3ds.
   Vector3d FromOmplState(const ob::State* state) const;
+
+  // A configured OMPL state space, validity checker and planner, along
+  // with the environment bounds it was built for. Obstacles are checked
+  // through the environment, so a setup only depends on the bounds.
+  struct Setup {
+    std::shared_ptr<ob::RealVectorStateSpace> space_;
+    std::unique_ptr<og::SimpleSetup> simple_setup_;
+    Vector3d lower_;
+    Vector3d upper_;
+  };
+
+  // Take a setup out of the pool, building a new one if none are free or
+  // the environment's bounds have changed. Return it to the pool when done.
+  std::unique_ptr<Setup> AcquireSetup() const;
+  void ReleaseSetup(std::unique_ptr<Setup> setup) const;
+
+  // Setups not currently in use. Grows to the number of concurrent queries.
+  mutable std::vector< std::unique_ptr<Setup> > pool_;
+  mutable std::mutex pool_mutex_;
 };
 
 // ------------------------------- IMPLEMENTATION --------------------------- //
@@ -116,9 +145,10 @@ Create(ValueFunctionId incoming_value,
 
 // Derived classes must plan trajectories between two points.
 template<typename PlannerType>
-Trajectory::Ptr OmplPlanner<PlannerType>::
-Plan(const Vector3d& start, const Vector3d& stop,
-     double start_time, double budget) const {
+PolynomialTrajectory::Ptr OmplPlanner<PlannerType>::
+PlanPolynomial(const Vector3d& start, const Vector3d& stop,
+               double start_time, double budget,
+               const CancelFunction& cancel) const {
   // Check that both start and stop are in bounds.
   if (!space_->IsValid(start, incoming_value_, outgoing_value_)) {
     ROS_WARN_THROTTLE(1.0, "Start point was in collision or out of bounds.");
@@ -130,32 +160,28 @@ Plan(const Vector3d& start, const Vector3d& stop,
     return nullptr;
   }
 
-  // Create the OMPL state space corresponding to this environment.
-  auto ompl_space(
-    std::make_shared<ob::RealVectorStateSpace>(3));
+  num_queries_++;
 
-  // Set bounds for the environment.
-  const Vector3d lower = space_->LowerBounds();
-  const Vector3d upper = space_->UpperBounds();
+  // Skip the search if we can go straight there.
+  if (space_->IsValidSegment(start, stop, incoming_value_, outgoing_value_)) {
+    num_direct_connections_++;
 
-  ob::RealVectorBounds ompl_bounds(3);
+    const std::vector<double> times =
+      { start_time, start_time + BestPossibleTime(start, stop) };
+    const std::vector<Vector3d> positions = { start, stop };
+    const std::vector<ValueFunctionId> values(2, incoming_value_);
 
-  for (size_t ii = 0; ii < 3; ii++) {
-    ompl_bounds.setLow(ii, lower(ii));
-    ompl_bounds.setHigh(ii, upper(ii));
+    return PolynomialTrajectory::Create(times, positions, values, values);
   }
 
-  ompl_space->setBounds(ompl_bounds);
-
-  // Create a SimpleSetup instance and set the state validity checker function.
-  og::SimpleSetup ompl_setup(ompl_space);
-  ompl_setup.setStateValidityChecker([&](const ob::State* state) {
-      return space_->IsValid(FromOmplState(state),
-                             incoming_value_, outgoing_value_); });
+  // Grab a configured setup and clear out the last query.
+  std::unique_ptr<Setup> setup = AcquireSetup();
+  og::SimpleSetup& ompl_setup = *setup->simple_setup_;
+  ompl_setup.clear();
 
   // Set the start and stop states.
-  ob::ScopedState<ob::RealVectorStateSpace> ompl_start(ompl_space);
-  ob::ScopedState<ob::RealVectorStateSpace> ompl_stop(ompl_space);
+  ob::ScopedState<ob::RealVectorStateSpace> ompl_start(setup->space_);
+  ob::ScopedState<ob::RealVectorStateSpace> ompl_stop(setup->space_);
   for (size_t ii = 0; ii < 3; ii++) {
     ompl_start[ii] = start(ii);
     ompl_stop[ii] = stop(ii);
@@ -163,18 +189,18 @@ Plan(const Vector3d& start, const Vector3d& stop,
 
   ompl_setup.setStartAndGoalStates(ompl_start, ompl_stop);
 
-  // Set the planner.
-  ob::PlannerPtr ompl_planner(
-    new PlannerType(ompl_setup.getSpaceInformation()));
-  ompl_setup.setPlanner(ompl_planner);
-
-  // Solve. Parameter is the amount of time (in seconds) used by the solver.
-  const ob::PlannerStatus solved = ompl_setup.solve(budget);
+  // Solve. Parameter is the amount of time (in seconds) used by the solver,
+  // unless cancelled sooner.
+  const ob::PlannerStatus solved = (cancel) ?
+    ompl_setup.solve(ob::plannerOrTerminationCondition(
+      ob::timedPlannerTerminationCondition(budget),
+      ob::PlannerTerminationCondition(cancel))) :
+    ompl_setup.solve(budget);
 
   if (solved) {
     const og::PathGeometric& solution = ompl_setup.getSolutionPath();
 
-    // Populate the Trajectory with states and time stamps.
+    // Populate the PolynomialTrajectory with positions and time stamps.
     std::vector<Vector3d> positions;
     std::vector<double> times;
     std::vector<ValueFunctionId> values;
@@ -194,17 +220,85 @@ Plan(const Vector3d& start, const Vector3d& stop,
       values.push_back(incoming_value_);
     }
 
-    // Convert to full state space. Make sure to use the INCOMING VALUE!
-    std::vector<VectorXd> full_states =
-      dynamics_->LiftGeometricTrajectory(positions, times);
+    ReleaseSetup(std::move(setup));
 
-    return Trajectory::Create(times, full_states, values, values);
+    // Straight lines between OMPL's states. Make sure to use the INCOMING
+    // VALUE!
+    return PolynomialTrajectory::Create(times, positions, values, values);
   }
 
-  ROS_WARN("OMPL Planner could not compute a solution.");
+  ReleaseSetup(std::move(setup));
+
+  if (!cancel || !cancel())
+    ROS_WARN("OMPL Planner could not compute a solution.");
+
   return nullptr;
 }
 
+// Take a setup out of the pool, building a new one if none are free or
+// the environment's bounds have changed.
+template<typename PlannerType>
+std::unique_ptr<typename OmplPlanner<PlannerType>::Setup>
+OmplPlanner<PlannerType>::AcquireSetup() const {
+  {
+    std::lock_guard<std::mutex> lock(pool_mutex_);
+    while (!pool_.empty()) {
+      std::unique_ptr<Setup> setup = std::move(pool_.back());
+      pool_.pop_back();
+
+      if (setup->lower_ == space_->LowerBounds() &&
+          setup->upper_ == space_->UpperBounds())
+        return setup;
+    }
+  }
+
+  // Create the OMPL state space corresponding to this environment.
+  std::unique_ptr<Setup> setup(new Setup);
+  setup->space_ = std::make_shared<ob::RealVectorStateSpace>(3);
+
+  // Set bounds for the environment.
+  const Vector3d lower = space_->LowerBounds();
+  const Vector3d upper = space_->UpperBounds();
+  setup->lower_ = lower;
+  setup->upper_ = upper;
+
+  ob::RealVectorBounds ompl_bounds(3);
+
+  for (size_t ii = 0; ii < 3; ii++) {
+    ompl_bounds.setLow(ii, lower(ii));
+    ompl_bounds.setHigh(ii, upper(ii));
+  }
+
+  setup->space_->setBounds(ompl_bounds);
+
+  // Create a SimpleSetup instance and set the state validity checker function.
+  setup->simple_setup_.reset(new og::SimpleSetup(setup->space_));
+  setup->simple_setup_->setStateValidityChecker([this](const ob::State* state) {
+      return space_->IsValid(FromOmplState(state),
+                             incoming_value_, outgoing_value_); });
+
+  // Check motions exactly, rather than at a fixed resolution.
+  const ob::SpaceInformationPtr& si =
+    setup->simple_setup_->getSpaceInformation();
+  si->setMotionValidator(OmplMotionValidator::Create(
+    si, space_, incoming_value_, outgoing_value_));
+
+  // Set the planner. It is only cleared between queries, so anything it
+  // allocates during setup is kept.
+  ob::PlannerPtr ompl_planner(new PlannerType(si));
+  setup->simple_setup_->setPlanner(ompl_planner);
+
+  return setup;
+}
+
+// Return a setup to the pool.
+template<typename PlannerType>
+void OmplPlanner<PlannerType>::
+ReleaseSetup(std::unique_ptr<Setup> setup) const {
+  std::lock_guard<std::mutex> lock(pool_mutex_);
+  pool_.push_back(std::move(setup));
+}
+
 // Convert between OMPL states and VectorXds.
 template<typename PlannerType>
 Vector3d OmplPlanner<PlannerType>::FromOmplState(
@@ -61,16 +61,17 @@
 #define META_PLANNER_PLANNER_H
 
 #include <meta_planner/trajectory.h>
+#include <meta_planner/polynomial_trajectory.h>
 #include <meta_planner/environment.h>
 #include <meta_planner/box.h>
 #include <value_function/dynamics.h>
+#include <value_function/value_function_provider.h>
 #include <utils/types.h>
 #include <utils/uncopyable.h>
-#include <utils/message_interfacing.h>
-
-#include <value_function_srvs/GeometricPlannerTime.h>
 
 #include <memory>
+#include <functional>
+#include <atomic>
 
 #include <ros/ros.h>
 
@@ -85,14 +86,26 @@ public:
   virtual ~Planner() {}
 
   // Initialize this class from a ROS node.
-  bool Initialize(const ros::NodeHandle& n);
-
-  // Derived classes must plan trajectories between two points.
-  // Budget is the time the planner is allowed to take during planning.
-  virtual Trajectory::Ptr Plan(const Vector3d& start,
-                               const Vector3d& stop,
-                               double start_time = 0.0,
-                               double budget = 1.0) const = 0;
+  bool Initialize(const ros::NodeHandle& n,
+                  const ValueFunctionProvider::ConstPtr& values);
+
+  // Polled while planning. Planning gives up as soon as it returns true.
+  typedef std::function<bool()> CancelFunction;
+
+  // Derived classes must plan trajectories between two points, as
+  // piecewise polynomials. Budget is the time the planner is allowed to take
+  // during planning, unless cancelled sooner.
+  virtual PolynomialTrajectory::Ptr PlanPolynomial(
+    const Vector3d& start, const Vector3d& stop,
+    double start_time = 0.0, double budget = 1.0,
+    const CancelFunction& cancel = CancelFunction()) const = 0;
+
+  // Plan a trajectory between two points, sampled at the polynomials' knots
+  // and lifted into the full state space.
+  virtual Trajectory::Ptr Plan(
+    const Vector3d& start, const Vector3d& stop,
+    double start_time = 0.0, double budget = 1.0,
+    const CancelFunction& cancel = CancelFunction()) const;
 
   // Shortest possible time to go from start to stop for this planner.
   double BestPossibleTime(const Vector3d& start, const Vector3d& stop) const;
@@ -108,6 +121,13 @@ public:
     return outgoing_value_;
   }
 
+  // Number of planning queries so far, and how many of them were answered
+  // by a direct straight-line connection without a full search.
+  inline size_t NumQueries() const { return num_queries_; }
+  inline size_t NumDirectConnections() const {
+    return num_direct_connections_;
+  }
+
 protected:
   explicit Planner(ValueFunctionId incoming_value,
                    ValueFunctionId outgoing_value,
@@ -116,7 +136,9 @@ protected:
     : incoming_value_(incoming_value),
       outgoing_value_(outgoing_value),
       space_(space),
-      dynamics_(dynamics) {
+      dynamics_(dynamics),
+      num_queries_(0),
+      num_direct_connections_(0) {
     if (incoming_value_ + 1 != outgoing_value_)
       ROS_ERROR("Outgoing value function not successor to incoming one.");
   }
@@ -131,18 +153,17 @@ protected:
   // Dynamics.
   const Dynamics::ConstPtr dynamics_;
 
-  // Server to query value functions best possible time.
-  mutable ros::ServiceClient best_time_srv_;
-  std::string best_time_name_;
+  // Value functions, queried for best possible time.
+  ValueFunctionProvider::ConstPtr values_;
+
+  // Planning statistics. Derived classes must keep these up to date.
+  mutable std::atomic<size_t> num_queries_;
+  mutable std::atomic<size_t> num_direct_connections_;
 
   // Initialization and naming.
   bool initialized_;
   std::string name_;
 
-private:
-  // Load parameters and register callbacks.
-  bool LoadParameters(const ros::NodeHandle& n);
-  bool RegisterCallbacks(const ros::NodeHandle& n);
 };
 
 } //\namespace meta
@@ -0,0 +1,209 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the PolynomialTrajectory class. Positions are stored at knots,
+// and joined either by straight lines at constant velocity or by cubics
+// matching given velocities at both ends (i.e. cubic Hermite splines).
+// States are evaluated in closed form, and a PolynomialTrajectory can be
+// converted to and from a sampled Trajectory.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef META_PLANNER_POLYNOMIAL_TRAJECTORY_H
+#define META_PLANNER_POLYNOMIAL_TRAJECTORY_H
+
+#include <meta_planner/trajectory.h>
+#include <value_function/dynamics.h>
+#include <utils/types.h>
+
+#include <meta_planner_msgs/PolynomialTrajectory.h>
+
+#include <ros/ros.h>
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <memory>
+#include <stdexcept>
+
+namespace meta {
+
+class PolynomialTrajectory {
+public:
+  typedef std::shared_ptr<PolynomialTrajectory> Ptr;
+  typedef std::shared_ptr<const PolynomialTrajectory> ConstPtr;
+
+  // Factory constructor for straight lines between positions, traversed at
+  // constant velocity. Knots must be in increasing time order; any others
+  // are dropped.
+  static Ptr Create(const std::vector<double>& times,
+                    const std::vector<Vector3d>& positions,
+                    const std::vector<ValueFunctionId>& control_values,
+                    const std::vector<ValueFunctionId>& bound_values);
+
+  // Factory constructor for cubics between positions, matching the given
+  // velocities at both ends.
+  static Ptr Create(const std::vector<double>& times,
+                    const std::vector<Vector3d>& positions,
+                    const std::vector<Vector3d>& velocities,
+                    const std::vector<ValueFunctionId>& control_values,
+                    const std::vector<ValueFunctionId>& bound_values);
+
+  // Factory constructor from ROS message. Segments are cubic if the
+  // message has velocities, and linear otherwise.
+  static Ptr Create(
+    const meta_planner_msgs::PolynomialTrajectory::ConstPtr& msg);
+
+  // Factory constructor to concatenate trajectories which follow one another
+  // in time, as cubics through all of their knots. Each knot keeps the
+  // velocity it had in its own trajectory, so velocity is continuous, and
+  // where straight lines change direction the cubics round the corner.
+  // Where consecutive ones meet at the same time, the later one's knot is
+  // kept.
+  static Ptr Create(const std::vector<ConstPtr>& pieces);
+
+  // Number of knots, and whether segments are cubic.
+  size_t Size() const { return times_.size(); }
+  bool IsEmpty() const { return times_.empty(); }
+  bool IsCubic() const { return !velocities_.empty(); }
+
+  // Time span.
+  double FirstTime() const;
+  double LastTime() const;
+
+  // Adjust the time stamps for this trajectory to start at the given time.
+  void ResetStartTime(double start);
+
+  // Swap out the control value function in this trajectory and retime each
+  // segment to take the best possible time at the new value function's max
+  // planner speed, as Trajectory::ExecuteSwitch does for waypoints. Cubic
+  // velocities are scaled along with the segments leaving their knots.
+  void ExecuteSwitch(ValueFunctionId value,
+                     const ValueFunctionProvider::ConstPtr& values);
+
+  // Position and velocity at the given time. Outside the trajectory, holds
+  // the first or last position with zero velocity.
+  void GetState(double time, Vector3d& position, Vector3d& velocity) const;
+
+  // Return the ID of the value function being used at this time.
+  ValueFunctionId GetControlValueFunction(double time) const;
+  ValueFunctionId GetBoundValueFunction(double time) const;
+
+  // IDs of the bound value functions used by each knot's segment.
+  const std::vector<ValueFunctionId>& BoundValueFunctions() const {
+    return bound_values_;
+  }
+
+  // Convert to ROS message.
+  meta_planner_msgs::PolynomialTrajectory ToRosMessage() const;
+
+  // Convert to a sampled Trajectory with a waypoint at every knot, and
+  // enough in between that none are more than the given time apart. States
+  // are lifted by the given dynamics, with velocities taken from the
+  // polynomials. With linear segments and no extra waypoints, this matches
+  // lifting the knot positions directly.
+  Trajectory::Ptr ToTrajectory(
+    const Dynamics::ConstPtr& dynamics,
+    double max_time_step = std::numeric_limits<double>::infinity()) const;
+
+private:
+  PolynomialTrajectory() {}
+
+  // Add a knot, unless it is not after the last one. Cubic factories add
+  // the knot's velocity themselves.
+  bool Add(double time, const Vector3d& position,
+           ValueFunctionId control_value, ValueFunctionId bound_value);
+
+  // Index of the last knot at or before the given time, clamped to be a
+  // valid knot.
+  size_t Knot(double time) const;
+
+  // Velocity at the given knot. Linear segments carry the velocity of the
+  // segment leaving each knot, or arriving at the last one.
+  Vector3d Velocity(size_t knot) const;
+
+  // Position and velocity at the given time on the segment starting at the
+  // given knot, which must not be the last.
+  void Evaluate(size_t knot, double time,
+                Vector3d& position, Vector3d& velocity) const;
+
+  // Knots, with three entries per position or velocity. Velocities are
+  // only stored for cubic segments. Each segment uses the value functions
+  // of the knot it starts at.
+  std::vector<double> times_;
+  std::vector<double> positions_;
+  std::vector<double> velocities_;
+  std::vector<ValueFunctionId> control_values_;
+  std::vector<ValueFunctionId> bound_values_;
+};
+
+// ------------------------------- IMPLEMENTATION --------------------------- //
+
+inline double PolynomialTrajectory::FirstTime() const {
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (IsEmpty()) {
+    ROS_WARN("Tried to get first time of empty polynomial trajectory.");
+    throw std::underflow_error("Attempted first time of empty trajectory.");
+  }
+#endif
+
+  return times_.front();
+}
+
+inline double PolynomialTrajectory::LastTime() const {
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (IsEmpty()) {
+    ROS_WARN("Tried to get last time of empty polynomial trajectory.");
+    throw std::underflow_error("Attempted last time of empty trajectory.");
+  }
+#endif
+
+  return times_.back();
+}
+
+// Index of the last knot at or before the given time, clamped to be a
+// valid knot.
+inline size_t PolynomialTrajectory::Knot(double time) const {
+  const size_t after =
+    std::upper_bound(times_.begin(), times_.end(), time) - times_.begin();
+  return (after == 0) ? 0 : after - 1;
+}
+
+} //\namespace meta
+
+#endif
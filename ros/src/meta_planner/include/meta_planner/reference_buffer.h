@@ -0,0 +1,134 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the ReferenceBuffer class, which resamples a Trajectory at a
+// fixed time step in a background thread and holds the upcoming samples
+// in a ring buffer, so that looking up the reference at any time takes
+// constant time regardless of the trajectory's length.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef META_PLANNER_REFERENCE_BUFFER_H
+#define META_PLANNER_REFERENCE_BUFFER_H
+
+#include <meta_planner/trajectory.h>
+#include <value_function/value_function_provider.h>
+#include <utils/types.h>
+#include <utils/uncopyable.h>
+
+#include <ros/ros.h>
+#include <algorithm>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace meta {
+
+class ReferenceBuffer : private Uncopyable {
+public:
+  typedef std::shared_ptr<ReferenceBuffer> Ptr;
+  typedef std::shared_ptr<const ReferenceBuffer> ConstPtr;
+
+  // Destructor. Stops the background thread.
+  ~ReferenceBuffer();
+
+  // Factory method. Use this instead of the constructor. Samples are
+  // time_step apart and run up to horizon ahead of the last lookup.
+  static Ptr Create(double time_step, double horizon,
+                    const ValueFunctionProvider::ConstPtr& values);
+
+  // Start resampling the given trajectory from the given time on, dropping
+  // all samples of the previous one.
+  void Reset(const Trajectory::ConstPtr& traj, double start);
+
+  // Interpolate the reference state at the given time between the samples
+  // around it, and get the value functions and tracking bound of the one
+  // before it. Drops all earlier samples. Returns false if they have not
+  // been sampled yet.
+  bool Get(double time, VectorXd& state, ValueFunctionId& control_value,
+           ValueFunctionId& bound_value, Vector3d& bound);
+
+private:
+  explicit ReferenceBuffer(double time_step, size_t capacity,
+                           const ValueFunctionProvider::ConstPtr& values);
+
+  // Background thread. Samples the current trajectory whenever the buffer
+  // is less than half full.
+  void Run();
+
+  // Should the background thread wake up?
+  bool NeedsSamples() const;
+
+  // Sample spacing, number of slots, and where tracking bounds come from.
+  const double time_step_;
+  const size_t capacity_;
+  const ValueFunctionProvider::ConstPtr values_;
+
+  // Trajectory being sampled, its k-th sample being at time
+  // min(start_ + k * time_step_, last time) for k < end_. Bumping the
+  // generation tells the background thread to start over.
+  Trajectory::ConstPtr traj_;
+  double start_;
+  size_t end_;
+  size_t generation_;
+
+  // Ring buffer of samples k in [first_, last_), with sample k in slot
+  // k % capacity_.
+  size_t first_;
+  size_t last_;
+  size_t state_dim_;
+  std::vector<double> times_;
+  std::vector<double> states_;
+  std::vector<ValueFunctionId> control_values_;
+  std::vector<ValueFunctionId> bound_values_;
+  std::vector<Vector3d> bounds_;
+
+  // Everything above is guarded by this mutex. The background thread only
+  // holds it while copying in a batch of samples.
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  std::thread thread_;
+};
+
+} //\namespace meta
+
+#endif
@@ -46,6 +46,7 @@
 #include <meta_planner/trajectory.h>
 #include <meta_planner/ompl_planner.h>
 #include <demo/balls_in_box.h>
+#include <value_function/value_function_provider.h>
 #include <utils/types.h>
 #include <utils/uncopyable.h>
 #include <utils/message_interfacing.h>
@@ -54,9 +55,6 @@
 #include <meta_planner_msgs/TrajectoryRequest.h>
 #include <meta_planner_msgs/ControllerId.h>
 
-#include <value_function_srvs/OptimalControl.h>
-#include <value_function_srvs/Priority.h>
-
 #include <crazyflie_msgs/PositionVelocityStateStamped.h>
 #include <crazyflie_msgs/ControlStamped.h>
 #include <crazyflie_msgs/NoYawControlStamped.h>
@@ -120,12 +118,8 @@ private:
   ros::Timer timer_;
   double time_step_;
 
-  // Service clients.
-  ros::ServiceClient optimal_control_srv_;
-  ros::ServiceClient priority_srv_;
-
-  std::string optimal_control_name_;
-  std::string priority_name_;
+  // Value functions, queried for optimal control and priority.
+  ValueFunctionProvider::ConstPtr values_;
 
   // Publishers/subscribers and related topics.
   ros::Publisher control_pub_;
@@ -44,20 +44,23 @@
 #define META_PLANNER_TRAJECTORY_H
 
 #include <value_function/dynamics.h>
+#include <value_function/value_function_provider.h>
 #include <utils/types.h>
 #include <utils/message_interfacing.h>
 
 #include <meta_planner_msgs/Trajectory.h>
+#include <meta_planner_msgs/FlatTrajectory.h>
+#include <meta_planner_msgs/TrajectoryPatch.h>
 #include <meta_planner_msgs/State.h>
 
-#include <value_function_srvs/GeometricPlannerTime.h>
-
 #include <ros/ros.h>
 #include <std_msgs/ColorRGBA.h>
 #include <visualization_msgs/Marker.h>
 #include <vector>
 #include <utility>
-#include <map>
+#include <algorithm>
+#include <functional>
+#include <limits>
 #include <string>
 #include <iostream>
 #include <exception>
@@ -86,20 +89,46 @@ public:
   // possible ValueFunctions.
   static Ptr Create(const meta_planner_msgs::Trajectory::ConstPtr& msg);
 
+  // Factory constructor from a flat ROS message, whose states are stored
+  // back to back with a fixed stride.
+  static Ptr Create(const meta_planner_msgs::FlatTrajectory::ConstPtr& msg);
+
   // Factory constructor to create a Trajectory as the remainder of the
   // given Trajectory after the specified time point.
   static Ptr Create(const ConstPtr& other, double start);
 
+  // Factory constructor to concatenate trajectories which follow one another
+  // in time. Where consecutive ones meet at the same time, the later one's
+  // waypoint is kept.
+  static Ptr Create(const std::vector<ConstPtr>& segments);
+
+  // Factory constructor to splice a suffix onto a trajectory, keeping the
+  // trajectory's waypoints before the splice time and the suffix's from
+  // then on. Both are shared rather than copied.
+  static Ptr Create(const ConstPtr& prefix, double splice_time,
+                    const ConstPtr& suffix);
+
+  // Factory constructor to apply a patch to the given trajectory, received
+  // at the given time. What is left of the trajectory from then until the
+  // splice time is kept, and the patch's suffix followed from then on. With
+  // no trajectory to splice onto, or an empty suffix, this is just the
+  // suffix.
+  static Ptr Create(const ConstPtr& traj,
+                    const meta_planner_msgs::TrajectoryPatch::ConstPtr& msg,
+                    double now);
+
   // Clear out this Trajectory.
   void Clear();
 
-  // Add a (state, time) tuple to this Trajectory.
+  // Add a (state, time) tuple to this Trajectory. If there is already a
+  // waypoint at this time, the existing one is kept.
   void Add(double time,
            const VectorXd& state,
            ValueFunctionId control_value,
            ValueFunctionId bound_value);
 
-  // Add a whole other Trajectory to this one.
+  // Add a whole other Trajectory to this one. Where both have a waypoint at
+  // the same time, this Trajectory's is kept.
   void Add(const ConstPtr& other);
 
   // Check if this trajectory is empty.
@@ -112,15 +141,19 @@ public:
   double Time() const;
 
   // Swap out the control value function in this trajectory and update time
-  // stamps accordingly.
-  void ExecuteSwitch(ValueFunctionId value, ros::ServiceClient& best_time_srv);
+  // stamps accordingly, in one pass using the new value function's max
+  // planner speed.
+  void ExecuteSwitch(ValueFunctionId value,
+                     const ValueFunctionProvider::ConstPtr& values);
 
   // Adjust the time stamps for this trajectory to start at the given time.
+  // Only shifts each piece's time offset, so no waypoints are touched.
   void ResetStartTime(double start);
 
-  // Accessors.
-  const VectorXd& LastState() const;
-  const VectorXd& FirstState() const;
+  // Accessors. States are views into this trajectory's storage, and are
+  // only valid until it is next modified.
+  Eigen::Map<const VectorXd> LastState() const;
+  Eigen::Map<const VectorXd> FirstState() const;
   double LastTime() const;
   double FirstTime() const;
   ValueFunctionId LastControlValueFunction() const;
@@ -137,44 +170,143 @@ public:
 
   // Convert to ROS message.
   meta_planner_msgs::Trajectory ToRosMessage() const;
+  meta_planner_msgs::FlatTrajectory ToFlatRosMessage() const;
+
+  // Convert to a patch for a receiver following the given previous
+  // trajectory. Waypoints this one shares with it from its start are left
+  // out, except the last, which is where the suffix is spliced on.
+  meta_planner_msgs::TrajectoryPatch ToPatchRosMessage(
+    const ConstPtr& previous) const;
 
-  // Visualize this trajectory in RVIZ.
+  // Visualize this trajectory in RVIZ, with at most the given number of
+  // evenly spaced waypoints (always including the first and last).
   void Visualize(const ros::Publisher& pub,
-                 const std::string& frame_id) const;
+                 const std::string& frame_id,
+                 size_t max_points = std::numeric_limits<size_t>::max()) const;
 
   // Print this trajectory to stdout.
   void Print(const std::string& prefix) const;
 
+  // Remembers where the last query fell in a trajectory, so that queries at
+  // nondecreasing times (e.g. once per control tick) take amortized constant
+  // time instead of a search each. Stays correct if the trajectory is
+  // modified, e.g. by ResetStartTime, at the cost of one search.
+  class Cursor {
+  public:
+    Cursor()
+      : piece_(0),
+        index_(0) {}
+    explicit Cursor(const ConstPtr& traj)
+      : traj_(traj),
+        piece_(0),
+        index_(0) {}
+
+    // Trajectory being followed.
+    const ConstPtr& Traj() const { return traj_; }
+
+    // Find the interpolated state and the value functions in use at this
+    // time. Same results as GetState, GetControlValueFunction and
+    // GetBoundValueFunction.
+    void Get(double time, VectorXd& state,
+             ValueFunctionId& control_value,
+             ValueFunctionId& bound_value);
+
+  private:
+    // Move to the first waypoint with time not less than the given time.
+    void Seek(double time);
+
+    ConstPtr traj_;
+
+    // Current waypoint, and the piece of the trajectory which holds it.
+    size_t piece_;
+    size_t index_;
+  };
+
 private:
-  Trajectory() {}
+  Trajectory()
+    : offsets_(1, 0),
+      state_dim_(0) {}
 
   // Compute the color (on a red-blue colormap) at a particular time.
   std_msgs::ColorRGBA Colormap(double time) const;
 
-  // Private struct to hold a state and a value function.
-  struct StateValue {
-    VectorXd state_;
-    ValueFunctionId control_value_;
-    ValueFunctionId bound_value_;
-
-    StateValue(const VectorXd& state,
-               ValueFunctionId control_value,
-               ValueFunctionId bound_value)
-      : state_(state),
-        control_value_(control_value),
-        bound_value_(bound_value) {}
-    ~StateValue() {}
+  // Block of waypoints, sorted by time. States are stored contiguously as
+  // the columns of a column-major (state_dim_ x size) matrix. Segments are
+  // shared between trajectories, and never modified once shared.
+  struct Segment {
+    std::vector<double> times_;
+    std::vector<double> states_;
+    std::vector<ValueFunctionId> control_values_;
+    std::vector<ValueFunctionId> bound_values_;
   };
 
-  // Map from time stamp to corresponding state/value function.
-  std::map<double, StateValue> map_;
+  // Waypoints [first_, last_) of a segment, all shifted in time by offset_,
+  // so that retiming by a constant does not touch the segment. Never empty.
+  struct Piece {
+    std::shared_ptr<Segment> segment_;
+    size_t first_;
+    size_t last_;
+    double offset_;
+
+    // Time of the waypoint at the given index in the segment.
+    double Time(size_t index) const {
+      return segment_->times_[index] + offset_;
+    }
+  };
+
+  // Index of the piece holding the waypoint at the given index, or the
+  // number of pieces if that is one past the end.
+  size_t Locate(size_t index) const;
+
+  // Waypoint at the given index, as a (piece, index in segment) pair.
+  std::pair<const Piece*, size_t> At(size_t index) const;
+
+  // Time, state and value functions at the given index.
+  double TimeAt(size_t index) const;
+  Eigen::Map<const VectorXd> State(size_t index) const;
+  ValueFunctionId ControlValueAt(size_t index) const;
+  ValueFunctionId BoundValueAt(size_t index) const;
+
+  // State at the given index in a segment.
+  Eigen::Map<const VectorXd> State(const Segment& segment,
+                                   size_t index) const;
+
+  // Index of the first waypoint with time not less than the given time, and
+  // optionally the piece holding it.
+  size_t LowerBound(double time, size_t* piece = nullptr) const;
+
+  // Insert a waypoint in time order, unless there already is one at this
+  // time. Returns whether it was inserted.
+  bool Insert(double time, const double* state, size_t state_dim,
+              ValueFunctionId control_value, ValueFunctionId bound_value);
+
+  // Append waypoints [first, last) of the other trajectory, or prepend them
+  // at the front. They must lie entirely after (before) this trajectory.
+  // Shares the other trajectory's segments rather than copying them.
+  void Append(const Trajectory& other, size_t first, size_t last);
+  void Prepend(const Trajectory& other, size_t first, size_t last);
+
+  // Drop the last waypoint.
+  void RemoveLast();
+
+  // Copy all waypoints into a single segment used only by this trajectory,
+  // so that it can be modified.
+  void Flatten();
+
+  // Pieces of segments, in time order, and the index of each piece's first
+  // waypoint. There is one more offset than pieces, which is the size.
+  std::vector<Piece> pieces_;
+  std::vector<size_t> offsets_;
+  size_t state_dim_;
 };
 
 // ---------------------- IMPLEMENT INLINE FUNCTIONS ------------------------ //
 
 // Clear out this Trajectory.
 inline void Trajectory::Clear() {
-  map_.clear();
+  pieces_.clear();
+  offsets_.assign(1, 0);
+  state_dim_ = 0;
 }
 
 // Add a (state, time) tuple to this Trajectory.
@@ -182,22 +314,17 @@ inline void Trajectory::Add(double time,
                             const VectorXd& state,
                             ValueFunctionId control_value,
                             ValueFunctionId bound_value) {
-  map_.insert({ time, StateValue(state, control_value, bound_value) });
-}
-
-// Add a whole other Trajectory to this one.
-inline void Trajectory::Add(const ConstPtr& other) {
-  map_.insert(other->map_.begin(), other->map_.end());
+  Insert(time, state.data(), state.size(), control_value, bound_value);
 }
 
 // Check if this trajectory is empty.
 inline bool Trajectory::IsEmpty() const {
-  return map_.empty();
+  return pieces_.empty();
 }
 
 // Number of waypoints.
 inline size_t Trajectory::Size() const {
-  return map_.size();
+  return offsets_.back();
 }
 
 // Total time length of the trajectory.
@@ -212,8 +339,50 @@ inline double Trajectory::Time() const {
   return LastTime() - FirstTime();
 }
 
+// Index of the piece holding the waypoint at the given index.
+inline size_t Trajectory::Locate(size_t index) const {
+  return std::upper_bound(offsets_.begin(), offsets_.end(), index) -
+    offsets_.begin() - 1;
+}
+
+// Waypoint at the given index, as a (piece, index in segment) pair.
+inline std::pair<const Trajectory::Piece*, size_t>
+Trajectory::At(size_t index) const {
+  const size_t piece = Locate(index);
+  return std::make_pair(&pieces_[piece],
+                        pieces_[piece].first_ + index - offsets_[piece]);
+}
+
+// Time, state and value functions at the given index.
+inline double Trajectory::TimeAt(size_t index) const {
+  const auto waypoint = At(index);
+  return waypoint.first->Time(waypoint.second);
+}
+
+inline Eigen::Map<const VectorXd> Trajectory::State(size_t index) const {
+  const auto waypoint = At(index);
+  return State(*waypoint.first->segment_, waypoint.second);
+}
+
+inline ValueFunctionId Trajectory::ControlValueAt(size_t index) const {
+  const auto waypoint = At(index);
+  return waypoint.first->segment_->control_values_[waypoint.second];
+}
+
+inline ValueFunctionId Trajectory::BoundValueAt(size_t index) const {
+  const auto waypoint = At(index);
+  return waypoint.first->segment_->bound_values_[waypoint.second];
+}
+
+// State at the given index in a segment.
+inline Eigen::Map<const VectorXd> Trajectory::State(const Segment& segment,
+                                                    size_t index) const {
+  return Eigen::Map<const VectorXd>(
+    segment.states_.data() + index * state_dim_, state_dim_);
+}
+
 // Accessors.
-inline const VectorXd& Trajectory::LastState() const {
+inline Eigen::Map<const VectorXd> Trajectory::LastState() const {
 #ifdef ENABLE_DEBUG_MESSAGES
   if (IsEmpty()) {
     ROS_WARN("Tried to get last state of empty trajectory.");
@@ -221,10 +390,10 @@ inline const VectorXd& Trajectory::LastState() const {
   }
 #endif
 
-  return (--map_.end())->second.state_;
+  return State(*pieces_.back().segment_, pieces_.back().last_ - 1);
 }
 
-inline const VectorXd& Trajectory::FirstState() const {
+inline Eigen::Map<const VectorXd> Trajectory::FirstState() const {
 #ifdef ENABLE_DEBUG_MESSAGES
   if (IsEmpty()) {
     ROS_WARN("Tried to get first state of empty trajectory.");
@@ -232,7 +401,7 @@ inline const VectorXd& Trajectory::FirstState() const {
   }
 #endif
 
-  return map_.begin()->second.state_;
+  return State(*pieces_.front().segment_, pieces_.front().first_);
 }
 
 inline double Trajectory::LastTime() const {
@@ -243,7 +412,7 @@ inline double Trajectory::LastTime() const {
   }
 #endif
 
-  return (--map_.end())->first;
+  return pieces_.back().Time(pieces_.back().last_ - 1);
 }
 
 inline double Trajectory::FirstTime() const {
@@ -254,7 +423,7 @@ inline double Trajectory::FirstTime() const {
   }
 #endif
 
-  return map_.begin()->first;
+  return pieces_.front().Time(pieces_.front().first_);
 }
 
 inline ValueFunctionId Trajectory::LastControlValueFunction() const {
@@ -265,7 +434,7 @@ inline ValueFunctionId Trajectory::LastControlValueFunction() const {
   }
 #endif
 
-  return (--map_.end())->second.control_value_;
+  return pieces_.back().segment_->control_values_[pieces_.back().last_ - 1];
 }
 
 inline ValueFunctionId Trajectory::FirstControlValueFunction() const {
@@ -276,7 +445,7 @@ inline ValueFunctionId Trajectory::FirstControlValueFunction() const {
     }
 #endif
 
-    return map_.begin()->second.control_value_;
+    return pieces_.front().segment_->control_values_[pieces_.front().first_];
   }
 
 inline ValueFunctionId Trajectory::LastBoundValueFunction() const {
@@ -287,7 +456,7 @@ inline ValueFunctionId Trajectory::LastBoundValueFunction() const {
   }
 #endif
 
-  return (--map_.end())->second.bound_value_;
+  return pieces_.back().segment_->bound_values_[pieces_.back().last_ - 1];
 }
 
 inline ValueFunctionId Trajectory::FirstBoundValueFunction() const {
@@ -298,7 +467,7 @@ inline ValueFunctionId Trajectory::FirstBoundValueFunction() const {
     }
 #endif
 
-    return map_.begin()->second.bound_value_;
+    return pieces_.front().segment_->bound_values_[pieces_.front().first_];
   }
 
 } //\namespace meta
@@ -46,13 +46,19 @@
 #define META_PLANNER_TRAJECTORY_INTERPRETER_H
 
 #include <meta_planner/trajectory.h>
+#include <meta_planner/polynomial_trajectory.h>
+#include <meta_planner/reference_buffer.h>
+#include <meta_planner/trajectory_visualizer.h>
+#include <value_function/value_function_provider.h>
+#include <value_function/near_hover_quad_no_yaw.h>
 #include <utils/types.h>
 #include <utils/uncopyable.h>
 #include <utils/message_interfacing.h>
 
-#include <value_function_srvs/TrackingBoundBox.h>
-
 #include <meta_planner_msgs/Trajectory.h>
+#include <meta_planner_msgs/FlatTrajectory.h>
+#include <meta_planner_msgs/PolynomialTrajectory.h>
+#include <meta_planner_msgs/TrajectoryPatch.h>
 #include <meta_planner_msgs/TrajectoryRequest.h>
 #include <meta_planner_msgs/ControllerId.h>
 
@@ -67,6 +73,7 @@
 #include <geometry_msgs/TransformStamped.h>
 #include <tf2_ros/transform_broadcaster.h>
 #include <string>
+#include <unordered_map>
 #include <math.h>
 
 namespace meta {
@@ -85,6 +92,15 @@ private:
 
   // Callback for processing trajectory updates.
   void TrajectoryCallback(const meta_planner_msgs::Trajectory::ConstPtr& msg);
+  void FlatTrajectoryCallback(
+    const meta_planner_msgs::FlatTrajectory::ConstPtr& msg);
+  void PolynomialTrajectoryCallback(
+    const meta_planner_msgs::PolynomialTrajectory::ConstPtr& msg);
+
+  // Callback for processing trajectory patches, which replace the current
+  // trajectory from their splice time on.
+  void TrajectoryPatchCallback(
+    const meta_planner_msgs::TrajectoryPatch::ConstPtr& msg);
 
   // Callback for processing state updates.
   void StateCallback(
@@ -108,9 +124,37 @@ private:
   // Send a hover control.
   void Hover();
 
-  // Current state and trajectory.
+  // Switch to following a new trajectory, or to following a polynomial
+  // trajectory in closed form, with the given trajectory sampled at its
+  // knots.
+  void SetTrajectory(const Trajectory::Ptr& traj,
+                     const PolynomialTrajectory::ConstPtr& poly = nullptr);
+
+  // Current state and trajectory, and where we are along it.
   VectorXd state_;
   Trajectory::Ptr traj_;
+  Trajectory::Cursor cursor_;
+  VectorXd planner_state_;
+
+  // Polynomial trajectory being followed, if any. References are then
+  // evaluated from it in closed form, and traj_ only holds its knots for
+  // replanning, hovering and visualization.
+  PolynomialTrajectory::ConstPtr poly_;
+
+  // Tracking bounds for the polynomial trajectory's bound value functions,
+  // looked up when it arrives.
+  std::unordered_map<ValueFunctionId, Vector3d> poly_bounds_;
+
+  // References resampled from the current trajectory at the control rate.
+  // The cursor is only used until they are ready.
+  ReferenceBuffer::Ptr references_;
+  double reference_horizon_;
+
+  // Trajectory visualization, published from its own thread at a capped
+  // rate with a capped number of waypoints.
+  TrajectoryVisualizer::Ptr visualizer_;
+  double traj_vis_rate_;
+  int traj_vis_max_points_;
 
   // Maximum runtime for meta planner.
   double max_meta_runtime_;
@@ -126,9 +170,11 @@ private:
   size_t control_dim_;
   size_t state_dim_;
 
-  // Servers and names.
-  ros::ServiceClient tracking_bound_srv_;
-  std::string tracking_bound_name_;
+  // Value functions, queried for tracking bound.
+  ValueFunctionProvider::ConstPtr values_;
+
+  // Planner dynamics, used to lift polynomial trajectories.
+  NearHoverQuadNoYaw::ConstPtr dynamics_;
 
   // Publishers/subscribers and related topics.
   ros::Publisher tracking_bound_pub_;
@@ -147,6 +193,9 @@ private:
   std::string request_traj_topic_;
   std::string traj_vis_topic_;
   std::string traj_topic_;
+  std::string flat_traj_topic_;
+  std::string poly_traj_topic_;
+  std::string traj_patch_topic_;
   std::string state_topic_;
   std::string trigger_replan_topic_;
   std::string in_flight_topic_;
@@ -0,0 +1,107 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the TrajectoryVisualizer class, which publishes RVIZ markers for
+// the latest trajectory from a background thread at a capped rate. Markers
+// are only rebuilt when the trajectory changes or someone new subscribes,
+// so that whoever sets the trajectory never pays for visualization.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef META_PLANNER_TRAJECTORY_VISUALIZER_H
+#define META_PLANNER_TRAJECTORY_VISUALIZER_H
+
+#include <meta_planner/trajectory.h>
+#include <utils/uncopyable.h>
+
+#include <ros/ros.h>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+
+namespace meta {
+
+class TrajectoryVisualizer : private Uncopyable {
+public:
+  typedef std::shared_ptr<TrajectoryVisualizer> Ptr;
+  typedef std::shared_ptr<const TrajectoryVisualizer> ConstPtr;
+
+  // Destructor. Stops the background thread.
+  ~TrajectoryVisualizer();
+
+  // Factory method. Use this instead of the constructor. Publishes at most
+  // rate times per second, with at most max_points waypoints each time.
+  static Ptr Create(const ros::Publisher& pub, const std::string& frame_id,
+                    double rate, size_t max_points);
+
+  // Visualize the given trajectory from now on. Returns immediately.
+  void Update(const Trajectory::ConstPtr& traj);
+
+private:
+  explicit TrajectoryVisualizer(const ros::Publisher& pub,
+                                const std::string& frame_id,
+                                double rate, size_t max_points);
+
+  // Background thread. Wakes up at the capped rate and republishes if
+  // anything has changed.
+  void Run();
+
+  // Where and how to publish.
+  const ros::Publisher pub_;
+  const std::string frame_id_;
+  const std::chrono::duration<double> period_;
+  const size_t max_points_;
+
+  // Latest trajectory, and how many times it has been set.
+  Trajectory::ConstPtr traj_;
+  size_t version_;
+
+  // Everything above is guarded by this mutex. The background thread does
+  // not hold it while building markers.
+  std::mutex mutex_;
+  std::condition_variable wake_;
+  bool stop_;
+  std::thread thread_;
+};
+
+} //\namespace meta
+
+#endif
@@ -44,6 +44,7 @@
 #define META_PLANNER_WAYPOINT_H
 
 #include <meta_planner/trajectory.h>
+#include <meta_planner/polynomial_trajectory.h>
 #include <utils/types.h>
 #include <utils/uncopyable.h>
 
@@ -59,14 +60,18 @@ public:
   const Vector3d point_;
   const ValueFunctionId value_;
   const Trajectory::Ptr traj_;
+  const PolynomialTrajectory::Ptr poly_;
   const ConstPtr parent_;
 
-  // Factory method. Use this instead of the constructor.
+  // Factory method. Use this instead of the constructor. The trajectory
+  // from the parent is kept both as planned, in polynomial form, and
+  // sampled. Both are null at the root.
   static inline ConstPtr Create(const Vector3d& point,
                                 ValueFunctionId value,
                                 const Trajectory::Ptr& traj,
+                                const PolynomialTrajectory::Ptr& poly,
                                 const ConstPtr& parent) {
-    ConstPtr ptr(new Waypoint(point, value, traj, parent));
+    ConstPtr ptr(new Waypoint(point, value, traj, poly, parent));
     return ptr;
   }
 
@@ -77,10 +82,12 @@ private:
   explicit Waypoint(const Vector3d& point,
                     ValueFunctionId value,
                     const Trajectory::Ptr& traj,
+                    const PolynomialTrajectory::Ptr& poly,
                     const ConstPtr& parent)
     : point_(point),
       value_(value),
       traj_(traj),
+      poly_(poly),
       parent_(parent) {}
 };
 
@@ -40,6 +40,9 @@
 // finding the nearest k points, as well as the length (in time) of the
 // shortest path to the goal.
 //
+// All methods may be called from several threads at once. Insertions and
+// searches are serialized, while the best terminus is swapped atomically.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifndef META_PLANNER_WAYPOINT_TREE_H
@@ -53,6 +56,9 @@
 #include <iostream>
 #include <list>
 #include <limits>
+#include <algorithm>
+#include <memory>
+#include <mutex>
 
 namespace meta {
 
@@ -66,11 +72,13 @@ public:
   // Find nearest neighbors in the tree.
   inline std::vector<Waypoint::ConstPtr>
   KnnSearch(Vector3d& query, size_t k) const {
+    std::lock_guard<std::mutex> lock(mutex_);
     return kdtree_.KnnSearch(query, k);
   }
 
   inline std::vector<Waypoint::ConstPtr>
   RadiusSearch(Vector3d& query, double r) const {
+    std::lock_guard<std::mutex> lock(mutex_);
     return kdtree_.RadiusSearch(query, r);
   }
 
@@ -80,6 +88,9 @@ public:
   // Get best (fastest) trajectory (if it exists).
   Trajectory::Ptr BestTrajectory() const;
 
+  // Same as above, but as planned, in polynomial form.
+  PolynomialTrajectory::Ptr BestPolynomialTrajectory() const;
+
   // Get best total time (seconds) of any valid trajectory.
   // NOTE! Returns positive infinity if no valid trajectory exists.
   double BestTime() const;
@@ -88,14 +99,17 @@ private:
   // Root of the tree.
   Waypoint::ConstPtr root_;
 
-  // Best terminal waypoint.
+  // Best terminal waypoint. Only accessed through the std::atomic_*
+  // functions for shared_ptr.
   Waypoint::ConstPtr terminus_;
 
   // Start time.
   const double start_time_;
 
-  // Kdtree storing all waypoints for easy nearest neighbor searching.
+  // Kdtree storing all waypoints for easy nearest neighbor searching, and
+  // the mutex guarding it.
   FlannTree kdtree_;
+  mutable std::mutex mutex_;
 };
 
 } //\namespace meta
@@ -69,38 +69,29 @@ bool BallsInBox::IsValid(const Vector3d& position,
   }
 #endif
 
-  // Make sure server is up.
-  if (!switching_bound_srv_) {
-    ROS_WARN("%s: Switching bound server disconnected.", name_.c_str());
-
-    ros::NodeHandle nl;
-    switching_bound_srv_ = nl.serviceClient<value_function_srvs::SwitchingTrackingBoundBox>(
-      switching_bound_name_.c_str(), true);
-
+  // Make sure we have value functions to query.
+  if (!values_) {
+    ROS_WARN_THROTTLE(1.0, "%s: No value functions to collision check with.",
+                      name_.c_str());
     return false;
   }
 
   // No obstacles. Just check bounds.
-  value_function_srvs::SwitchingTrackingBoundBox bound;
-  bound.request.from_id = incoming_value;
-  bound.request.to_id = outgoing_value;
-  if (!switching_bound_srv_.call(bound)) {
-    ROS_ERROR("%s: Error calling switching bound server.", name_.c_str());
+  Vector3d bound;
+  if (!values_->SwitchingTrackingBound(incoming_value, outgoing_value, bound)) {
+    ROS_ERROR("%s: Error computing switching bound.", name_.c_str());
     return false;
   }
 
-  if (position(0) < lower_(0) + bound.response.x ||
-      position(0) > upper_(0) - bound.response.x ||
-      position(1) < lower_(1) + bound.response.y ||
-      position(1) > upper_(1) - bound.response.y ||
-      position(2) < lower_(2) + bound.response.z ||
-      position(2) > upper_(2) - bound.response.z)
+  if (position(0) < lower_(0) + bound(0) ||
+      position(0) > upper_(0) - bound(0) ||
+      position(1) < lower_(1) + bound(1) ||
+      position(1) > upper_(1) - bound(1) ||
+      position(2) < lower_(2) + bound(2) ||
+      position(2) > upper_(2) - bound(2))
     return false;
 
   // Check against each obstacle.
-  const Vector3d bound_vector(
-    bound.response.x, bound.response.y, bound.response.z);
-
   for (size_t ii = 0; ii < points_.size(); ii++) {
     const Vector3d& p = points_[ii];
 
@@ -111,13 +102,13 @@ bool BallsInBox::IsValid(const Vector3d& position,
     Vector3d closest_point;
     for (size_t jj = 0; jj < 3; jj++) {
       if (signed_distance(jj) >= 0.0) {
-        if (signed_distance(jj) >= bound_vector(jj))
-          closest_point(jj) = position(jj) + bound_vector(jj);
+        if (signed_distance(jj) >= bound(jj))
+          closest_point(jj) = position(jj) + bound(jj);
         else
           closest_point(jj) = p(jj);
       } else {
-        if (signed_distance(jj) <= -bound_vector(jj))
-          closest_point(jj) = position(jj) - bound_vector(jj);
+        if (signed_distance(jj) <= -bound(jj))
+          closest_point(jj) = position(jj) - bound(jj);
         else
           closest_point(jj) = p(jj);
       }
@@ -132,6 +123,31 @@ bool BallsInBox::IsValid(const Vector3d& position,
 }
 
 
+// Check a whole segment exactly, by sweeping the tracking bound along it
+// against each obstacle. Takes in incoming and outgoing value functions.
+bool BallsInBox::IsValidSegment(const Vector3d& start, const Vector3d& stop,
+                                ValueFunctionId incoming_value,
+                                ValueFunctionId outgoing_value) const {
+  // Check the walls (and initialization).
+  if (!Box::IsValidSegment(start, stop, incoming_value, outgoing_value))
+    return false;
+
+  Vector3d bound;
+  if (!values_->SwitchingTrackingBound(incoming_value, outgoing_value, bound)) {
+    ROS_ERROR("%s: Error computing switching bound.", name_.c_str());
+    return false;
+  }
+
+  // Check against each obstacle.
+  for (size_t ii = 0; ii < points_.size(); ii++) {
+    if (SweptBoxSquaredDistance(start, stop, bound, points_[ii]) <=
+        radii_[ii] * radii_[ii])
+      return false;
+  }
+
+  return true;
+}
+
 // Checks for obstacles within a sensing radius. Returns true if at least
 // one obstacle was found.
 bool BallsInBox::SenseObstacles(const Vector3d& position, double sensor_radius,
@@ -159,7 +175,11 @@ bool BallsInBox::IsObstacle(const Vector3d& obstacle_position,
         std::abs(obstacle_radius - radii_[ii]) < 1e-8) {
       // If this obstacle is in the environment, update the position of 
       // the known obstacle to match the sensed one.
-      points_[ii] = obstacle_position;
+      if (points_[ii] != obstacle_position) {
+        points_[ii] = obstacle_position;
+        version_++;
+      }
+
       return true;
     }
 
@@ -170,14 +190,14 @@ bool BallsInBox::IsObstacle(const Vector3d& obstacle_position,
 // Inherited visualizer from Box needs to be overwritten.
 void BallsInBox::Visualize(const ros::Publisher& pub,
                            const std::string& frame_id) const {
-  if (pub.getNumSubscribers() <= 0)
-    return;
+  // All markers share a time stamp.
+  const ros::Time stamp = ros::Time::now();
 
   // Set up box marker.
   visualization_msgs::Marker cube;
   cube.ns = "cube";
   cube.header.frame_id = frame_id;
-  cube.header.stamp = ros::Time::now();
+  cube.header.stamp = stamp;
   cube.id = 0;
   cube.type = visualization_msgs::Marker::CUBE;
   cube.action = visualization_msgs::Marker::ADD;
@@ -204,40 +224,55 @@ void BallsInBox::Visualize(const ros::Publisher& pub,
   cube.pose.orientation.z = 0.0;
   cube.pose.orientation.w = 1.0;
 
-  // Publish cube marker.
-  pub.publish(cube);
-
-  // Visualize obstacles as spheres.
-  for (size_t ii = 0; ii < points_.size(); ii++){
-    visualization_msgs::Marker sphere;
-    sphere.ns = "sphere";
-    sphere.header.frame_id = frame_id;
-    sphere.header.stamp = ros::Time::now();
-    sphere.id = static_cast<int>(ii);
-    sphere.type = visualization_msgs::Marker::SPHERE;
-    sphere.action = visualization_msgs::Marker::ADD;
-
-    sphere.scale.x = 2.0 * radii_[ii];
-    sphere.scale.y = 2.0 * radii_[ii];
-    sphere.scale.z = 2.0 * radii_[ii];
-
-    sphere.color.a = 0.9;
-    sphere.color.r = 0.7;
-    sphere.color.g = 0.5;
-    sphere.color.b = 0.5;
+  // Publish cube and spheres in one message, after clearing the last one in
+  // case it had markers which are not in this one. The array is latched and
+  // only sent when the environment changes, so it goes out regardless of
+  // subscribers.
+  visualization_msgs::Marker clear;
+  clear.header.frame_id = frame_id;
+  clear.header.stamp = stamp;
+  clear.action = visualization_msgs::Marker::DELETEALL;
+
+  visualization_msgs::MarkerArray markers;
+  markers.markers.push_back(clear);
+  markers.markers.push_back(cube);
+
+  // Visualize obstacles as spheres, with one sphere list per radius.
+  std::map<double, size_t> lists;
+  for (size_t ii = 0; ii < points_.size(); ii++) {
+    auto list = lists.find(radii_[ii]);
+    if (list == lists.end()) {
+      visualization_msgs::Marker spheres;
+      spheres.ns = "sphere";
+      spheres.header.frame_id = frame_id;
+      spheres.header.stamp = stamp;
+      spheres.id = static_cast<int>(lists.size());
+      spheres.type = visualization_msgs::Marker::SPHERE_LIST;
+      spheres.action = visualization_msgs::Marker::ADD;
+      spheres.pose.orientation.w = 1.0;
+
+      spheres.scale.x = 2.0 * radii_[ii];
+      spheres.scale.y = 2.0 * radii_[ii];
+      spheres.scale.z = 2.0 * radii_[ii];
+
+      spheres.color.a = 0.9;
+      spheres.color.r = 0.7;
+      spheres.color.g = 0.5;
+      spheres.color.b = 0.5;
+
+      list = lists.insert({ radii_[ii], markers.markers.size() }).first;
+      markers.markers.push_back(spheres);
+    }
 
     geometry_msgs::Point p;
-    const Vector3d point = points_[ii];
-    p.x = point(0);
-    p.y = point(1);
-    p.z = point(2);
-
-    sphere.pose.position = p;
+    p.x = points_[ii](0);
+    p.y = points_[ii](1);
+    p.z = points_[ii](2);
 
-    // Publish sphere marker.
-    pub.publish(sphere);
+    markers.markers[list->second].points.push_back(p);
   }
 
+  pub.publish(markers);
 }
 
 // Add a spherical obstacle of the given radius to the environment.
@@ -251,6 +286,7 @@ void BallsInBox::AddObstacle(const Vector3d& point, double r) {
 
   points_.push_back(point);
   radii_.push_back(std::max(r, kSmallNumber));
+  version_++;
 }
 
 } //\namespace meta
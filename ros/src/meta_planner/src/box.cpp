@@ -58,13 +58,13 @@ Box::Box()
     upper_(Vector3d::Constant(1.0)) {}
 
 // Inherited from Environment, but can be overwritten by child classes.
-Vector3d Box::Sample() const {
+Vector3d Box::Sample(std::default_random_engine& rng) const {
   Vector3d sample;
 
   // Sample each dimension from this distribution.
   for (size_t ii = 0; ii < 3; ii++) {
     std::uniform_real_distribution<double> unif(lower_(ii), upper_(ii));
-    sample(ii) = unif(rng_);
+    sample(ii) = unif(rng);
   }
 
   return sample;
@@ -84,36 +84,101 @@ bool Box::IsValid(const Vector3d& position,
   }
 #endif
 
-  // Make sure server is up.
-  if (!switching_bound_srv_) {
-    ROS_WARN("%s: Switching bound server disconnected.", name_.c_str());
-
-    ros::NodeHandle nl;
-    switching_bound_srv_ = nl.serviceClient<value_function_srvs::SwitchingTrackingBoundBox>(
-      switching_bound_name_.c_str(), true);
+  // Make sure we have value functions to query.
+  if (!values_) {
+    ROS_WARN_THROTTLE(1.0, "%s: No value functions to collision check with.",
+                      name_.c_str());
     return false;
   }
 
   // No obstacles. Just check bounds.
-  value_function_srvs::SwitchingTrackingBoundBox bound;
-  bound.request.from_id = incoming_value;
-  bound.request.to_id = outgoing_value;
-  if (!switching_bound_srv_.call(bound)) {
-    ROS_ERROR("%s: Error calling switching bound server.", name_.c_str());
+  Vector3d bound;
+  if (!values_->SwitchingTrackingBound(incoming_value, outgoing_value, bound)) {
+    ROS_ERROR("%s: Error computing switching bound.", name_.c_str());
     return false;
   }
 
-  if (position(0) < lower_(0) + bound.response.x ||
-      position(0) > upper_(0) - bound.response.x ||
-      position(1) < lower_(1) + bound.response.y ||
-      position(1) > upper_(1) - bound.response.y ||
-      position(2) < lower_(2) + bound.response.z ||
-      position(2) > upper_(2) - bound.response.z)
-      return false;
+  if (position(0) < lower_(0) + bound(0) ||
+      position(0) > upper_(0) - bound(0) ||
+      position(1) < lower_(1) + bound(1) ||
+      position(1) > upper_(1) - bound(1) ||
+      position(2) < lower_(2) + bound(2) ||
+      position(2) > upper_(2) - bound(2))
+    return false;
 
   return true;
 }
 
+// Inherited from Environment, but can be overwritten by child classes.
+// Since the box is convex, a segment is valid if its endpoints are.
+bool Box::IsValidSegment(const Vector3d& start, const Vector3d& stop,
+                         ValueFunctionId incoming_value,
+                         ValueFunctionId outgoing_value) const {
+  return Box::IsValid(start, incoming_value, outgoing_value) &&
+    Box::IsValid(stop, incoming_value, outgoing_value);
+}
+
+// Squared distance from a point to a box with the given half-widths,
+// swept along the segment from start to stop. As a function of the
+// fraction along the segment, this is a convex piecewise quadratic which
+// only changes pieces where the point crosses a face of the box. Minimize
+// each piece in closed form and take the smallest.
+double Box::SweptBoxSquaredDistance(const Vector3d& start,
+                                    const Vector3d& stop,
+                                    const Vector3d& bound,
+                                    const Vector3d& point) {
+  const Vector3d direction = stop - start;
+  const Vector3d offset = point - start;
+
+  // Fractions along the segment where the point crosses a face. There are
+  // at most two per dimension, besides the endpoints.
+  std::array<double, 8> breaks;
+  breaks[0] = 0.0;
+  breaks[1] = 1.0;
+  size_t num_breaks = 2;
+  for (size_t jj = 0; jj < 3; jj++) {
+    if (std::abs(direction(jj)) < 1e-12)
+      continue;
+
+    for (const double face : { -bound(jj), bound(jj) }) {
+      const double crossing = (offset(jj) - face) / direction(jj);
+      if (crossing > 0.0 && crossing < 1.0)
+        breaks[num_breaks++] = crossing;
+    }
+  }
+
+  std::sort(breaks.begin(), breaks.begin() + num_breaks);
+
+  double best = std::numeric_limits<double>::infinity();
+  for (size_t ii = 0; ii + 1 < num_breaks; ii++) {
+    // On this piece, the gap in each dimension where the point is outside
+    // the box is c - e * t at fraction t. Other dimensions contribute zero.
+    const double mid = 0.5 * (breaks[ii] + breaks[ii + 1]);
+
+    Vector3d c = Vector3d::Zero();
+    Vector3d e = Vector3d::Zero();
+    for (size_t jj = 0; jj < 3; jj++) {
+      const double gap = offset(jj) - mid * direction(jj);
+      if (std::abs(gap) > bound(jj)) {
+        const double sign = (gap > 0.0) ? 1.0 : -1.0;
+        c(jj) = sign * offset(jj) - bound(jj);
+        e(jj) = sign * direction(jj);
+      }
+    }
+
+    // Minimize the sum of squared gaps over this piece.
+    double fraction = mid;
+    if (e.squaredNorm() > 0.0) {
+      fraction = std::min(breaks[ii + 1],
+                          std::max(breaks[ii], c.dot(e) / e.squaredNorm()));
+    }
+
+    best = std::min(best, (c - fraction * e).squaredNorm());
+  }
+
+  return best;
+}
+
 // Inherited by Environment, but can be overwritten by child classes.
 // Assumes that the first <=3 dimensions correspond to R^3.
 void Box::Visualize(const ros::Publisher& pub,
@@ -153,13 +218,16 @@ void Box::Visualize(const ros::Publisher& pub,
   cube.pose.orientation.w = 1.0;
 
   // Publish marker.
-  pub.publish(cube);
+  visualization_msgs::MarkerArray markers;
+  markers.markers.push_back(cube);
+  pub.publish(markers);
 }
 
 // Set bounds in each dimension.
 void Box::SetBounds(const Vector3d& lower, const Vector3d& upper) {
   lower_ = lower;
   upper_ = upper;
+  version_++;
 }
 
 } //\namespace meta
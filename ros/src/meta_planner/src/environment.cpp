@@ -45,8 +45,10 @@
 namespace meta {
 
 // Initialize this class from a ROS node.
-bool Environment::Initialize(const ros::NodeHandle& n) {
+bool Environment::Initialize(const ros::NodeHandle& n,
+                             const ValueFunctionProvider::ConstPtr& values) {
   name_ = ros::names::append(n.getNamespace(), "environment");
+  values_ = values;
 
   if (!LoadParameters(n)) {
     ROS_ERROR("%s: Failed to load parameters.", name_.c_str());
@@ -62,25 +64,30 @@ bool Environment::Initialize(const ros::NodeHandle& n) {
   return true;
 }
 
-// Load all parameters.
-bool Environment::LoadParameters(const ros::NodeHandle& n) {
-  ros::NodeHandle nl(n);
+// Visualize, but only if this environment has changed since it was last
+// visualized, and no sooner than min_period seconds after that.
+void Environment::ThrottledVisualize(const ros::Publisher& pub,
+                                     const std::string& frame_id,
+                                     double min_period) const {
+  if (version_ == visualized_version_ || pub.getNumSubscribers() <= 0)
+    return;
 
-  // Switching bound.
-  if (!nl.getParam("srv/switching_bound", switching_bound_name_)) return false;
+  const ros::Time now = ros::Time::now();
+  if (visualized_version_ > 0 && (now - visualized_time_).toSec() < min_period)
+    return;
+
+  Visualize(pub, frame_id);
+  visualized_version_ = version_;
+  visualized_time_ = now;
+}
 
+// Load all parameters.
+bool Environment::LoadParameters(const ros::NodeHandle& n) {
   return true;
 }
 
 // Register all callbacks and publishers.
 bool Environment::RegisterCallbacks(const ros::NodeHandle& n) {
-  ros::NodeHandle nl(n);
-
-  // Server.
-  ros::service::waitForService(switching_bound_name_.c_str());
-  switching_bound_srv_ = nl.serviceClient<value_function_srvs::SwitchingTrackingBoundBox>(
-    switching_bound_name_.c_str(), true);
-
   return true;
 }
 
@@ -67,6 +67,13 @@ bool MetaPlanner::Initialize(const ros::NodeHandle& n) {
     return false;
   }
 
+  // Set up value functions.
+  values_ = ValueFunctionProvider::Create(n);
+  if (values_ == nullptr) {
+    ROS_ERROR("%s: Failed to set up value functions.", name_.c_str());
+    return false;
+  }
+
   // Set control upper/lower bounds as Eigen::Vectors.
   VectorXd control_upper_vec(control_dim_);
   VectorXd control_lower_vec(control_dim_);
@@ -80,7 +87,7 @@ bool MetaPlanner::Initialize(const ros::NodeHandle& n) {
 
   // Initialize state space.
   space_ = BallsInBox::Create();
-  if (!space_->Initialize(n)) {
+  if (!space_->Initialize(n, values_)) {
     ROS_ERROR("%s: Failed to initialize BallsInBox.", name_.c_str());
     return false;
   }
@@ -97,13 +104,14 @@ bool MetaPlanner::Initialize(const ros::NodeHandle& n) {
                     dynamics_->Puncture(state_upper_vec));
 
   space_->Seed(seed_);
+  rng_.seed(seed_);
 
   // Create planners.
   for (ValueFunctionId ii = 0; ii < num_value_functions_ - 1; ii += 2) {
     const Planner::Ptr planner =
       OmplPlanner<og::BITstar>::Create(ii, ii + 1, space_, dynamics_);
 
-    if (!planner->Initialize(n)) {
+    if (!planner->Initialize(n, values_)) {
       ROS_ERROR("%s: Failed to initialize planner.", name_.c_str());
       return false;
     }
@@ -115,7 +123,7 @@ bool MetaPlanner::Initialize(const ros::NodeHandle& n) {
   ompl::msg::setLogLevel(ompl::msg::LogLevel::LOG_ERROR);
 
   // Publish environment.
-  space_->Visualize(env_pub_, fixed_frame_id_);
+  space_->ThrottledVisualize(env_pub_, fixed_frame_id_, env_vis_period_);
 
   initialized_ = true;
   return true;
@@ -136,6 +144,15 @@ bool MetaPlanner::LoadParameters(const ros::NodeHandle& n) {
   if (!nl.getParam("max_connection_radius", max_connection_radius_))
     return false;
 
+  // Whether to run all candidate planners for a sample at once.
+  nl.param("speculative_planning", speculative_planning_, false);
+
+  // Number of threads to plan with. Zero means one per core.
+  int num_threads = 0;
+  nl.param("num_threads", num_threads, num_threads);
+  num_threads_ = (num_threads > 0) ? static_cast<size_t>(num_threads) :
+    std::max(1u, std::thread::hardware_concurrency());
+
   int dimension = 1;
   if (!nl.getParam("control/dim", dimension)) return false;
   control_dim_ = static_cast<size_t>(dimension);
@@ -175,17 +192,17 @@ bool MetaPlanner::LoadParameters(const ros::NodeHandle& n) {
   if (!nl.getParam("goal/z", goal_z)) return false;
   goal_ = Vector3d(goal_x, goal_y, goal_z);
 
-  // Service names.
-  if (!nl.getParam("srv/tracking_bound", bound_name_)) return false;
-  if (!nl.getParam("srv/best_time", best_time_name_)) return false;
-  if (!nl.getParam("srv/switching_time", switching_time_name_)) return false;
-  if (!nl.getParam("srv/switching_distance", switching_distance_name_))
-    return false;
-
   // Topics and frame ids.
   if (!nl.getParam("topics/sensor", sensor_topic_)) return false;
   if (!nl.getParam("topics/vis/known_environment", env_topic_)) return false;
+  // Environment visualization rate.
+  double env_vis_rate = 5.0;
+  nl.param("vis/env_rate", env_vis_rate, env_vis_rate);
+  env_vis_period_ = 1.0 / std::max(env_vis_rate, 1e-3);
   if (!nl.getParam("topics/traj", traj_topic_)) return false;
+  nl.param<std::string>("topics/flat_traj", flat_traj_topic_, "");
+  nl.param<std::string>("topics/traj_patch", traj_patch_topic_, "");
+  nl.param<std::string>("topics/poly_traj", poly_traj_topic_, "");
   if (!nl.getParam("topics/state", state_topic_)) return false;
   if (!nl.getParam("topics/request_traj", request_traj_topic_)) return false;
   if (!nl.getParam("topics/trigger_replan", trigger_replan_topic_)) return false;
@@ -200,23 +217,6 @@ bool MetaPlanner::LoadParameters(const ros::NodeHandle& n) {
 bool MetaPlanner::RegisterCallbacks(const ros::NodeHandle& n) {
   ros::NodeHandle nl(n);
 
-  // Services.
-  ros::service::waitForService(bound_name_.c_str());
-  bound_srv_ = nl.serviceClient<value_function_srvs::TrackingBoundBox>(
-    bound_name_.c_str(), true);
-
-  ros::service::waitForService(best_time_name_.c_str());
-  best_time_srv_ = nl.serviceClient<value_function_srvs::GeometricPlannerTime>(
-    best_time_name_.c_str(), true);
-
-  ros::service::waitForService(switching_time_name_.c_str());
-  switching_time_srv_ = nl.serviceClient<value_function_srvs::GuaranteedSwitchingTime>(
-    switching_time_name_.c_str(), true);
-
-  ros::service::waitForService(switching_distance_name_.c_str());
-  switching_distance_srv_ = nl.serviceClient<value_function_srvs::GuaranteedSwitchingDistance>(
-    switching_distance_name_.c_str(), true);
-
   // Subscribers.
   sensor_sub_ = nl.subscribe(
     sensor_topic_.c_str(), 1, &MetaPlanner::SensorCallback, this);
@@ -231,8 +231,8 @@ bool MetaPlanner::RegisterCallbacks(const ros::NodeHandle& n) {
     in_flight_topic_.c_str(), 1, &MetaPlanner::InFlightCallback, this);
 
   // Visualization publisher(s).
-  env_pub_ = nl.advertise<visualization_msgs::Marker>(
-    env_topic_.c_str(), 1, false);
+  env_pub_ = nl.advertise<visualization_msgs::MarkerArray>(
+    env_topic_.c_str(), 1, true);
 
   // Triggering a replan event.
   trigger_replan_pub_ = nl.advertise<std_msgs::Empty>(
@@ -242,6 +242,18 @@ bool MetaPlanner::RegisterCallbacks(const ros::NodeHandle& n) {
   traj_pub_ = nl.advertise<meta_planner_msgs::Trajectory>(
     traj_topic_.c_str(), 1, false);
 
+  if (!flat_traj_topic_.empty())
+    flat_traj_pub_ = nl.advertise<meta_planner_msgs::FlatTrajectory>(
+      flat_traj_topic_.c_str(), 1, false);
+
+  if (!traj_patch_topic_.empty())
+    traj_patch_pub_ = nl.advertise<meta_planner_msgs::TrajectoryPatch>(
+      traj_patch_topic_.c_str(), 1, false);
+
+  if (!poly_traj_topic_.empty())
+    poly_traj_pub_ = nl.advertise<meta_planner_msgs::PolynomialTrajectory>(
+      poly_traj_topic_.c_str(), 1, false);
+
   return true;
 }
 
@@ -276,13 +288,12 @@ SensorCallback(const meta_planner_msgs::SensorMeasurement::ConstPtr& msg) {
     }
   }
 
-  if (unseen_obstacle) {
-    // Trigger a replan.
+  // Trigger a replan.
+  if (unseen_obstacle)
     trigger_replan_pub_.publish(std_msgs::Empty());
 
-    // Publish environment.
-    space_->Visualize(env_pub_, fixed_frame_id_);
-  }
+  // Publish environment, if it has changed.
+  space_->ThrottledVisualize(env_pub_, fixed_frame_id_, env_vis_period_);
 }
 
 // Callback to handle requests for new trajectory.
@@ -304,37 +315,20 @@ void MetaPlanner::RequestTrajectoryCallback(
 
   const Vector3d start_position = dynamics_->Puncture(start_state);
 
-  // Make sure bound server is up.
-  if (!bound_srv_) {
-    ROS_WARN("%s: Tracking bound server disconnected.", name_.c_str());
-
-    ros::NodeHandle nl;
-    bound_srv_ = nl.serviceClient<value_function_srvs::TrackingBoundBox>(
-      bound_name_.c_str(), true);
-    return;
-  }
-
   // Get the tracking bound for this planner.
-  double bound_x = 0.0;
-  double bound_y = 0.0;
-  double bound_z = 0.0;
-
-  value_function_srvs::TrackingBoundBox b;
-  b.request.id = planners_.back()->GetOutgoingValueFunction();
-  if (!bound_srv_.call(b))
-    ROS_ERROR("%s: Error calling tracking bound server.", name_.c_str());
-  else {
-    bound_x = b.response.x;
-    bound_y = b.response.y;
-    bound_z = b.response.z;
+  Vector3d bound = Vector3d::Zero();
+  if (!values_->TrackingBound(
+        planners_.back()->GetOutgoingValueFunction(), bound)) {
+    ROS_ERROR("%s: Error computing tracking bound.", name_.c_str());
+    bound = Vector3d::Zero();
   }
 
   // Check if the start position is close to the goal. If so, just return
   // a hover trajectory at the goal (assuming the least aggressive planner).
   if (reached_goal_ ||
-      (std::abs(start_position(0) - goal_(0)) < bound_x &&
-       std::abs(start_position(1) - goal_(1)) < bound_y &&
-       std::abs(start_position(2) - goal_(2)) < bound_z))
+      (std::abs(start_position(0) - goal_(0)) < bound(0) &&
+       std::abs(start_position(1) - goal_(1)) < bound(1) &&
+       std::abs(start_position(2) - goal_(2)) < bound(2)))
     reached_goal_ = true;
 
   if (reached_goal_) {
@@ -352,26 +346,14 @@ void MetaPlanner::RequestTrajectoryCallback(
     const ValueFunctionId control_value =
       planners_.back()->GetOutgoingValueFunction();
 
-    // Make sure switching time server is up.
-    if (!switching_time_srv_) {
-      ROS_WARN("%s: Switching time server disconnected.", name_.c_str());
-
-      ros::NodeHandle nl;
-      switching_time_srv_ = nl.serviceClient<value_function_srvs::GuaranteedSwitchingTime>(
-        switching_time_name_.c_str(), true);
-      return;
-    }
-
     // Get times.
     double switching_time = 10.0;
-    value_function_srvs::GuaranteedSwitchingTime t;
-    t.request.from_id = bound_value;
-    t.request.to_id = control_value;
-    if (!switching_time_srv_.call(t))
-      ROS_ERROR("%s: Error calling switching time server.", name_.c_str());
+    Vector3d switching_times;
+    if (!values_->GuaranteedSwitchingTime(
+          bound_value, control_value, switching_times))
+      ROS_ERROR("%s: Error computing switching time.", name_.c_str());
     else
-      switching_time = std::max(std::max(t.response.x, t.response.y),
-                                t.response.z);
+      switching_time = switching_times.maxCoeff();
 
     const std::vector<double> times =
       { current_time.toSec(),
@@ -389,9 +371,9 @@ void MetaPlanner::RequestTrajectoryCallback(
     // Construct trajectory and publish.
     const Trajectory::Ptr hover =
       Trajectory::Create(times, states, control_values, bound_values);
+    Publish(hover, PolynomialTrajectory::Create(
+      times, positions, control_values, bound_values));
     traj_ = hover;
-
-    traj_pub_.publish(hover->ToRosMessage());
     return;
   }
 
@@ -412,6 +394,8 @@ void MetaPlanner::RequestTrajectoryCallback(
 // (5) Try to connect to the goal point.
 // (6) Stop when we have a feasible trajectory. Otherwise go to (2).
 // (7) When finished, convert to a message and publish.
+// Steps (2) through (6) run on several threads at once, each with its own
+// random engine, all growing the same tree.
 bool MetaPlanner::Plan(const Vector3d& start, const Vector3d& stop,
                        double start_time) {
   // Only plan if position has been updated.
@@ -426,98 +410,119 @@ bool MetaPlanner::Plan(const Vector3d& start, const Vector3d& stop,
 
   WaypointTree tree(start, start_value, start_time);
 
-  bool found = false;
-  while ((ros::Time::now() - current_time).toSec() < max_runtime_) {
-    // (2) Sample a new point in the state space.
-    Vector3d sample = space_->Sample();
-
-    // Throw out this sample if it could never lead to a faster trajectory than
-    // the best one currently.
-    // NOTE! This test assumes that the first planner is the fastest.
-    // NOTE! If no valid trajectory has been found, the tree's best time will
-    // be infinite, so this test will automatically fail.
-    if (planners_.front()->BestPossibleTime(start, sample) +
-        planners_.front()->BestPossibleTime(sample, stop) > tree.BestTime())
-      continue;
-
-    // (3) Find the nearest neighbor.
-    const size_t kNumNeighbors = 1;
-    const std::vector<Waypoint::ConstPtr> neighbors =
-      tree.KnnSearch(sample, kNumNeighbors);
-
-    // Throw out this sample if too far from the nearest point.
-    if (neighbors.size() != kNumNeighbors ||
-        (neighbors[0]->point_ - sample).norm() > max_connection_radius_)
-      continue;
-
-    Waypoint::ConstPtr neighbor = neighbors[0];
-
-    // Extract value function and corresponding planner ID from last waypoint.
-    // If value is null, (i.e. at root) then set to planners_.size() since
-    // any planner is valid from the root. Convert value ID to planner ID
-    // by dividing by 2 since each planner has two value functions.
-    const Trajectory::ConstPtr neighbor_traj = neighbor->traj_;
-    const ValueFunctionId neighbor_val = neighbor->value_;
-
-    const size_t neighbor_planner_id = neighbor_val / 2;
-
-    // (4) Plan a trajectory (starting with the most aggressive planner and ending
-    // with the next-most cautious planner).
-    Trajectory::Ptr traj;
-    ValueFunctionId value_used;
-    for (size_t ii = 0;
-         ii < std::min(neighbor_planner_id + 2, planners_.size()); ii++) {
-      const Planner::ConstPtr planner = planners_[ii];
-
-      value_used = planner->GetIncomingValueFunction();
-      const ValueFunctionId possible_next_value =
-        planner->GetOutgoingValueFunction();
-
-      // Make sure switching distance server is up.
-      if (!switching_distance_srv_) {
-        ROS_WARN("%s: Switching distance server disconnected.", name_.c_str());
-
-        ros::NodeHandle nl;
-        switching_distance_srv_ = nl.serviceClient<value_function_srvs::GuaranteedSwitchingDistance>(
-          switching_distance_name_.c_str(), true);
-        return false;
-      }
+  std::atomic<bool> found(false);
+  std::atomic<size_t> num_samples(0);
+  std::atomic<size_t> num_extensions(0);
 
-      // Get the tracking bound for this planner.
-      double switch_x = 0.0;
-      double switch_y = 0.0;
-      double switch_z = 0.0;
-
-      value_function_srvs::GuaranteedSwitchingDistance d;
-      d.request.from_id = value_used;
-      d.request.to_id = possible_next_value;
-      if (!switching_distance_srv_.call(d))
-        ROS_ERROR("%s: Error calling switching distance server.", name_.c_str());
-      else {
-        switch_x = d.response.x;
-        switch_y = d.response.y;
-        switch_z = d.response.z;
-      }
+  // Planner statistics before this plan, to report how this plan went.
+  size_t queries_before = 0;
+  size_t direct_connections_before = 0;
+  for (const auto& planner : planners_) {
+    queries_before += planner->NumQueries();
+    direct_connections_before += planner->NumDirectConnections();
+  }
+
+  // Each worker extends the tree until time runs out.
+  auto worker = [&](unsigned int seed) {
+    std::default_random_engine rng(seed);
+    while ((ros::Time::now() - current_time).toSec() < max_runtime_) {
+      // (2) Sample a new point in the state space.
+      Vector3d sample = space_->Sample(rng);
+      num_samples++;
+
+      // Throw out this sample if it could never lead to a faster trajectory
+      // than the best one currently.
+      // NOTE! This test assumes that the first planner is the fastest.
+      // NOTE! If no valid trajectory has been found, the tree's best time will
+      // be infinite, so this test will automatically fail.
+      if (planners_.front()->BestPossibleTime(start, sample) +
+          planners_.front()->BestPossibleTime(sample, stop) > tree.BestTime())
+        continue;
 
-      // Since we might always end up switching, make sure this point
-      // is not closer than the guaranteed switching distance.
-      // NOTE! This enforces backtracking only one planner at a time.
-      // In full generality, we would just need to replace possible_next_value
-      // with the most cautious value.
-      if (std::abs(neighbor->point_(0) - sample(0)) < switch_x &&
-          std::abs(neighbor->point_(1) - sample(1)) < switch_y &&
-          std::abs(neighbor->point_(2) - sample(2)) < switch_z)
+      // (3) Find the nearest neighbor.
+      const size_t kNumNeighbors = 1;
+      const std::vector<Waypoint::ConstPtr> neighbors =
+        tree.KnnSearch(sample, kNumNeighbors);
+
+      // Throw out this sample if too far from the nearest point.
+      if (neighbors.size() != kNumNeighbors ||
+          (neighbors[0]->point_ - sample).norm() > max_connection_radius_)
         continue;
 
-      // Plan using 10% of the available total runtime.
+      Waypoint::ConstPtr neighbor = neighbors[0];
+
+      // Extract value function and corresponding planner ID from last waypoint.
+      // If value is null, (i.e. at root) then set to planners_.size() since
+      // any planner is valid from the root. Convert value ID to planner ID
+      // by dividing by 2 since each planner has two value functions.
+      const Trajectory::ConstPtr neighbor_traj = neighbor->traj_;
+      const ValueFunctionId neighbor_val = neighbor->value_;
+
+      const size_t neighbor_planner_id = neighbor_val / 2;
+
+      // (4) Plan a trajectory (starting with the most aggressive planner and
+      // ending with the next-most cautious planner). First find which
+      // planners could be used, in order of preference.
+      std::vector<size_t> candidates;
+      for (size_t ii = 0;
+           ii < std::min(neighbor_planner_id + 2, planners_.size()); ii++) {
+        const Planner::ConstPtr planner = planners_[ii];
+
+        const ValueFunctionId value = planner->GetIncomingValueFunction();
+        const ValueFunctionId possible_next_value =
+          planner->GetOutgoingValueFunction();
+
+        // Get the switching distance for this planner.
+        Vector3d switch_distance = Vector3d::Zero();
+        if (!values_->GuaranteedSwitchingDistance(
+              value, possible_next_value, switch_distance)) {
+          ROS_ERROR("%s: Error computing switching distance.", name_.c_str());
+          switch_distance = Vector3d::Zero();
+        }
+
+        // Since we might always end up switching, make sure this point
+        // is not closer than the guaranteed switching distance.
+        // NOTE! This enforces backtracking only one planner at a time.
+        // In full generality, we would just need to replace possible_next_value
+        // with the most cautious value.
+        if (std::abs(neighbor->point_(0) - sample(0)) < switch_distance(0) &&
+            std::abs(neighbor->point_(1) - sample(1)) < switch_distance(1) &&
+            std::abs(neighbor->point_(2) - sample(2)) < switch_distance(2))
+          continue;
+
+        candidates.push_back(ii);
+      }
+
+      // Plan using 10% of the available total runtime, with the first
+      // candidate that succeeds. Either try them one at a time, or all at
+      // once, cancelling those after the first success in order.
       // NOTE! This is just a heuristic and could easily be changed.
       const double time = (neighbor_traj == nullptr) ?
         start_time : neighbor_traj->LastTime();
 
-      traj = planner->Plan(neighbor->point_, sample, time, 0.1 * max_runtime_);
+      PolynomialTrajectory::Ptr poly;
+      size_t ii = 0;
+      if (speculative_planning_ && candidates.size() > 1) {
+        poly = PlanSpeculatively(
+          candidates, neighbor->point_, sample, time, ii);
+      } else {
+        for (size_t jj = 0; jj < candidates.size() && poly == nullptr; jj++) {
+          ii = candidates[jj];
+          poly = planners_[ii]->PlanPolynomial(
+            neighbor->point_, sample, time, 0.1 * max_runtime_);
+        }
+      }
 
+      // Keep the polynomials as planned, to publish them as they are, and
+      // sample them at their knots for the tree.
+      Trajectory::Ptr traj =
+        (poly == nullptr) ? nullptr : poly->ToTrajectory(dynamics_);
+
+      ValueFunctionId value_used = 0;
       if (traj != nullptr) {
         // When we succeed...
+        value_used = planners_[ii]->GetIncomingValueFunction();
+
         // If we just planned with a more cautious planner than the one used
         // by the nearest neighbor, do a 1-step backtrack.
         if (ii > neighbor_planner_id) {
@@ -532,115 +537,230 @@ bool MetaPlanner::Plan(const Vector3d& start, const Vector3d& stop,
                                   neighbor->point_(1) + 1e-4,
                                   neighbor->point_(2) + 1e-4);
 
-          const double time = (neighbor_traj == nullptr) ?
+          const double first_time = (neighbor_traj == nullptr) ?
             start_time : neighbor_traj->FirstTime();
 
-          if (time <= start_time + 1e-8) {
-            ROS_INFO_THROTTLE(1.0, "%s: Tried to clone the root.", name_.c_str());
+          if (first_time <= start_time + 1e-8) {
+            ROS_INFO_THROTTLE(1.0, "%s: Tried to clone the root.",
+                              name_.c_str());
 
             // Didn't really succeed. Can't clone the root in general.
             traj = nullptr;
+            poly = nullptr;
           } else {
             Waypoint::ConstPtr clone =
               Waypoint::Create(jittered,
                                value_used,
-                               Trajectory::Create(neighbor_traj, time),
+                               Trajectory::Create(neighbor_traj, first_time),
+                               std::make_shared<PolynomialTrajectory>(
+                                 *neighbor->poly_),
                                neighbor->parent_);
 
-            // Swap out the control value function in the neighbor's trajectory
-            // and update time stamps accordingly.
-            clone->traj_->ExecuteSwitch(value_used, best_time_srv_);
+            // Swap out the control value function in the neighbor's
+            // trajectory and update time stamps accordingly.
+            clone->traj_->ExecuteSwitch(value_used, values_);
+            clone->poly_->ExecuteSwitch(value_used, values_);
 
             // Insert the clone.
             tree.Insert(clone, false);
 
-            // Adjust the time stamps for the new trajectory to occur after the
-            // updated neighbor's trajectory.
+            // Adjust the time stamps for the new trajectory to occur after
+            // the updated neighbor's trajectory.
             traj->ResetStartTime(clone->traj_->LastTime());
+            poly->ResetStartTime(clone->traj_->LastTime());
 
             // Neighbor is now clone.
             neighbor = clone;
           }
         }
-
-        break;
       }
-    }
 
-    // Check if we could found a trajectory to this sample.
-    if (traj == nullptr)
-      continue;
-
-    // Insert the sample.
-    const Waypoint::ConstPtr waypoint = Waypoint::Create(
-      sample, value_used, traj, neighbor);
-
-    tree.Insert(waypoint, false);
-
-    // (5) Try to connect to the goal point.
-    Trajectory::Ptr goal_traj;
-    ValueFunctionId goal_value_used;
-    const size_t planner_used_id = value_used / 2;
+      // Check if we could found a trajectory to this sample.
+      if (traj == nullptr)
+        continue;
 
-    if ((sample - stop).norm() <= max_connection_radius_) {
-      for (size_t ii = 0;
-           ii < std::min(planner_used_id + 2, planners_.size()); ii++) {
-        const Planner::ConstPtr planner = planners_[ii];
-        goal_value_used = planner->GetIncomingValueFunction();
-
-        // We are never gonna need to switch if this succeeds.
-        // Plan using 10% of the available total runtime.
-        // NOTE! This is just a heuristic and could easily be changed.
-        goal_traj =
-          planner->Plan(sample, stop, traj->LastTime(), 0.1 * max_runtime_);
-
-        if (goal_traj != nullptr) {
-          // When we succeed... don't need to clone because waypoint has no kids.
-          // If we just planned with a more cautious planner than the one used
-          // by the nearest neighbor, do a 1-step backtrack.
-          if (ii > neighbor_planner_id) {
-            // Swap out the control value function in the neighbor's trajectory
-            // and update time stamps accordingly.
-            waypoint->traj_->ExecuteSwitch(goal_value_used, best_time_srv_);
-
-            // Adjust the time stamps for the new trajectory to occur after the
-            // updated neighbor's trajectory.
-            goal_traj->ResetStartTime(waypoint->traj_->LastTime());
+      num_extensions++;
+
+      // Create the sample's waypoint. Other workers may read it as soon as
+      // it is in the tree, so only insert it after connecting to the goal,
+      // which may modify its trajectory.
+      const Waypoint::ConstPtr waypoint = Waypoint::Create(
+        sample, value_used, traj, poly, neighbor);
+
+      // (5) Try to connect to the goal point.
+      Trajectory::Ptr goal_traj;
+      PolynomialTrajectory::Ptr goal_poly;
+      ValueFunctionId goal_value_used;
+      const size_t planner_used_id = value_used / 2;
+
+      if ((sample - stop).norm() <= max_connection_radius_) {
+        for (size_t ii = 0;
+             ii < std::min(planner_used_id + 2, planners_.size()); ii++) {
+          const Planner::ConstPtr planner = planners_[ii];
+          goal_value_used = planner->GetIncomingValueFunction();
+
+          // We are never gonna need to switch if this succeeds.
+          // Plan using 10% of the available total runtime.
+          // NOTE! This is just a heuristic and could easily be changed.
+          goal_poly = planner->PlanPolynomial(
+            sample, stop, traj->LastTime(), 0.1 * max_runtime_);
+
+          if (goal_poly != nullptr) {
+            goal_traj = goal_poly->ToTrajectory(dynamics_);
+
+            // When we succeed... don't need to clone because waypoint has no
+            // kids.
+            // If we just planned with a more cautious planner than the one used
+            // by the nearest neighbor, do a 1-step backtrack.
+            if (ii > neighbor_planner_id) {
+              // Swap out the control value function in the neighbor's
+              // trajectory and update time stamps accordingly.
+              waypoint->traj_->ExecuteSwitch(goal_value_used, values_);
+              waypoint->poly_->ExecuteSwitch(goal_value_used, values_);
+
+              // Adjust the time stamps for the new trajectory to occur after
+              // the updated neighbor's trajectory.
+              goal_traj->ResetStartTime(waypoint->traj_->LastTime());
+              goal_poly->ResetStartTime(waypoint->traj_->LastTime());
+            }
+
+            break;
           }
-
-          break;
         }
       }
-    }
 
-    // (6) If this sample was connected to the goal, update the tree terminus.
-    if (goal_traj != nullptr) {
-      // Connect to the goal.
-      // NOTE: the first point in goal_traj coincides with the last point in
-      // traj, but when we merge the two trajectories the std::map insertion
-      // rules will prevent duplicates.
-      const Waypoint::ConstPtr goal = Waypoint::Create(
-        stop, value_used, goal_traj, waypoint);
+      // Insert the sample.
+      tree.Insert(waypoint, false);
+
+      // (6) If this sample was connected to the goal, update the tree terminus.
+      if (goal_traj != nullptr) {
+        // Connect to the goal.
+        // NOTE: the first point in goal_traj coincides with the last point in
+        // traj, but when we merge the two trajectories the std::map insertion
+        // rules will prevent duplicates.
+        const Waypoint::ConstPtr goal = Waypoint::Create(
+          stop, value_used, goal_traj, goal_poly, waypoint);
 
-      tree.Insert(goal, true);
+        tree.Insert(goal, true);
 
-      // Mark that we've found a valid trajectory.
-      found = true;
+        // Mark that we've found a valid trajectory.
+        found = true;
+      }
     }
+  };
+
+  // Run one worker on this thread and the rest alongside it. Speculative
+  // workers each run up to one planner per candidate at once, so run fewer
+  // of them to stay within num_threads_ in total.
+  const size_t num_workers = (speculative_planning_) ?
+    std::max<size_t>(1, num_threads_ / planners_.size()) : num_threads_;
+
+  std::vector<std::thread> workers;
+  for (size_t ii = 1; ii < num_workers; ii++)
+    workers.emplace_back(worker, static_cast<unsigned int>(rng_()));
+
+  worker(static_cast<unsigned int>(rng_()));
+  for (auto& thread : workers)
+    thread.join();
+
+  const double elapsed = (ros::Time::now() - current_time).toSec();
+  size_t num_queries = 0;
+  size_t num_direct_connections = 0;
+  for (const auto& planner : planners_) {
+    num_queries += planner->NumQueries();
+    num_direct_connections += planner->NumDirectConnections();
   }
 
+  num_queries -= queries_before;
+  num_direct_connections -= direct_connections_before;
+
+  ROS_INFO("%s: Extended the tree %zu times on %zu threads.",
+           name_.c_str(), num_extensions.load(), num_workers);
+  ROS_INFO("%s: Drew %.1f samples per second. Connected %zu of %zu "
+           "planner queries directly.", name_.c_str(),
+           num_samples / std::max(elapsed, 1e-8),
+           num_direct_connections, num_queries);
+
   if (found) {
     // Get the best (fastest) trajectory out of the tree.
     const Trajectory::ConstPtr best = tree.BestTrajectory();
     ROS_INFO("%s: Publishing trajectory of length %zu.",
              name_.c_str(), best->Size());
 
+    Publish(best, tree.BestPolynomialTrajectory());
     traj_ = best;
-    traj_pub_.publish(best->ToRosMessage());
     return true;
   }
 
   return false;
 }
 
+// Plan from start to stop with all the given planners at once, listed in
+// order of preference. Returns the first success in that order, and sets
+// the ID of the planner which found it. Planners after the first success so
+// far are cancelled.
+PolynomialTrajectory::Ptr MetaPlanner::
+PlanSpeculatively(const std::vector<size_t>& candidates,
+                  const Vector3d& start, const Vector3d& stop,
+                  double start_time, size_t& planner_id) const {
+  // Index (into candidates) of the first success so far.
+  std::atomic<size_t> first_success(candidates.size());
+
+  // Run the candidate with the given index, cancelling everything after it
+  // if it succeeds.
+  const auto run = [&](size_t ii) {
+    const PolynomialTrajectory::Ptr poly =
+      planners_[candidates[ii]]->PlanPolynomial(
+        start, stop, start_time, 0.1 * max_runtime_,
+        [&first_success, ii]() { return first_success < ii; });
+
+    if (poly != nullptr) {
+      size_t first = first_success;
+      while (ii < first &&
+             !first_success.compare_exchange_weak(first, ii)) {}
+    }
+
+    return poly;
+  };
+
+  // Run the most preferred candidate on this thread, and the rest alongside.
+  std::vector< std::future<PolynomialTrajectory::Ptr> > results;
+  for (size_t ii = 1; ii < candidates.size(); ii++)
+    results.push_back(std::async(std::launch::async, run, ii));
+
+  PolynomialTrajectory::Ptr best = run(0);
+  if (best != nullptr)
+    planner_id = candidates[0];
+
+  // Wait for the rest, and take the first success in order.
+  for (size_t ii = 1; ii < candidates.size(); ii++) {
+    const PolynomialTrajectory::Ptr poly = results[ii - 1].get();
+    if (best == nullptr && poly != nullptr) {
+      best = poly;
+      planner_id = candidates[ii];
+    }
+  }
+
+  return best;
+}
+
+// Publish a trajectory in each format that anyone is listening for: the
+// polynomials as planned, or sampled at their knots. As a patch, it only
+// carries what changed since the last trajectory sent, so call this before
+// updating traj_.
+void MetaPlanner::Publish(const Trajectory::ConstPtr& traj,
+                          const PolynomialTrajectory::ConstPtr& poly) const {
+  if (!traj_patch_topic_.empty() && traj_patch_pub_.getNumSubscribers() > 0)
+    traj_patch_pub_.publish(traj->ToPatchRosMessage(traj_));
+
+  if (!flat_traj_topic_.empty() && flat_traj_pub_.getNumSubscribers() > 0)
+    flat_traj_pub_.publish(traj->ToFlatRosMessage());
+
+  if (!poly_traj_topic_.empty() && poly_traj_pub_.getNumSubscribers() > 0)
+    poly_traj_pub_.publish(poly->ToRosMessage());
+
+  if (traj_pub_.getNumSubscribers() > 0)
+    traj_pub_.publish(traj->ToRosMessage());
+}
+
 } //\namespace meta
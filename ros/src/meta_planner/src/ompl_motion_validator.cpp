@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the OmplMotionValidator class, which checks whole straight-line
+// motions for OMPL planners exactly.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <meta_planner/ompl_motion_validator.h>
+
+namespace meta {
+
+// Factory method. Use this instead of the constructor.
+OmplMotionValidator::Ptr OmplMotionValidator::
+Create(const ob::SpaceInformationPtr& si, const Box::ConstPtr& space,
+       ValueFunctionId incoming_value, ValueFunctionId outgoing_value) {
+  OmplMotionValidator::Ptr ptr(new OmplMotionValidator(
+    si, space, incoming_value, outgoing_value));
+  return ptr;
+}
+
+// Constructor. Don't use this. Use the factory method instead.
+OmplMotionValidator::
+OmplMotionValidator(const ob::SpaceInformationPtr& si,
+                    const Box::ConstPtr& space,
+                    ValueFunctionId incoming_value,
+                    ValueFunctionId outgoing_value)
+  : ob::MotionValidator(si),
+    space_(space),
+    incoming_value_(incoming_value),
+    outgoing_value_(outgoing_value) {}
+
+// Check whether the straight motion from s1 to s2 is valid.
+bool OmplMotionValidator::checkMotion(const ob::State* s1,
+                                      const ob::State* s2) const {
+  const bool valid = space_->IsValidSegment(
+    FromOmplState(s1), FromOmplState(s2), incoming_value_, outgoing_value_);
+
+  if (valid)
+    valid_++;
+  else
+    invalid_++;
+
+  return valid;
+}
+
+// Same, but if it is not valid, also find the last valid state and the
+// fraction of the motion where it occurs.
+bool OmplMotionValidator::
+checkMotion(const ob::State* s1, const ob::State* s2,
+            std::pair<ob::State*, double>& last_valid) const {
+  if (checkMotion(s1, s2))
+    return true;
+
+  // Bisect for the last valid fraction. Twenty halvings are well below any
+  // resolution the planners care about.
+  const Vector3d start = FromOmplState(s1);
+  const Vector3d stop = FromOmplState(s2);
+
+  double lower = 0.0;
+  double upper = 1.0;
+  for (size_t ii = 0; ii < 20; ii++) {
+    const double fraction = 0.5 * (lower + upper);
+    if (space_->IsValidSegment(start, start + fraction * (stop - start),
+                               incoming_value_, outgoing_value_))
+      lower = fraction;
+    else
+      upper = fraction;
+  }
+
+  if (last_valid.first != nullptr)
+    si_->getStateSpace()->interpolate(s1, s2, lower, last_valid.first);
+
+  last_valid.second = lower;
+  return false;
+}
+
+// Convert between OMPL states and Vector3ds.
+Vector3d OmplMotionValidator::FromOmplState(const ob::State* state) {
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (!state) {
+    ROS_ERROR("State pointer was null.");
+    return Vector3d::Zero();
+  }
+#endif
+
+  const ob::RealVectorStateSpace::StateType* cast_state =
+    static_cast<const ob::RealVectorStateSpace::StateType*>(state);
+
+  Vector3d converted;
+  for (size_t ii = 0; ii < 3; ii++)
+    converted(ii) = cast_state->values[ii];
+
+  return converted;
+}
+
+} //\namespace meta
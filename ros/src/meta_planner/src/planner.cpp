@@ -47,43 +47,30 @@
 namespace meta {
 
 // Initialize this class from a ROS node.
-bool Planner::Initialize(const ros::NodeHandle& n) {
+bool Planner::Initialize(const ros::NodeHandle& n,
+                         const ValueFunctionProvider::ConstPtr& values) {
   name_ = ros::names::append(n.getNamespace(), "planner");
 
-  if (!LoadParameters(n)) {
-    ROS_ERROR("%s: Failed to load parameters.", name_.c_str());
-    return false;
-  }
-
-  if (!RegisterCallbacks(n)) {
-    ROS_ERROR("%s: Failed to register callbacks.", name_.c_str());
+  if (!values) {
+    ROS_ERROR("%s: No value functions provided.", name_.c_str());
     return false;
   }
 
+  values_ = values;
   initialized_ = true;
   return true;
 }
 
-// Load all parameters.
-bool Planner::LoadParameters(const ros::NodeHandle& n) {
-  ros::NodeHandle nl(n);
-
-  // Sensor radius.
-  if (!nl.getParam("srv/best_time", best_time_name_)) return false;
+// Plan a trajectory between two points, sampled at the polynomials' knots.
+Trajectory::Ptr Planner::Plan(const Vector3d& start, const Vector3d& stop,
+                              double start_time, double budget,
+                              const CancelFunction& cancel) const {
+  const PolynomialTrajectory::ConstPtr poly =
+    PlanPolynomial(start, stop, start_time, budget, cancel);
+  if (poly == nullptr)
+    return nullptr;
 
-  return true;
-}
-
-// Register all callbacks and publishers.
-bool Planner::RegisterCallbacks(const ros::NodeHandle& n) {
-  ros::NodeHandle nl(n);
-
-  // Server.
-  ros::service::waitForService(best_time_name_.c_str());
-  best_time_srv_ = nl.serviceClient<value_function_srvs::GeometricPlannerTime>(
-    best_time_name_.c_str(), true);
-
-  return true;
+  return poly->ToTrajectory(dynamics_);
 }
 
 // Shortest possible time to go from start to stop for this planner.
@@ -91,25 +78,8 @@ double Planner::
 BestPossibleTime(const Vector3d& start, const Vector3d& stop) const {
   double best_time = std::numeric_limits<double>::infinity();
 
-  // Make sure the server is up.
-  if (!best_time_srv_) {
-    ROS_WARN("%s: Best time server disconnected.", name_.c_str());
-
-    ros::NodeHandle nl;
-    best_time_srv_ = nl.serviceClient<value_function_srvs::GeometricPlannerTime>(
-      best_time_name_.c_str(), true);
-    return best_time;
-  }
-
-  // Call the server.
-  value_function_srvs::GeometricPlannerTime t;
-  t.request.id = incoming_value_;
-  t.request.start = utils::Pack(start);
-  t.request.stop = utils::Pack(stop);
-  if (!best_time_srv_.call(t))
-    ROS_ERROR("%s: Error calling best time server.", name_.c_str());
-  else
-    best_time = t.response.time;
+  if (!values_->BestPossibleTime(incoming_value_, start, stop, best_time))
+    ROS_ERROR("%s: Error computing best possible time.", name_.c_str());
 
   return best_time;
 }
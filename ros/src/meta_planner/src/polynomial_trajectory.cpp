@@ -0,0 +1,434 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the PolynomialTrajectory class. Positions are stored at knots,
+// and joined either by straight lines at constant velocity or by cubics
+// matching given velocities at both ends (i.e. cubic Hermite splines).
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <meta_planner/polynomial_trajectory.h>
+
+namespace meta {
+
+// Factory constructor for straight lines between positions.
+PolynomialTrajectory::Ptr PolynomialTrajectory::
+Create(const std::vector<double>& times,
+       const std::vector<Vector3d>& positions,
+       const std::vector<ValueFunctionId>& control_values,
+       const std::vector<ValueFunctionId>& bound_values) {
+  Ptr ptr(new PolynomialTrajectory());
+
+  // Number of knots.
+  size_t num_knots = positions.size();
+
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (positions.size() != times.size() ||
+      positions.size() != control_values.size() ||
+      positions.size() != bound_values.size()) {
+    ROS_WARN("PolynomialTrajectory: Inconsistent number of positions, "
+             "times, and values.");
+    num_knots = std::min(num_knots, std::min(times.size(),
+      std::min(control_values.size(), bound_values.size())));
+  }
+#endif
+
+  for (size_t ii = 0; ii < num_knots; ii++)
+    ptr->Add(times[ii], positions[ii], control_values[ii], bound_values[ii]);
+
+  return ptr;
+}
+
+// Factory constructor for cubics between positions.
+PolynomialTrajectory::Ptr PolynomialTrajectory::
+Create(const std::vector<double>& times,
+       const std::vector<Vector3d>& positions,
+       const std::vector<Vector3d>& velocities,
+       const std::vector<ValueFunctionId>& control_values,
+       const std::vector<ValueFunctionId>& bound_values) {
+  Ptr ptr(new PolynomialTrajectory());
+
+  // Number of knots.
+  size_t num_knots = positions.size();
+
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (positions.size() != times.size() ||
+      positions.size() != velocities.size() ||
+      positions.size() != control_values.size() ||
+      positions.size() != bound_values.size()) {
+    ROS_WARN("PolynomialTrajectory: Inconsistent number of positions, "
+             "velocities, times, and values.");
+    num_knots = std::min(std::min(num_knots, velocities.size()),
+      std::min(times.size(),
+               std::min(control_values.size(), bound_values.size())));
+  }
+#endif
+
+  for (size_t ii = 0; ii < num_knots; ii++) {
+    if (ptr->Add(times[ii], positions[ii],
+                 control_values[ii], bound_values[ii]))
+      ptr->velocities_.insert(ptr->velocities_.end(), velocities[ii].data(),
+                              velocities[ii].data() + 3);
+  }
+
+  return ptr;
+}
+
+// Factory constructor from ROS message.
+PolynomialTrajectory::Ptr PolynomialTrajectory::
+Create(const meta_planner_msgs::PolynomialTrajectory::ConstPtr& msg) {
+  Ptr ptr(new PolynomialTrajectory());
+
+  const size_t num_knots = msg->num_knots;
+  const bool cubic = !msg->velocities.empty();
+  if (msg->times.size() != num_knots ||
+      msg->positions.size() != 3 * num_knots ||
+      (cubic && msg->velocities.size() != 3 * num_knots) ||
+      msg->control_value_function_ids.size() != num_knots ||
+      msg->bound_value_function_ids.size() != num_knots) {
+    ROS_ERROR("PolynomialTrajectory: Inconsistent number of positions, "
+              "velocities, times, and values in message.");
+    return ptr;
+  }
+
+  // Planners send knots in increasing time order, in which case the
+  // message's arrays are used as they are.
+  const std::vector<double>& times = msg->times;
+  if (std::adjacent_find(times.begin(), times.end(),
+                         std::greater_equal<double>()) == times.end()) {
+    ptr->times_ = times;
+    ptr->positions_ = msg->positions;
+    ptr->velocities_ = msg->velocities;
+    ptr->control_values_.assign(msg->control_value_function_ids.begin(),
+                                msg->control_value_function_ids.end());
+    ptr->bound_values_.assign(msg->bound_value_function_ids.begin(),
+                              msg->bound_value_function_ids.end());
+    return ptr;
+  }
+
+  ROS_WARN("PolynomialTrajectory: Dropping knots out of time order.");
+  for (size_t ii = 0; ii < num_knots; ii++) {
+    const Eigen::Map<const Vector3d> position(&msg->positions[3 * ii]);
+    if (ptr->Add(times[ii], position,
+                 msg->control_value_function_ids[ii],
+                 msg->bound_value_function_ids[ii]) && cubic)
+      ptr->velocities_.insert(ptr->velocities_.end(),
+                              msg->velocities.begin() + 3 * ii,
+                              msg->velocities.begin() + 3 * ii + 3);
+  }
+
+  return ptr;
+}
+
+// Factory constructor to concatenate trajectories as cubics through all of
+// their knots.
+PolynomialTrajectory::Ptr PolynomialTrajectory::
+Create(const std::vector<ConstPtr>& pieces) {
+  Ptr ptr(new PolynomialTrajectory());
+
+  for (const auto& piece : pieces) {
+    if (piece == nullptr)
+      continue;
+
+    for (size_t ii = 0; ii < piece->Size(); ii++) {
+      const double time = piece->times_[ii];
+
+      // Where consecutive trajectories meet, keep the later one's knot.
+      if (!ptr->IsEmpty() && time == ptr->times_.back()) {
+        ptr->times_.pop_back();
+        ptr->positions_.resize(ptr->positions_.size() - 3);
+        ptr->velocities_.resize(ptr->velocities_.size() - 3);
+        ptr->control_values_.pop_back();
+        ptr->bound_values_.pop_back();
+      }
+
+      const Eigen::Map<const Vector3d> position(&piece->positions_[3 * ii]);
+      const Vector3d velocity = piece->Velocity(ii);
+      if (ptr->Add(time, position, piece->control_values_[ii],
+                   piece->bound_values_[ii]))
+        ptr->velocities_.insert(ptr->velocities_.end(), velocity.data(),
+                                velocity.data() + 3);
+    }
+  }
+
+  return ptr;
+}
+
+// Add a knot, unless it is not after the last one.
+bool PolynomialTrajectory::Add(double time, const Vector3d& position,
+                               ValueFunctionId control_value,
+                               ValueFunctionId bound_value) {
+  if (!times_.empty() && time <= times_.back()) {
+    ROS_WARN("PolynomialTrajectory: Dropping knot at %f, not after %f.",
+             time, times_.back());
+    return false;
+  }
+
+  times_.push_back(time);
+  positions_.insert(positions_.end(), position.data(), position.data() + 3);
+  control_values_.push_back(control_value);
+  bound_values_.push_back(bound_value);
+  return true;
+}
+
+// Adjust the time stamps for this trajectory to start at the given time.
+void PolynomialTrajectory::ResetStartTime(double start) {
+  if (IsEmpty())
+    return;
+
+  const double delay = start - times_.front();
+  for (auto& time : times_)
+    time += delay;
+}
+
+// Swap out the control value function in this trajectory and retime each
+// segment to take the best possible time at the new max planner speed.
+void PolynomialTrajectory::
+ExecuteSwitch(ValueFunctionId value,
+              const ValueFunctionProvider::ConstPtr& values) {
+  if (IsEmpty())
+    return;
+
+  // The best possible time between knots only depends on how far apart they
+  // are and the max planner speed, so look that up once.
+  Vector3d max_speed;
+  const bool have_speed = values->MaxPlannerSpeed(value, max_speed);
+  if (!have_speed)
+    ROS_ERROR("PolynomialTrajectory: Error computing max planner speed. "
+              "Assuming fixed dt.");
+
+  // (1) Compute the time for each knot from the last one's.
+  std::vector<double> times(1, times_.front());
+  for (size_t ii = 1; ii < Size(); ii++) {
+    const Eigen::Map<const Vector3d> from(&positions_[3 * ii - 3]);
+    const Eigen::Map<const Vector3d> to(&positions_[3 * ii]);
+    const double dt = (have_speed) ?
+      (to - from).cwiseAbs().cwiseQuotient(max_speed).maxCoeff() : 10.0;
+    times.push_back(times.back() + dt);
+  }
+
+  // (2) Keep each knot, unless it is at the same time as the last.
+  PolynomialTrajectory switched;
+  for (size_t ii = 0; ii < Size(); ii++) {
+    if (!switched.IsEmpty() && times[ii] <= switched.times_.back())
+      continue;
+
+    const Eigen::Map<const Vector3d> position(&positions_[3 * ii]);
+    switched.Add(times[ii], position, value, bound_values_[ii]);
+    if (!IsCubic())
+      continue;
+
+    // Scale by how much the segment leaving this knot (or arriving at the
+    // last one) was sped up.
+    Vector3d velocity = Velocity(ii);
+    if (Size() > 1) {
+      const size_t first = (ii + 1 < Size()) ? ii : ii - 1;
+      const double new_dt = times[first + 1] - times[first];
+      velocity = (new_dt > 0.0) ?
+        Vector3d(velocity * (times_[first + 1] - times_[first]) / new_dt) :
+        Vector3d::Zero();
+    }
+
+    switched.velocities_.insert(switched.velocities_.end(), velocity.data(),
+                                velocity.data() + 3);
+  }
+
+  *this = switched;
+}
+
+// Velocity at the given knot. Linear segments carry the velocity of the
+// segment leaving each knot, or arriving at the last one.
+Vector3d PolynomialTrajectory::Velocity(size_t knot) const {
+  if (IsCubic())
+    return Eigen::Map<const Vector3d>(&velocities_[3 * knot]);
+
+  if (Size() < 2)
+    return Vector3d::Zero();
+
+  const size_t first = (knot + 1 < Size()) ? knot : knot - 1;
+  const Eigen::Map<const Vector3d> from(&positions_[3 * first]);
+  const Eigen::Map<const Vector3d> to(&positions_[3 * first + 3]);
+  return (to - from) / (times_[first + 1] - times_[first]);
+}
+
+// Position and velocity at the given time on the segment starting at the
+// given knot, which must not be the last.
+void PolynomialTrajectory::Evaluate(size_t knot, double time,
+                                    Vector3d& position,
+                                    Vector3d& velocity) const {
+  const Eigen::Map<const Vector3d> p0(&positions_[3 * knot]);
+  const Eigen::Map<const Vector3d> p1(&positions_[3 * knot + 3]);
+  const double h = times_[knot + 1] - times_[knot];
+  const double s = (time - times_[knot]) / h;
+
+  if (!IsCubic()) {
+    position = p0 + s * (p1 - p0);
+    velocity = (p1 - p0) / h;
+    return;
+  }
+
+  // Cubic Hermite basis, in terms of s in [0, 1].
+  const Eigen::Map<const Vector3d> v0(&velocities_[3 * knot]);
+  const Eigen::Map<const Vector3d> v1(&velocities_[3 * knot + 3]);
+  const double s2 = s * s;
+  const double s3 = s2 * s;
+
+  position = (2.0 * s3 - 3.0 * s2 + 1.0) * p0 +
+    (s3 - 2.0 * s2 + s) * h * v0 +
+    (-2.0 * s3 + 3.0 * s2) * p1 +
+    (s3 - s2) * h * v1;
+  velocity = ((6.0 * s2 - 6.0 * s) / h) * (p0 - p1) +
+    (3.0 * s2 - 4.0 * s + 1.0) * v0 +
+    (3.0 * s2 - 2.0 * s) * v1;
+}
+
+// Position and velocity at the given time.
+void PolynomialTrajectory::GetState(double time, Vector3d& position,
+                                    Vector3d& velocity) const {
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (IsEmpty()) {
+    ROS_WARN("Tried to evaluate an empty polynomial trajectory.");
+    throw std::underflow_error("Tried to evaluate an empty trajectory.");
+  }
+#endif
+
+  // Hold the end positions outside the trajectory.
+  if (time <= times_.front() || time >= times_.back()) {
+    const size_t knot = (time <= times_.front()) ? 0 : Size() - 1;
+    position = Eigen::Map<const Vector3d>(&positions_[3 * knot]);
+    velocity = Vector3d::Zero();
+    return;
+  }
+
+  Evaluate(Knot(time), time, position, velocity);
+}
+
+// Return the ID of the value function being used at this time.
+ValueFunctionId PolynomialTrajectory::
+GetControlValueFunction(double time) const {
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (IsEmpty()) {
+    ROS_WARN("Tried to get control value function of an empty trajectory.");
+    throw std::underflow_error("Tried to get value of an empty trajectory.");
+  }
+#endif
+
+  return control_values_[Knot(time)];
+}
+
+ValueFunctionId PolynomialTrajectory::
+GetBoundValueFunction(double time) const {
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (IsEmpty()) {
+    ROS_WARN("Tried to get bound value function of an empty trajectory.");
+    throw std::underflow_error("Tried to get value of an empty trajectory.");
+  }
+#endif
+
+  return bound_values_[Knot(time)];
+}
+
+// Convert to ROS message.
+meta_planner_msgs::PolynomialTrajectory
+PolynomialTrajectory::ToRosMessage() const {
+  meta_planner_msgs::PolynomialTrajectory traj_msg;
+  traj_msg.num_knots = Size();
+  traj_msg.times = times_;
+  traj_msg.positions = positions_;
+  traj_msg.velocities = velocities_;
+  traj_msg.control_value_function_ids.assign(control_values_.begin(),
+                                             control_values_.end());
+  traj_msg.bound_value_function_ids.assign(bound_values_.begin(),
+                                           bound_values_.end());
+  return traj_msg;
+}
+
+// Convert to a sampled Trajectory.
+Trajectory::Ptr PolynomialTrajectory::
+ToTrajectory(const Dynamics::ConstPtr& dynamics, double max_time_step) const {
+  if (IsEmpty())
+    return Trajectory::Create();
+
+  if (dynamics == nullptr) {
+    ROS_ERROR("PolynomialTrajectory: Need dynamics to lift into state space.");
+    return Trajectory::Create();
+  }
+
+  // Sample each segment evenly, with as few samples as possible.
+  std::vector<double> times;
+  std::vector<Vector3d> positions;
+  std::vector<Vector3d> velocities;
+  std::vector<ValueFunctionId> control_values;
+  std::vector<ValueFunctionId> bound_values;
+
+  Vector3d position, velocity(Vector3d::Zero());
+  for (size_t ii = 0; ii + 1 < Size(); ii++) {
+    const double h = times_[ii + 1] - times_[ii];
+    const size_t num_samples = (h > max_time_step) ?
+      static_cast<size_t>(std::ceil(h / max_time_step)) : 1;
+
+    for (size_t jj = 0; jj < num_samples; jj++) {
+      const double time = times_[ii] + h * static_cast<double>(jj) /
+        static_cast<double>(num_samples);
+      Evaluate(ii, time, position, velocity);
+
+      times.push_back(time);
+      positions.push_back(position);
+      velocities.push_back(velocity);
+      control_values.push_back(control_values_[ii]);
+      bound_values.push_back(bound_values_[ii]);
+    }
+  }
+
+  // Catch final knot. For linear segments, keep the last segment's velocity.
+  const size_t last = Size() - 1;
+  times.push_back(times_[last]);
+  positions.push_back(Eigen::Map<const Vector3d>(&positions_[3 * last]));
+  velocities.push_back((IsCubic()) ?
+    Vector3d(Eigen::Map<const Vector3d>(&velocities_[3 * last])) : velocity);
+  control_values.push_back(control_values_[last]);
+  bound_values.push_back(bound_values_[last]);
+
+  // Lift into the full state space, with velocities from the polynomials.
+  const std::vector<VectorXd> states =
+    dynamics->LiftGeometricTrajectory(positions, velocities, times);
+
+  return Trajectory::Create(times, states, control_values, bound_values);
+}
+
+} //\namespace meta
@@ -0,0 +1,251 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the ReferenceBuffer class, which resamples a Trajectory at a
+// fixed time step in a background thread and holds the upcoming samples
+// in a ring buffer, so that looking up the reference at any time takes
+// constant time regardless of the trajectory's length.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <meta_planner/reference_buffer.h>
+
+namespace meta {
+
+ReferenceBuffer::ReferenceBuffer(double time_step, size_t capacity,
+                                 const ValueFunctionProvider::ConstPtr& values)
+  : time_step_(time_step),
+    capacity_(capacity),
+    values_(values),
+    start_(0.0),
+    end_(0),
+    generation_(0),
+    first_(0),
+    last_(0),
+    state_dim_(0),
+    times_(capacity),
+    control_values_(capacity),
+    bound_values_(capacity),
+    bounds_(capacity, Vector3d::Zero()),
+    stop_(false) {
+  thread_ = std::thread(&ReferenceBuffer::Run, this);
+}
+
+// Destructor. Stops the background thread.
+ReferenceBuffer::~ReferenceBuffer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+
+  wake_.notify_one();
+  thread_.join();
+}
+
+// Factory method. Use this instead of the constructor.
+ReferenceBuffer::Ptr ReferenceBuffer::
+Create(double time_step, double horizon,
+       const ValueFunctionProvider::ConstPtr& values) {
+  const size_t capacity =
+    std::max(2, static_cast<int>(std::ceil(horizon / time_step)) + 1);
+
+  Ptr ptr(new ReferenceBuffer(time_step, capacity, values));
+  return ptr;
+}
+
+// Start resampling the given trajectory from the given time on, dropping
+// all samples of the previous one.
+void ReferenceBuffer::Reset(const Trajectory::ConstPtr& traj, double start) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  traj_ = traj;
+  start_ = start;
+  first_ = 0;
+  last_ = 0;
+  generation_++;
+
+  // Number of samples. The last one is at the last time of the trajectory,
+  // so that there is always a sample after any time within it.
+  end_ = 0;
+  if (traj_ != nullptr && !traj_->IsEmpty()) {
+    end_ = 1;
+    if (traj_->LastTime() > start_)
+      end_ = static_cast<size_t>(
+        std::floor((traj_->LastTime() - start_) / time_step_)) + 2;
+
+    if (state_dim_ != traj_->FirstState().size()) {
+      state_dim_ = traj_->FirstState().size();
+      states_.resize(capacity_ * state_dim_);
+    }
+  }
+
+  wake_.notify_one();
+}
+
+// Interpolate the reference state at the given time between the samples
+// around it, and get the value functions and tracking bound of the one
+// before it. Drops all earlier samples. Returns false if they have not
+// been sampled yet.
+bool ReferenceBuffer::Get(double time, VectorXd& state,
+                          ValueFunctionId& control_value,
+                          ValueFunctionId& bound_value, Vector3d& bound) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (end_ == 0 || time < start_)
+    return false;
+
+  // Index of the sample at or before this time.
+  const size_t index = static_cast<size_t>((time - start_) / time_step_);
+  if (index < first_ || index + 1 >= end_)
+    return false;
+
+  // Drop earlier samples, waking the background thread if it has fallen
+  // behind.
+  first_ = index;
+  last_ = std::max(last_, first_);
+  if (NeedsSamples())
+    wake_.notify_one();
+
+  if (index + 1 >= last_)
+    return false;
+
+  // Interpolate. The next sample may have been clamped to the end.
+  const size_t lower = index % capacity_;
+  const size_t upper = (index + 1) % capacity_;
+  const double interval = times_[upper] - times_[lower];
+  const double fraction = (interval > 0.0) ?
+    std::min(1.0, (time - times_[lower]) / interval) : 0.0;
+
+  const Eigen::Map<const VectorXd> lower_state(
+    states_.data() + lower * state_dim_, state_dim_);
+  const Eigen::Map<const VectorXd> upper_state(
+    states_.data() + upper * state_dim_, state_dim_);
+
+  state = (1.0 - fraction) * lower_state + fraction * upper_state;
+  control_value = control_values_[lower];
+  bound_value = bound_values_[lower];
+  bound = bounds_[lower];
+  return true;
+}
+
+// Should the background thread wake up?
+bool ReferenceBuffer::NeedsSamples() const {
+  return last_ < end_ && last_ - first_ <= capacity_ / 2;
+}
+
+// Background thread. Samples the current trajectory whenever the buffer
+// is less than half full.
+void ReferenceBuffer::Run() {
+  // A batch of samples, taken without holding the lock.
+  std::vector<double> times;
+  std::vector<double> states;
+  std::vector<ValueFunctionId> control_values;
+  std::vector<ValueFunctionId> bound_values;
+  std::vector<Vector3d> bounds;
+  VectorXd state;
+
+  // Samples are taken in time order, so the cursor rarely searches.
+  Trajectory::Cursor cursor;
+  size_t generation = 0;
+
+  // Tracking bound of the last bound value function seen.
+  bool have_bound = false;
+  ValueFunctionId bound_value = 0;
+  Vector3d bound = Vector3d::Zero();
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait(lock, [this]() { return stop_ || NeedsSamples(); });
+    if (stop_)
+      return;
+
+    if (generation != generation_) {
+      generation = generation_;
+      cursor = Trajectory::Cursor(traj_);
+    }
+
+    // Fill the buffer up.
+    const size_t begin = last_;
+    const size_t count = std::min(end_, first_ + capacity_) - begin;
+    const size_t dim = state_dim_;
+    const double start = start_;
+    const double last_time = traj_->LastTime();
+    lock.unlock();
+
+    times.resize(count);
+    states.resize(count * dim);
+    control_values.resize(count);
+    bound_values.resize(count);
+    bounds.resize(count);
+
+    for (size_t ii = 0; ii < count; ii++) {
+      times[ii] = std::min(start + (begin + ii) * time_step_, last_time);
+      cursor.Get(times[ii], state, control_values[ii], bound_values[ii]);
+      std::copy(state.data(), state.data() + dim, states.begin() + ii * dim);
+
+      if (!have_bound || bound_values[ii] != bound_value) {
+        have_bound = true;
+        bound_value = bound_values[ii];
+        if (!values_->TrackingBound(bound_value, bound)) {
+          ROS_ERROR("ReferenceBuffer: Error computing tracking bound.");
+          bound = Vector3d::Zero();
+        }
+      }
+
+      bounds[ii] = bound;
+    }
+
+    lock.lock();
+    if (generation != generation_)
+      continue;
+
+    // Copy in all samples which lookups have not skipped in the meantime.
+    for (size_t kk = std::max(begin, last_); kk < begin + count; kk++) {
+      const size_t ii = kk - begin;
+      const size_t slot = kk % capacity_;
+      times_[slot] = times[ii];
+      std::copy(states.begin() + ii * dim, states.begin() + (ii + 1) * dim,
+                states_.begin() + slot * dim);
+      control_values_[slot] = control_values[ii];
+      bound_values_[slot] = bound_values[ii];
+      bounds_[slot] = bounds[ii];
+    }
+
+    last_ = std::max(last_, begin + count);
+  }
+}
+
+} //\namespace meta
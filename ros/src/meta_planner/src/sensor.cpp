@@ -67,9 +67,10 @@ bool Sensor::Initialize(const ros::NodeHandle& n) {
     return false;
   }
 
-  // Initialize state space.
+  // Initialize state space. The sensor never collision checks, so it does
+  // not need any value functions.
   space_ = BallsInBox::Create();
-  if (!space_->Initialize(n)) {
+  if (!space_->Initialize(n, nullptr)) {
     ROS_ERROR("%s: Failed to initialize Environment.", name_.c_str());
     return false;
   }
@@ -145,6 +146,10 @@ bool Sensor::LoadParameters(const ros::NodeHandle& n) {
   if (!nl.getParam("topics/in_flight", in_flight_topic_)) return false;
   if (!nl.getParam("topics/vis/sensor_radius", sensor_radius_topic_)) return false;
   if (!nl.getParam("topics/vis/true_environment", environment_topic_)) return false;
+  // Environment visualization rate.
+  double env_vis_rate = 5.0;
+  nl.param("vis/env_rate", env_vis_rate, env_vis_rate);
+  env_vis_period_ = 1.0 / std::max(env_vis_rate, 1e-3);
 
   if (!nl.getParam("frames/fixed", fixed_frame_id_)) return false;
   if (!nl.getParam("frames/tracker", robot_frame_id_)) return false;
@@ -157,8 +162,8 @@ bool Sensor::RegisterCallbacks(const ros::NodeHandle& n) {
   ros::NodeHandle nl(n);
 
    // Publishers.
-  environment_pub_ = nl.advertise<visualization_msgs::Marker>(
-    environment_topic_.c_str(), 1, false);
+  environment_pub_ = nl.advertise<visualization_msgs::MarkerArray>(
+    environment_topic_.c_str(), 1, true);
 
   sensor_radius_pub_ = nl.advertise<visualization_msgs::Marker>(
     sensor_radius_topic_.c_str(), 1, false);
@@ -228,7 +233,8 @@ void Sensor::TimerCallback(const ros::TimerEvent& e) {
   }
 
   // Visualize the environment.
-  space_->Visualize(environment_pub_, fixed_frame_id_);
+  space_->ThrottledVisualize(
+    environment_pub_, fixed_frame_id_, env_vis_period_);
 
    // Visualize the sensor radius.
   visualization_msgs::Marker sensor_radius_marker;
@@ -63,6 +63,13 @@ bool TrackerCoupled7D::Initialize(const ros::NodeHandle& n) {
     return false;
   }
 
+  // Set up value functions. Must happen before the timer starts.
+  values_ = ValueFunctionProvider::Create(n);
+  if (values_ == nullptr) {
+    ROS_ERROR("%s: Failed to set up value functions.", name_.c_str());
+    return false;
+  }
+
   if (!RegisterCallbacks(n)) {
     ROS_ERROR("%s: Failed to register callbacks.", name_.c_str());
     return false;
@@ -95,12 +102,6 @@ bool TrackerCoupled7D::LoadParameters(const ros::NodeHandle& n) {
   if (!nl.getParam("state/dim", dimension)) return false;
   state_dim_ = static_cast<size_t>(dimension);
 
-  // Service names.
-  if (!nl.getParam("srv/optimal_control", optimal_control_name_))
-    return false;
-  if (!nl.getParam("srv/priority", priority_name_))
-    return false;
-
   // Topics and frame ids.
   if (!nl.getParam("topics/control", control_topic_)) return false;
   if (!nl.getParam("topics/in_flight", in_flight_topic_)) return false;
@@ -137,15 +138,6 @@ bool TrackerCoupled7D::RegisterCallbacks(const ros::NodeHandle& n) {
   control_pub_ = nl.advertise<crazyflie_msgs::PrioritizedControlStamped>(
     control_topic_.c_str(), 1, false);
 
-  // Service clients.
-  ros::service::waitForService(optimal_control_name_.c_str());
-  optimal_control_srv_ = nl.serviceClient<value_function_srvs::OptimalControl>(
-    optimal_control_name_.c_str(), true);
-
-  ros::service::waitForService(priority_name_.c_str());
-  priority_srv_ = nl.serviceClient<value_function_srvs::Priority>(
-    priority_name_.c_str(), true);
-
   // Timer.
   timer_ =
     nl.createTimer(ros::Duration(time_step_), &TrackerCoupled7D::TimerCallback, this);
@@ -198,49 +190,17 @@ void TrackerCoupled7D::TimerCallback(const ros::TimerEvent& e) {
 
   const Vector3d planner_position(reference_(0), reference_(1), reference_(2));
 
-  // (1) Get priority.
-  if (!priority_srv_) {
-    ROS_WARN("%s: Priority server disconnected.", name_.c_str());
-
-    ros::NodeHandle nl;
-    priority_srv_ = nl.serviceClient<value_function_srvs::Priority>(
-      priority_name_.c_str(), true);
-
-    return;
-  }
-
+  // (1) Get optimal control and priority in a single query.
   double priority = 0.0;
-
-  value_function_srvs::Priority p;
-  p.request.id = control_value_id_;
-  p.request.state = utils::PackState(relative_state);
-  if (!priority_srv_.call(p))
-    ROS_ERROR("%s: Error calling priority server.", name_.c_str());
-  else
-    priority = p.response.priority;
-
-  // (2) Get optimal control.
-  if (!optimal_control_srv_) {
-    ROS_WARN("%s: Optimal control server disconnected.", name_.c_str());
-
-    ros::NodeHandle nl;
-    optimal_control_srv_ = nl.serviceClient<value_function_srvs::OptimalControl>(
-      optimal_control_name_.c_str(), true);
-
+  VectorXd optimal_control(control_dim_);
+  if (!values_->OptimalControlAndPriority(control_value_id_, relative_state,
+                                          optimal_control, priority)) {
+    ROS_ERROR("%s: Error computing optimal control and priority.",
+              name_.c_str());
     return;
   }
 
-  VectorXd optimal_control(control_dim_);
-
-  value_function_srvs::OptimalControl c;
-  c.request.id = control_value_id_;
-  c.request.state = utils::PackState(relative_state);
-  if (!optimal_control_srv_.call(c))
-    ROS_ERROR("%s: Error calling optimal control server.", name_.c_str());
-  else
-    optimal_control = utils::Unpack(c.response.control);
-
-  // (3) Publish optimal control with priority in (0, 1).
+  // (2) Publish optimal control with priority in (0, 1).
   crazyflie_msgs::PrioritizedControlStamped control_msg;
   control_msg.header.stamp = ros::Time::now();
 
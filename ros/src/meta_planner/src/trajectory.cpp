@@ -81,14 +81,72 @@ Create(const meta_planner_msgs::Trajectory::ConstPtr& msg) {
   // Number of entries in trajectory.
   size_t num_waypoints = msg->num_waypoints;
 
+  // Copy states straight out of the message.
   for (size_t ii = 0; ii < num_waypoints; ii++) {
-    // Convert state message to VectorXd.
-    const VectorXd state = utils::Unpack(msg->states[ii]);
+    ptr->Insert(msg->times[ii],
+                msg->states[ii].state.data(), msg->states[ii].dimension,
+                msg->control_value_function_ids[ii],
+                msg->bound_value_function_ids[ii]);
+  }
+
+  return ptr;
+}
+
+// Factory constructor from a flat ROS message, whose states are stored
+// back to back with a fixed stride.
+Trajectory::Ptr Trajectory::
+Create(const meta_planner_msgs::FlatTrajectory::ConstPtr& msg) {
+  Trajectory::Ptr ptr(new Trajectory());
+
+  // Number of entries in trajectory.
+  const size_t num_waypoints = msg->num_waypoints;
+  const size_t state_dim = msg->dimension;
+  if (msg->times.size() != num_waypoints ||
+      msg->states.size() != num_waypoints * state_dim ||
+      msg->control_value_function_ids.size() != num_waypoints ||
+      msg->bound_value_function_ids.size() != num_waypoints) {
+    ROS_ERROR("Trajectory: Inconsistent number of states, times, and values "
+              "in flat message.");
+    return ptr;
+  }
 
-    // Add to this trajectory.
-    ptr->Add(msg->times[ii], state,
-             msg->control_value_function_ids[ii],
-             msg->bound_value_function_ids[ii]);
+  if (num_waypoints == 0)
+    return ptr;
+
+  // View states as the columns of a matrix, straight out of the message.
+  const Eigen::Map<const MatrixXd> states(
+    msg->states.data(), state_dim, num_waypoints);
+
+  // Planners send waypoints in increasing time order, in which case the
+  // message's arrays become a segment as they are.
+  const std::vector<double>& times = msg->times;
+  if (std::adjacent_find(times.begin(), times.end(),
+                         std::greater_equal<double>()) == times.end()) {
+    const std::shared_ptr<Segment> segment = std::make_shared<Segment>();
+    segment->times_ = times;
+    segment->states_.assign(states.data(), states.data() + states.size());
+    segment->control_values_.assign(msg->control_value_function_ids.begin(),
+                                    msg->control_value_function_ids.end());
+    segment->bound_values_.assign(msg->bound_value_function_ids.begin(),
+                                  msg->bound_value_function_ids.end());
+
+    Piece piece;
+    piece.segment_ = segment;
+    piece.first_ = 0;
+    piece.last_ = num_waypoints;
+    piece.offset_ = 0.0;
+
+    ptr->state_dim_ = state_dim;
+    ptr->pieces_.push_back(piece);
+    ptr->offsets_.push_back(num_waypoints);
+    return ptr;
+  }
+
+  // Otherwise, sort them out one by one.
+  for (size_t ii = 0; ii < num_waypoints; ii++) {
+    ptr->Insert(times[ii], states.col(ii).data(), state_dim,
+                msg->control_value_function_ids[ii],
+                msg->bound_value_function_ids[ii]);
   }
 
   return ptr;
@@ -106,44 +164,423 @@ Create(const Trajectory::ConstPtr& other, double start) {
             other->GetControlValueFunction(start),
             other->GetBoundValueFunction(start));
 
-  // Insert the rest of the states in the other trajectory.
-  // Get a const iterator to a time in the other trajectory >= start time.
-  std::map<double, StateValue>::const_iterator iter =
-    other->map_.lower_bound(start);
+  // Share the rest of the states in the other trajectory, i.e. those with
+  // time >= start time. One at the start time would be a duplicate.
+  size_t first = other->LowerBound(start);
+  if (first < other->Size() && other->TimeAt(first) == start)
+    first++;
+
+  traj->Append(*other, first, other->Size());
+  return traj;
+}
+
+// Factory constructor to splice a suffix onto a trajectory, keeping the
+// trajectory's waypoints before the splice time and the suffix's from
+// then on.
+Trajectory::Ptr Trajectory::
+Create(const Trajectory::ConstPtr& prefix, double splice_time,
+       const Trajectory::ConstPtr& suffix) {
+  Trajectory::Ptr traj = Trajectory::Create();
 
-  // Iterate through all remaining states.
-  while (iter != other->map_.end()) {
-    traj->Add(iter->first,
-              iter->second.state_,
-              iter->second.control_value_,
-              iter->second.bound_value_);
-    iter++;
+  if (!prefix->IsEmpty() && !suffix->IsEmpty() &&
+      prefix->state_dim_ != suffix->state_dim_) {
+    ROS_ERROR("Trajectory: Tried to splice a suffix of dimension %zu onto a "
+              "trajectory of dimension %zu.",
+              suffix->state_dim_, prefix->state_dim_);
+    traj->Append(*prefix, 0, prefix->Size());
+    return traj;
   }
 
+  traj->Append(*prefix, 0, prefix->LowerBound(splice_time));
+  traj->Append(*suffix, suffix->LowerBound(splice_time), suffix->Size());
   return traj;
 }
 
+// Factory constructor to apply a patch to the given trajectory, received
+// at the given time.
+Trajectory::Ptr Trajectory::
+Create(const Trajectory::ConstPtr& traj,
+       const meta_planner_msgs::TrajectoryPatch::ConstPtr& msg,
+       double now) {
+  // View the suffix without copying it out of the patch.
+  const meta_planner_msgs::FlatTrajectory::ConstPtr suffix_msg(
+    msg, &msg->suffix);
+  const Trajectory::Ptr suffix = Trajectory::Create(suffix_msg);
+
+  if (traj == nullptr || traj->IsEmpty() || suffix->IsEmpty())
+    return suffix;
+
+  // Both share storage with their sources.
+  const Trajectory::ConstPtr remainder =
+    Trajectory::Create(traj, std::min(now, msg->splice_time));
+  return Trajectory::Create(remainder, msg->splice_time, suffix);
+}
+
+// Factory constructor to concatenate trajectories which follow one another
+// in time.
+Trajectory::Ptr Trajectory::
+Create(const std::vector<Trajectory::ConstPtr>& segments) {
+  Trajectory::Ptr traj = Trajectory::Create();
+
+  // Check that segments are in order.
+  bool in_order = true;
+  double last_time = -std::numeric_limits<double>::infinity();
+  for (const auto& segment : segments) {
+    if (segment->IsEmpty())
+      continue;
+
+    in_order &= segment->FirstTime() >= last_time &&
+      segment->state_dim_ == segments.front()->state_dim_;
+    last_time = segment->LastTime();
+  }
+
+  // Otherwise, fall back to adding them one by one, latest first.
+  if (!in_order) {
+    for (auto iter = segments.rbegin(); iter != segments.rend(); iter++)
+      traj->Add(*iter);
+
+    return traj;
+  }
+
+  for (const auto& segment : segments) {
+    if (segment->IsEmpty())
+      continue;
+
+    // Drop our last waypoint if this segment starts at the same time.
+    if (!traj->IsEmpty() && traj->LastTime() == segment->FirstTime())
+      traj->RemoveLast();
+
+    traj->Append(*segment, 0, segment->Size());
+  }
+
+  return traj;
+}
+
+// Insert a waypoint in time order, unless there already is one at this
+// time. Returns whether it was inserted.
+bool Trajectory::Insert(double time, const double* state, size_t state_dim,
+                        ValueFunctionId control_value,
+                        ValueFunctionId bound_value) {
+  if (IsEmpty())
+    state_dim_ = state_dim;
+  else if (state_dim != state_dim_) {
+    ROS_ERROR("Trajectory: Tried to add a state of dimension %zu to a "
+              "trajectory of dimension %zu.", state_dim, state_dim_);
+    return false;
+  }
+
+  size_t index = Size();
+  if (!IsEmpty() && time <= LastTime()) {
+    index = LowerBound(time);
+    if (TimeAt(index) == time)
+      return false;
+
+    // Inserting in the middle, so we need a segment of our own.
+    Flatten();
+  } else if (IsEmpty() ||
+             pieces_.back().segment_.use_count() > 1 ||
+             pieces_.back().last_ != pieces_.back().segment_->times_.size() ||
+             pieces_.back().offset_ != 0.0) {
+    // Usually waypoints arrive in time order. Append in place if we are the
+    // only user of the last (unshifted) segment, and otherwise start a new one.
+    Piece piece;
+    piece.segment_ = std::make_shared<Segment>();
+    piece.first_ = 0;
+    piece.last_ = 0;
+    piece.offset_ = 0.0;
+    pieces_.push_back(piece);
+    offsets_.push_back(offsets_.back());
+  }
+
+  // Insert into the last segment, which we now own.
+  Piece& piece = pieces_.back();
+  Segment& segment = *piece.segment_;
+  const size_t position = piece.first_ + index - offsets_[pieces_.size() - 1];
+
+  segment.times_.insert(segment.times_.begin() + position, time);
+  segment.states_.insert(segment.states_.begin() + position * state_dim_,
+                         state, state + state_dim_);
+  segment.control_values_.insert(segment.control_values_.begin() + position,
+                                 control_value);
+  segment.bound_values_.insert(segment.bound_values_.begin() + position,
+                               bound_value);
+  piece.last_++;
+  offsets_.back()++;
+  return true;
+}
+
+// Append waypoints [first, last) of the other trajectory.
+void Trajectory::Append(const Trajectory& other, size_t first, size_t last) {
+  if (first >= last)
+    return;
+
+  if (IsEmpty())
+    state_dim_ = other.state_dim_;
+
+  // Share the other trajectory's pieces, trimmed to this range.
+  for (size_t ii = other.Locate(first);
+       ii < other.pieces_.size() && other.offsets_[ii] < last; ii++) {
+    Piece piece = other.pieces_[ii];
+    piece.last_ = piece.first_ +
+      std::min(last, other.offsets_[ii + 1]) - other.offsets_[ii];
+    piece.first_ += std::max(first, other.offsets_[ii]) - other.offsets_[ii];
+
+    pieces_.push_back(piece);
+    offsets_.push_back(offsets_.back() + piece.last_ - piece.first_);
+  }
+}
+
+// Prepend waypoints [first, last) of the other trajectory.
+void Trajectory::Prepend(const Trajectory& other, size_t first, size_t last) {
+  Trajectory prepended;
+  prepended.Append(other, first, last);
+  prepended.Append(*this, 0, Size());
+  std::swap(*this, prepended);
+}
+
+// Drop the last waypoint.
+void Trajectory::RemoveLast() {
+  pieces_.back().last_--;
+  offsets_.back()--;
+
+  if (pieces_.back().first_ == pieces_.back().last_) {
+    pieces_.pop_back();
+    offsets_.pop_back();
+  }
+
+  if (IsEmpty())
+    state_dim_ = 0;
+}
+
+// Copy all waypoints into a single segment used only by this trajectory.
+void Trajectory::Flatten() {
+  if (IsEmpty())
+    return;
+
+  const Piece& front = pieces_.front();
+  if (pieces_.size() == 1 && front.segment_.use_count() == 1 &&
+      front.first_ == 0 && front.last_ == front.segment_->times_.size() &&
+      front.offset_ == 0.0)
+    return;
+
+  const std::shared_ptr<Segment> segment = std::make_shared<Segment>();
+  segment->times_.reserve(Size());
+  segment->states_.reserve(Size() * state_dim_);
+  segment->control_values_.reserve(Size());
+  segment->bound_values_.reserve(Size());
+
+  for (const auto& piece : pieces_) {
+    const Segment& other = *piece.segment_;
+    for (size_t ii = piece.first_; ii < piece.last_; ii++)
+      segment->times_.push_back(piece.Time(ii));
+
+    segment->states_.insert(segment->states_.end(),
+                            other.states_.begin() + piece.first_ * state_dim_,
+                            other.states_.begin() + piece.last_ * state_dim_);
+    segment->control_values_.insert(
+      segment->control_values_.end(),
+      other.control_values_.begin() + piece.first_,
+      other.control_values_.begin() + piece.last_);
+    segment->bound_values_.insert(
+      segment->bound_values_.end(),
+      other.bound_values_.begin() + piece.first_,
+      other.bound_values_.begin() + piece.last_);
+  }
+
+  Piece piece;
+  piece.segment_ = segment;
+  piece.first_ = 0;
+  piece.last_ = Size();
+  piece.offset_ = 0.0;
+
+  pieces_.assign(1, piece);
+  offsets_.resize(2);
+  offsets_[1] = piece.last_;
+}
+
+// Add a whole other Trajectory to this one.
+void Trajectory::Add(const ConstPtr& other) {
+  if (other->IsEmpty() || other.get() == this)
+    return;
+
+  if (IsEmpty()) {
+    Append(*other, 0, other->Size());
+    return;
+  }
+
+  if (other->state_dim_ != state_dim_) {
+    ROS_ERROR("Trajectory: Tried to add a trajectory of dimension %zu to a "
+              "trajectory of dimension %zu.", other->state_dim_, state_dim_);
+    return;
+  }
+
+  // Trajectories are usually stitched end to end, sharing at most the
+  // waypoint where they meet.
+  if (other->FirstTime() >= LastTime()) {
+    Append(*other, (other->FirstTime() == LastTime()) ? 1 : 0, other->Size());
+    return;
+  }
+
+  if (other->LastTime() <= FirstTime()) {
+    Prepend(*other, 0, (other->LastTime() == FirstTime()) ?
+            other->Size() - 1 : other->Size());
+    return;
+  }
+
+  // Otherwise merge the two, preferring our own waypoints on ties.
+  Trajectory merged;
+
+  size_t ii = 0;
+  size_t jj = 0;
+  while (ii < Size() || jj < other->Size()) {
+    if (jj >= other->Size() ||
+        (ii < Size() && TimeAt(ii) <= other->TimeAt(jj))) {
+      if (jj < other->Size() && TimeAt(ii) == other->TimeAt(jj))
+        jj++;
+
+      merged.Insert(TimeAt(ii), State(ii).data(), state_dim_,
+                    ControlValueAt(ii), BoundValueAt(ii));
+      ii++;
+    } else {
+      merged.Insert(other->TimeAt(jj), other->State(jj).data(), state_dim_,
+                    other->ControlValueAt(jj), other->BoundValueAt(jj));
+      jj++;
+    }
+  }
+
+  std::swap(*this, merged);
+}
+
+// Index of the first waypoint with time not less than the given time, and
+// optionally the piece holding it.
+size_t Trajectory::LowerBound(double time, size_t* piece_index) const {
+  // Find the first piece which ends no earlier than this time.
+  const auto piece = std::lower_bound(
+    pieces_.begin(), pieces_.end(), time,
+    [](const Piece& piece, double time) {
+      return piece.Time(piece.last_ - 1) < time;
+    });
+
+  if (piece_index != nullptr)
+    *piece_index = piece - pieces_.begin();
+
+  if (piece == pieces_.end())
+    return Size();
+
+  // Search within it, comparing shifted times.
+  const std::vector<double>& times = piece->segment_->times_;
+  const double offset = piece->offset_;
+  const size_t index = std::lower_bound(
+    times.begin() + piece->first_, times.begin() + piece->last_, time,
+    [offset](double segment_time, double time) {
+      return segment_time + offset < time;
+    }) - times.begin();
+
+  return offsets_[piece - pieces_.begin()] + index - piece->first_;
+}
+
 // Convert to ROS message.
 meta_planner_msgs::Trajectory Trajectory::ToRosMessage() const {
   meta_planner_msgs::Trajectory traj_msg;
   traj_msg.num_waypoints = Size();
 
-  // Iterate through the trajectory and append to message.
-  for (const auto& pair : map_) {
-    // Extract state.
-    const meta_planner_msgs::State state_msg =
-      utils::PackState(pair.second.state_);
+  traj_msg.times.reserve(Size());
+  traj_msg.control_value_function_ids.reserve(Size());
+  traj_msg.bound_value_function_ids.reserve(Size());
+  traj_msg.states.resize(Size());
+
+  size_t index = 0;
+  for (const auto& piece : pieces_) {
+    const Segment& segment = *piece.segment_;
+    for (size_t ii = piece.first_; ii < piece.last_; ii++)
+      traj_msg.times.push_back(piece.Time(ii));
+
+    traj_msg.control_value_function_ids.insert(
+      traj_msg.control_value_function_ids.end(),
+      segment.control_values_.begin() + piece.first_,
+      segment.control_values_.begin() + piece.last_);
+    traj_msg.bound_value_function_ids.insert(
+      traj_msg.bound_value_function_ids.end(),
+      segment.bound_values_.begin() + piece.first_,
+      segment.bound_values_.begin() + piece.last_);
+
+    // Copy each column of the state matrix into its own message.
+    for (size_t ii = piece.first_; ii < piece.last_; ii++) {
+      meta_planner_msgs::State& state_msg = traj_msg.states[index++];
+      state_msg.dimension = state_dim_;
+      state_msg.state.assign(segment.states_.begin() + ii * state_dim_,
+                             segment.states_.begin() + (ii + 1) * state_dim_);
+    }
+  }
+
+  return traj_msg;
+}
 
-    // Update message.
-    traj_msg.states.push_back(state_msg);
-    traj_msg.times.push_back(pair.first);
-    traj_msg.control_value_function_ids.push_back(pair.second.control_value_);
-    traj_msg.bound_value_function_ids.push_back(pair.second.bound_value_);
+// Convert to flat ROS message.
+meta_planner_msgs::FlatTrajectory Trajectory::ToFlatRosMessage() const {
+  meta_planner_msgs::FlatTrajectory traj_msg;
+  traj_msg.num_waypoints = Size();
+  traj_msg.dimension = state_dim_;
+
+  traj_msg.times.reserve(Size());
+  traj_msg.states.reserve(Size() * state_dim_);
+  traj_msg.control_value_function_ids.reserve(Size());
+  traj_msg.bound_value_function_ids.reserve(Size());
+
+  for (const auto& piece : pieces_) {
+    const Segment& segment = *piece.segment_;
+    for (size_t ii = piece.first_; ii < piece.last_; ii++)
+      traj_msg.times.push_back(piece.Time(ii));
+
+    traj_msg.states.insert(traj_msg.states.end(),
+                           segment.states_.begin() + piece.first_ * state_dim_,
+                           segment.states_.begin() + piece.last_ * state_dim_);
+    traj_msg.control_value_function_ids.insert(
+      traj_msg.control_value_function_ids.end(),
+      segment.control_values_.begin() + piece.first_,
+      segment.control_values_.begin() + piece.last_);
+    traj_msg.bound_value_function_ids.insert(
+      traj_msg.bound_value_function_ids.end(),
+      segment.bound_values_.begin() + piece.first_,
+      segment.bound_values_.begin() + piece.last_);
   }
 
   return traj_msg;
 }
 
+// Convert to a patch for a receiver following the given previous trajectory.
+meta_planner_msgs::TrajectoryPatch Trajectory::
+ToPatchRosMessage(const Trajectory::ConstPtr& previous) const {
+  // Count waypoints shared with the previous trajectory from our start.
+  size_t shared = 0;
+  if (previous != nullptr && !previous->IsEmpty() && !IsEmpty() &&
+      previous->state_dim_ == state_dim_) {
+    for (size_t jj = previous->LowerBound(FirstTime());
+         shared < Size() && jj < previous->Size(); shared++, jj++) {
+      if (TimeAt(shared) != previous->TimeAt(jj) ||
+          ControlValueAt(shared) != previous->ControlValueAt(jj) ||
+          BoundValueAt(shared) != previous->BoundValueAt(jj) ||
+          State(shared) != previous->State(jj))
+        break;
+    }
+  }
+
+  // Splice at the last shared waypoint, so the suffix starts where the
+  // receiver's trajectory leaves off.
+  const size_t splice = (shared == 0) ? 0 : shared - 1;
+
+  meta_planner_msgs::TrajectoryPatch patch;
+  if (IsEmpty())
+    return patch;
+
+  patch.splice_time = TimeAt(splice);
+
+  Trajectory suffix;
+  suffix.Append(*this, splice, Size());
+  patch.suffix = suffix.ToFlatRosMessage();
+  return patch;
+}
+
 // Find the state corresponding to a particular time via linear interpolation.
 VectorXd Trajectory::GetState(double time) const {
 #ifdef ENABLE_DEBUG_MESSAGES
@@ -153,32 +590,41 @@ VectorXd Trajectory::GetState(double time) const {
   }
 #endif
 
-  // Get a const iterator to a time not less than this one.
-  std::map<double, StateValue>::const_iterator iter = map_.lower_bound(time);
+  // Get the index of a time not less than this one, and its piece.
+  size_t piece = 0;
+  const size_t index = LowerBound(time, &piece);
 
 #ifdef ENABLE_DEBUG_MESSAGES
-  if (iter == map_.end()) {
+  if (index == Size()) {
     ROS_WARN_THROTTLE(1.0, "Could not interpolate. Time was too late.");
     return LastState();
   }
 
-  if (iter == map_.begin()) {
+  if (index == 0) {
     ROS_WARN_THROTTLE(1.0, "Could not interpolate. Time was too early.");
     return FirstState();
   }
 #endif
 
   // Get the state with time not later than this time.
-  const double upper_time = iter->first;
-  const VectorXd& upper_state = iter->second.state_;
+  const Piece& upper_piece = pieces_[piece];
+  const size_t upper = upper_piece.first_ + index - offsets_[piece];
+  const double upper_time = upper_piece.Time(upper);
+  const Eigen::Map<const VectorXd> upper_state =
+    State(*upper_piece.segment_, upper);
 
   if (upper_time == time)
     return upper_state;
 
-  // Get the state with time earlier than this time.
-  iter--;
-  const double lower_time = iter->first;
-  const VectorXd& lower_state = iter->second.state_;
+  // Get the state with time earlier than this time. It may be the last one
+  // in the previous piece.
+  const Piece& lower_piece = (upper > upper_piece.first_) ?
+    upper_piece : pieces_[piece - 1];
+  const size_t lower = (upper > upper_piece.first_) ?
+    upper - 1 : lower_piece.last_ - 1;
+  const double lower_time = lower_piece.Time(lower);
+  const Eigen::Map<const VectorXd> lower_state =
+    State(*lower_piece.segment_, lower);
 
   // Linear interpolation.
   return lower_state + (upper_state - lower_state) *
@@ -194,28 +640,28 @@ ValueFunctionId Trajectory::GetControlValueFunction(double time) const {
   }
 #endif
 
-  // Get a const iterator to a time not less than this one.
-  std::map<double, StateValue>::const_iterator iter = map_.lower_bound(time);
+  // Get the index of a time not less than this one.
+  const size_t index = LowerBound(time);
 
   // Catch end.
-  if (iter == map_.end()) {
+  if (index == Size()) {
     ROS_WARN("This time occurred after the trajectory.");
-    return (--iter)->second.control_value_;
+    return ControlValueAt(index - 1);
   }
 
   // Catch equality.
-  if (iter->first == time)
-    return iter->second.control_value_;
+  if (TimeAt(index) == time)
+    return ControlValueAt(index);
 
   // Catch beginning. Note this occurs after equality check, so if this is
   // true then the specified time must occur before the start of the trajectory.
-  if (iter == map_.begin()) {
+  if (index == 0) {
     ROS_WARN("This time occurred before the trajectory.");
-    return iter->second.control_value_;
+    return ControlValueAt(index);
   }
 
-  // Regular case: iter is after the specified time.
-  return (--iter)->second.control_value_;
+  // Regular case: index is after the specified time.
+  return ControlValueAt(index - 1);
 }
 
 // Return the ID of the value function being used at this time.
@@ -227,103 +673,222 @@ ValueFunctionId Trajectory::GetBoundValueFunction(double time) const {
   }
 #endif
 
-  // Get a const iterator to a time not less than this one.
-  std::map<double, StateValue>::const_iterator iter = map_.lower_bound(time);
+  // Get the index of a time not less than this one.
+  const size_t index = LowerBound(time);
 
   // Catch end.
-  if (iter == map_.end()) {
+  if (index == Size()) {
     ROS_WARN("This time occurred after the trajectory.");
-    return (--iter)->second.bound_value_;
+    return BoundValueAt(index - 1);
   }
 
   // Catch equality.
-  if (iter->first == time)
-    return iter->second.bound_value_;
+  if (TimeAt(index) == time)
+    return BoundValueAt(index);
 
   // Catch beginning. Note this occurs after equality check, so if this is
   // true then the specified time must occur before the start of the trajectory.
-  if (iter == map_.begin()) {
+  if (index == 0) {
     ROS_WARN("This time occurred before the trajectory.");
-    return iter->second.bound_value_;
+    return BoundValueAt(index);
+  }
+
+  // Regular case: index is after the specified time.
+  return BoundValueAt(index - 1);
+}
+
+// Move to the first waypoint with time not less than the given time.
+void Trajectory::Cursor::Seek(double time) {
+  const Trajectory& traj = *traj_;
+
+  // Time at the current index, which must be in the current piece.
+  const auto time_at = [&traj](size_t piece, size_t index) {
+    const Piece& p = traj.pieces_[piece];
+    return p.Time(p.first_ + index - traj.offsets_[piece]);
+  };
+
+  // Check that the cached position is consistent with the trajectory, and
+  // that the previous waypoint is earlier than this time. That fails if
+  // time went backward or the trajectory changed under us.
+  bool valid = index_ <= traj.Size() && piece_ < traj.offsets_.size() &&
+    traj.offsets_[piece_] <= index_ &&
+    (piece_ == traj.pieces_.size() || index_ < traj.offsets_[piece_ + 1]);
+  if (valid && index_ > 0) {
+    const size_t previous = (index_ > traj.offsets_[piece_]) ?
+      piece_ : piece_ - 1;
+    valid = time_at(previous, index_ - 1) < time;
+  }
+
+  if (valid) {
+    // Step forward a few waypoints, then give up and search.
+    const size_t kMaxSteps = 8;
+    for (size_t ii = 0; ii < kMaxSteps; ii++) {
+      if (index_ == traj.Size() || time_at(piece_, index_) >= time)
+        return;
+
+      if (++index_ == traj.offsets_[piece_ + 1])
+        piece_++;
+    }
+  }
+
+  index_ = traj.LowerBound(time, &piece_);
+}
+
+// Find the interpolated state and the value functions in use at this time.
+void Trajectory::Cursor::Get(double time, VectorXd& state,
+                             ValueFunctionId& control_value,
+                             ValueFunctionId& bound_value) {
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (traj_ == nullptr || traj_->IsEmpty()) {
+    ROS_WARN("Tried to interpolate an empty trajectory.");
+    throw std::underflow_error("Tried to interpolate an empty trajectory.");
+  }
+#endif
+
+  Seek(time);
+  const Trajectory& traj = *traj_;
+
+  // Catch end.
+  if (index_ == traj.Size()) {
+    ROS_WARN_THROTTLE(1.0, "This time occurred after the trajectory.");
+    state = traj.LastState();
+    control_value = traj.LastControlValueFunction();
+    bound_value = traj.LastBoundValueFunction();
+    return;
   }
 
-  // Regular case: iter is after the specified time.
-  return (--iter)->second.bound_value_;
+  // Waypoint at or after this time.
+  const Piece& upper_piece = traj.pieces_[piece_];
+  const Segment& upper_segment = *upper_piece.segment_;
+  const size_t upper = upper_piece.first_ + index_ - traj.offsets_[piece_];
+  const double upper_time = upper_piece.Time(upper);
+
+  // Catch equality, and then beginning.
+  if (upper_time == time || index_ == 0) {
+    if (upper_time != time)
+      ROS_WARN_THROTTLE(1.0, "This time occurred before the trajectory.");
+
+    state = traj.State(upper_segment, upper);
+    control_value = upper_segment.control_values_[upper];
+    bound_value = upper_segment.bound_values_[upper];
+    return;
+  }
+
+  // Regular case: the previous waypoint is before this time. It may be the
+  // last of the previous piece.
+  const Piece& lower_piece = (upper > upper_piece.first_) ?
+    upper_piece : traj.pieces_[piece_ - 1];
+  const size_t lower = (upper > upper_piece.first_) ?
+    upper - 1 : lower_piece.last_ - 1;
+
+  const Segment* lower_segment = lower_piece.segment_.get();
+  const double lower_time = lower_piece.Time(lower);
+  const Eigen::Map<const VectorXd> lower_state =
+    traj.State(*lower_segment, lower);
+
+  // Linear interpolation.
+  state = lower_state + (traj.State(upper_segment, upper) - lower_state) *
+    (time - lower_time) / (upper_time - lower_time);
+  control_value = lower_segment->control_values_[lower];
+  bound_value = lower_segment->bound_values_[lower];
 }
 
 // Swap out the control value function in this trajectory and update time
 // stamps accordingly.
 void Trajectory::ExecuteSwitch(ValueFunctionId value,
-                               ros::ServiceClient& best_time_srv) {
-  std::map<double, StateValue> switched;
+                               const ValueFunctionProvider::ConstPtr& values) {
+  if (IsEmpty())
+    return;
+
+  // The best possible time between waypoints only depends on how far apart
+  // they are and the max planner speed, so look that up once.
+  Vector3d max_speed;
+  const bool have_speed = values->MaxPlannerSpeed(value, max_speed);
+  if (!have_speed)
+    ROS_ERROR("Trajectory: Error computing max planner speed. "
+              "Assuming fixed dt.");
+
+  const std::shared_ptr<Segment> switched = std::make_shared<Segment>();
+  switched->times_.reserve(Size());
+  switched->states_.reserve(Size() * state_dim_);
+  switched->control_values_.reserve(Size());
+  switched->bound_values_.reserve(Size());
 
   double last_time = FirstTime();
-  VectorXd last_state = FirstState();
-
-  // HACK! Assuming state layout.
-  Vector3d last_position(last_state(0), last_state(1), last_state(2));
-  for (auto iter = map_.begin(); iter != map_.end(); iter++) {
-    // (1) Compute time for this state from last_time.
-    const ValueFunctionId bound = iter->second.bound_value_;
-    const VectorXd state = iter->second.state_;
-
-    // HACK! Still assuming state layout.
-    const Vector3d position(state(0), state(1), state(2));
-
-    double dt = 10.0;
-    value_function_srvs::GeometricPlannerTime t;
-    t.request.id = value;
-    t.request.start = utils::Pack(last_position);
-    t.request.stop = utils::Pack(position);
-    if (!best_time_srv)
-      ROS_WARN("Trajectory: Best time server disconnected. Assuming fixed dt.");
-    else if (!best_time_srv.call(t))
-      ROS_ERROR("Trajectory: Error calling best time server.");
-    else
-      dt = t.response.time;
-
-    const double time = last_time + dt;
-
-    // (2) Insert this tuple into 'switched'.
-    switched.insert({ time, StateValue(state, value, bound) });
-
-    // (3) Update last_state, last_time, and last_position.
-    last_state = state;
-    last_position = position;
-    last_time = time;
-  }
-
-  // Swap out map_ for switched.
-  map_.clear();
-  map_.insert(switched.begin(), switched.end());
+  const double* last_state = FirstState().data();
+  for (const auto& piece : pieces_) {
+    const Segment& segment = *piece.segment_;
+    for (size_t ii = piece.first_; ii < piece.last_; ii++) {
+      const double* state = segment.states_.data() + ii * state_dim_;
+
+      // (1) Compute time for this state from last_time.
+      // HACK! Assuming state layout.
+      double dt = 10.0;
+      if (have_speed) {
+        dt = 0.0;
+        for (size_t jj = 0; jj < 3; jj++)
+          dt = std::max(dt, std::abs(state[jj] - last_state[jj]) /
+                        max_speed(jj));
+      }
+
+      const double time = last_time + dt;
+
+      // (2) Append this tuple, unless it is at the same time as the last.
+      if (switched->times_.empty() || time != switched->times_.back()) {
+        switched->times_.push_back(time);
+        switched->states_.insert(switched->states_.end(),
+                                 state, state + state_dim_);
+        switched->control_values_.push_back(value);
+        switched->bound_values_.push_back(segment.bound_values_[ii]);
+      }
+
+      // (3) Update last_state and last_time.
+      last_state = state;
+      last_time = time;
+    }
+  }
+
+  // Swap out this trajectory's pieces for the switched segment.
+  Piece piece;
+  piece.segment_ = switched;
+  piece.first_ = 0;
+  piece.last_ = switched->times_.size();
+  piece.offset_ = 0.0;
+
+  pieces_.assign(1, piece);
+  offsets_.resize(2);
+  offsets_[1] = piece.last_;
 }
 
 // Adjust the time stamps for this trajectory to start at the given time.
 void Trajectory::ResetStartTime(double start) {
-  std::map<double, StateValue> reset;
+  if (IsEmpty())
+    return;
 
   // Compute difference between this start time and current start time.
   const double delay = start - FirstTime();
 
-  // Loop over all pairs in the map and update time in reset.
-  for (const auto& pair : map_) {
-    const double time = pair.first + delay;
-
-    // Insert into reset.
-    reset.insert({ time, pair.second });
-  }
-
-  // Swap out map_ for reset.
-  map_.clear();
-  map_.insert(reset.begin(), reset.end());
+  // Shift every piece. Other trajectories sharing these segments are
+  // unaffected, since they have their own pieces.
+  for (auto& piece : pieces_)
+    piece.offset_ += delay;
 }
 
 // Visualize this trajectory in RVIZ.
 void Trajectory::Visualize(const ros::Publisher& pub,
-                           const std::string& frame_id) const {
-  if (pub.getNumSubscribers() <= 0)
+                           const std::string& frame_id,
+                           size_t max_points) const {
+  if (pub.getNumSubscribers() <= 0 || IsEmpty())
     return;
 
+  // Keep every stride-th waypoint, and the last one.
+  max_points = std::max<size_t>(max_points, 2);
+  const size_t stride = (Size() > max_points) ?
+    (Size() - 2) / (max_points - 1) + 1 : 1;
+
+  const size_t num_points = (Size() - 1) / stride + 1 +
+    (((Size() - 1) % stride == 0) ? 0 : 1);
+
   // Set up spheres marker.
   visualization_msgs::Marker spheres;
   spheres.ns = "spheres";
@@ -361,29 +926,43 @@ void Trajectory::Visualize(const ros::Publisher& pub,
   lines.color.b = 0.6;
 #endif
 
-  // Iterate through the trajectory and append to markers.
-  for (const auto& pair : map_) {
-    // Extract point. HACK! Assuming state layout.
-    geometry_msgs::Point p;
-    p.x = pair.second.state_(0);
-    p.y = pair.second.state_(1);
-    p.z = pair.second.state_(2);
-
-    const std_msgs::ColorRGBA c = Colormap(pair.first);
+  spheres.points.reserve(num_points);
+  spheres.colors.reserve(num_points);
+  lines.points.reserve(num_points);
+  lines.colors.reserve(num_points);
 
-    // Handle 'spheres' marker.
-    spheres.points.push_back(p);
-    spheres.colors.push_back(c);
-
-    // Handle 'lines' marker.
-    lines.points.push_back(p);
-    lines.colors.push_back(c);
+  // Iterate through the trajectory and append to markers.
+  size_t index = 0;
+  for (const auto& piece : pieces_) {
+    const Segment& segment = *piece.segment_;
+    for (size_t ii = piece.first_; ii < piece.last_; ii++, index++) {
+      if (index % stride != 0 && index + 1 != Size())
+        continue;
+
+      // Extract point. HACK! Assuming state layout.
+      const double* state = segment.states_.data() + ii * state_dim_;
+
+      geometry_msgs::Point p;
+      p.x = state[0];
+      p.y = state[1];
+      p.z = state[2];
+
+      const std_msgs::ColorRGBA c = Colormap(piece.Time(ii));
+
+      // Handle 'spheres' marker.
+      spheres.points.push_back(p);
+      spheres.colors.push_back(c);
+
+      // Handle 'lines' marker.
+      lines.points.push_back(p);
+      lines.colors.push_back(c);
+    }
   }
 
   // Publish markers. Only publish 'lines' if more than one point in trajectory.
   pub.publish(spheres);
 
-  if (Size() > 1)
+  if (num_points > 1)
     pub.publish(lines);
 }
 
@@ -423,9 +1002,10 @@ std_msgs::ColorRGBA Trajectory::Colormap(double time) const {
 // Print this trajectory to stdout.
 void Trajectory::Print(const std::string& prefix) const {
   std::cout << prefix << std::endl;
-  for (const auto& pair : map_)
-    std::cout << pair.first << " -- "
-              << pair.second.state_.transpose() << std::endl;
+  for (const auto& piece : pieces_)
+    for (size_t ii = piece.first_; ii < piece.last_; ii++)
+      std::cout << piece.Time(ii) << " -- "
+                << State(*piece.segment_, ii).transpose() << std::endl;
 }
 
 } //\namespace meta
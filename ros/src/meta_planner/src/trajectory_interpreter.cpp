@@ -63,6 +63,22 @@ bool TrajectoryInterpreter::Initialize(const ros::NodeHandle& n) {
     return false;
   }
 
+  // Set up value functions. Must happen before the timer starts.
+  values_ = ValueFunctionProvider::Create(n);
+  if (values_ == nullptr) {
+    ROS_ERROR("%s: Failed to set up value functions.", name_.c_str());
+    return false;
+  }
+
+  // Planner dynamics with dummy control bounds. We only need them to lift
+  // polynomial trajectories into the planner's state space.
+  dynamics_ = NearHoverQuadNoYaw::Create(VectorXd::Zero(control_dim_),
+                                         VectorXd::Zero(control_dim_));
+
+  // Start resampling trajectories in the background.
+  references_ = ReferenceBuffer::Create(
+    time_step_, reference_horizon_, values_);
+
   if (!RegisterCallbacks(n)) {
     ROS_ERROR("%s: Failed to register callbacks.", name_.c_str());
     return false;
@@ -84,6 +100,9 @@ bool TrajectoryInterpreter::LoadParameters(const ros::NodeHandle& n) {
 
   // Control parameters.
   if (!nl.getParam("control/time_step", time_step_)) return false;
+  nl.param("control/reference_horizon", reference_horizon_, 2.0);
+  nl.param("vis/traj_rate", traj_vis_rate_, 2.0);
+  nl.param("vis/traj_max_points", traj_vis_max_points_, 500);
 
   int dimension = 1;
   if (!nl.getParam("control/dim", dimension)) return false;
@@ -96,12 +115,12 @@ bool TrajectoryInterpreter::LoadParameters(const ros::NodeHandle& n) {
   if (!nl.getParam("state/dim", dimension)) return false;
   state_dim_ = static_cast<size_t>(dimension);
 
-  // Service names.
-  if (!nl.getParam("srv/tracking_bound", tracking_bound_name_)) return false;
-
   // Topics and frame ids.
   if (!nl.getParam("topics/state", state_topic_)) return false;
   if (!nl.getParam("topics/traj", traj_topic_)) return false;
+  nl.param<std::string>("topics/flat_traj", flat_traj_topic_, "");
+  nl.param<std::string>("topics/poly_traj", poly_traj_topic_, "");
+  nl.param<std::string>("topics/traj_patch", traj_patch_topic_, "");
   if (!nl.getParam("topics/reference", reference_topic_)) return false;
   if (!nl.getParam("topics/controller_id", controller_id_topic_))
     return false;
@@ -124,9 +143,24 @@ bool TrajectoryInterpreter::LoadParameters(const ros::NodeHandle& n) {
 bool TrajectoryInterpreter::RegisterCallbacks(const ros::NodeHandle& n) {
   ros::NodeHandle nl(n);
 
-  // Subscribers.
-  traj_sub_ = nl.subscribe(
-    traj_topic_.c_str(), 1, &TrajectoryInterpreter::TrajectoryCallback, this);
+  // Subscribers. Listen for polynomial trajectories if asked to, which are
+  // evaluated in closed form and replace the whole trajectory. Otherwise for
+  // trajectory patches, then the flat format, and otherwise the old one.
+  if (!poly_traj_topic_.empty())
+    traj_sub_ = nl.subscribe(
+      poly_traj_topic_.c_str(), 1,
+      &TrajectoryInterpreter::PolynomialTrajectoryCallback, this);
+  else if (!traj_patch_topic_.empty())
+    traj_sub_ = nl.subscribe(traj_patch_topic_.c_str(), 1,
+                             &TrajectoryInterpreter::TrajectoryPatchCallback,
+                             this);
+  else if (!flat_traj_topic_.empty())
+    traj_sub_ = nl.subscribe(flat_traj_topic_.c_str(), 1,
+                             &TrajectoryInterpreter::FlatTrajectoryCallback,
+                             this);
+  else
+    traj_sub_ = nl.subscribe(traj_topic_.c_str(), 1,
+                             &TrajectoryInterpreter::TrajectoryCallback, this);
 
   state_sub_ = nl.subscribe(
     state_topic_.c_str(), 1, &TrajectoryInterpreter::StateCallback, this);
@@ -143,6 +177,10 @@ bool TrajectoryInterpreter::RegisterCallbacks(const ros::NodeHandle& n) {
   traj_vis_pub_ = nl.advertise<visualization_msgs::Marker>(
     traj_vis_topic_.c_str(), 1, false);
 
+  visualizer_ = TrajectoryVisualizer::Create(
+    traj_vis_pub_, fixed_frame_id_, traj_vis_rate_,
+    static_cast<size_t>(std::max(traj_vis_max_points_, 2)));
+
   tracking_bound_pub_ = nl.advertise<visualization_msgs::Marker>(
     tracking_bound_topic_.c_str(), 1, false);
 
@@ -156,11 +194,6 @@ bool TrajectoryInterpreter::RegisterCallbacks(const ros::NodeHandle& n) {
   request_traj_pub_ = nl.advertise<meta_planner_msgs::TrajectoryRequest>(
     request_traj_topic_.c_str(), 1, false);
 
-  // Service clients.
-  ros::service::waitForService(tracking_bound_name_.c_str());
-  tracking_bound_srv_ = nl.serviceClient<value_function_srvs::TrackingBoundBox>(
-    tracking_bound_name_.c_str(), true);
-
   // Timer.
   timer_ = nl.createTimer(ros::Duration(time_step_),
                           &TrajectoryInterpreter::TimerCallback, this);
@@ -171,7 +204,69 @@ bool TrajectoryInterpreter::RegisterCallbacks(const ros::NodeHandle& n) {
 // Callback for processing trajectory updates.
 void TrajectoryInterpreter::
 TrajectoryCallback(const meta_planner_msgs::Trajectory::ConstPtr& msg) {
-  traj_ = Trajectory::Create(msg);
+  SetTrajectory(Trajectory::Create(msg));
+}
+
+void TrajectoryInterpreter::
+FlatTrajectoryCallback(const meta_planner_msgs::FlatTrajectory::ConstPtr& msg) {
+  SetTrajectory(Trajectory::Create(msg));
+}
+
+// Follow polynomial trajectories in closed form. Only their knots are
+// sampled, for replanning, hovering and visualization.
+void TrajectoryInterpreter::PolynomialTrajectoryCallback(
+  const meta_planner_msgs::PolynomialTrajectory::ConstPtr& msg) {
+  const PolynomialTrajectory::ConstPtr poly = PolynomialTrajectory::Create(msg);
+
+  if (poly->IsEmpty()) {
+    ROS_WARN("%s: Ignoring empty polynomial trajectory.", name_.c_str());
+    return;
+  }
+
+  // Look up the tracking bounds once, rather than on every tick.
+  std::unordered_map<ValueFunctionId, Vector3d> bounds;
+  for (const ValueFunctionId bound_value : poly->BoundValueFunctions()) {
+    Vector3d bound;
+    if (bounds.count(bound_value) == 0 &&
+        values_->TrackingBound(bound_value, bound))
+      bounds.emplace(bound_value, bound);
+  }
+
+  poly_bounds_.swap(bounds);
+  SetTrajectory(poly->ToTrajectory(dynamics_), poly);
+}
+
+// Callback for processing trajectory patches, which replace the current
+// trajectory from their splice time on.
+void TrajectoryInterpreter::
+TrajectoryPatchCallback(const meta_planner_msgs::TrajectoryPatch::ConstPtr& msg) {
+  // Keep what is left of the current trajectory up to the splice time, and
+  // follow the suffix from then on. The swap happens in one step, between
+  // control ticks.
+  const Trajectory::Ptr traj =
+    Trajectory::Create(traj_, msg, ros::Time::now().toSec());
+
+  if (traj->IsEmpty()) {
+    ROS_WARN("%s: Ignoring empty trajectory patch.", name_.c_str());
+    return;
+  }
+
+  SetTrajectory(traj);
+}
+
+// Switch to following a new trajectory.
+void TrajectoryInterpreter::
+SetTrajectory(const Trajectory::Ptr& traj,
+              const PolynomialTrajectory::ConstPtr& poly) {
+  poly_ = poly;
+  traj_ = traj;
+  cursor_ = Trajectory::Cursor(traj_);
+
+  // Polynomials are evaluated in closed form, so there is nothing to
+  // resample. Drop the previous trajectory's references either way.
+  references_->Reset((poly_ == nullptr) ? traj_ : nullptr,
+                     ros::Time::now().toSec());
+  visualizer_->Update(traj_);
 }
 
 // Callback for processing state updates.
@@ -231,12 +326,43 @@ void TrajectoryInterpreter::TimerCallback(const ros::TimerEvent& e) {
     return;
   }
 
-  const VectorXd planner_state = traj_->GetState(current_time.toSec());
-  const VectorXd relative_state = state_ - planner_state;
+  // Look up the planner state, the control and bound value functions and
+  // the tracking bound. Polynomial trajectories are evaluated in closed
+  // form, with tracking bounds looked up on arrival. Otherwise use the
+  // references precomputed at the control rate, and until they are ready,
+  // look them up directly. Time only moves forward, so the cursor rarely
+  // searches.
+  ValueFunctionId control_value_id, bound_value_id;
+  Vector3d planner_position, planner_velocity;
+  Vector3d bound;
+  bool have_bound = false;
+  if (poly_ != nullptr) {
+    poly_->GetState(current_time.toSec(), planner_position, planner_velocity);
+    control_value_id = poly_->GetControlValueFunction(current_time.toSec());
+    bound_value_id = poly_->GetBoundValueFunction(current_time.toSec());
+
+    const auto bound_iter = poly_bounds_.find(bound_value_id);
+    if (bound_iter != poly_bounds_.end()) {
+      bound = bound_iter->second;
+      have_bound = true;
+    }
+  } else {
+    if (references_->Get(current_time.toSec(), planner_state_,
+                         control_value_id, bound_value_id, bound))
+      have_bound = true;
+    else
+      cursor_.Get(current_time.toSec(), planner_state_,
+                  control_value_id, bound_value_id);
 
-  // HACK! Assuming state layout.
-  const Vector3d planner_position(
-    planner_state(0), planner_state(1), planner_state(2));
+    // HACK! Assuming state layout.
+    planner_position = planner_state_.head<3>();
+    planner_velocity = planner_state_.segment<3>(3);
+  }
+
+  if (!have_bound && !values_->TrackingBound(bound_value_id, bound)) {
+    ROS_ERROR("%s: Error computing tracking bound.", name_.c_str());
+    bound = Vector3d::Zero();
+  }
 
   // Publish planner state on tf.
   geometry_msgs::TransformStamped transform_stamped;
@@ -256,14 +382,7 @@ void TrajectoryInterpreter::TimerCallback(const ros::TimerEvent& e) {
 
   br_.sendTransform(transform_stamped);
 
-  // (2) Get corresponding control and bound value function.
-  const ValueFunctionId control_value_id =
-    traj_->GetControlValueFunction(current_time.toSec());
-  const ValueFunctionId bound_value_id =
-    traj_->GetBoundValueFunction(current_time.toSec());
-
-  // Publish planner position to the reference topic.
-  // HACK! Assuming planner state order.
+  // (2) Publish planner position to the reference topic.
   crazyflie_msgs::PositionVelocityStateStamped reference;
   reference.header.stamp = current_time;
 
@@ -271,9 +390,9 @@ void TrajectoryInterpreter::TimerCallback(const ros::TimerEvent& e) {
   reference.state.y = planner_position(1);
   reference.state.z = planner_position(2);
 
-  reference.state.x_dot = planner_state(3);
-  reference.state.y_dot = planner_state(4);
-  reference.state.z_dot = planner_state(5);
+  reference.state.x_dot = planner_velocity(0);
+  reference.state.y_dot = planner_velocity(1);
+  reference.state.z_dot = planner_velocity(2);
 
   reference_pub_.publish(reference);
 
@@ -292,26 +411,9 @@ void TrajectoryInterpreter::TimerCallback(const ros::TimerEvent& e) {
   tracking_bound_marker.type = visualization_msgs::Marker::CUBE;
   tracking_bound_marker.action = visualization_msgs::Marker::ADD;
 
-  tracking_bound_marker.scale.x = 0.0;
-  tracking_bound_marker.scale.y = 0.0;
-  tracking_bound_marker.scale.z = 0.0;
-
-  if (!tracking_bound_srv_) {
-    ROS_WARN("%s: Tracking bound server disconnected.", name_.c_str());
-    ros::NodeHandle nl;
-    tracking_bound_srv_ = nl.serviceClient<value_function_srvs::TrackingBoundBox>(
-      tracking_bound_name_.c_str(), true);
-  } else {
-    value_function_srvs::TrackingBoundBox b;
-    b.request.id = bound_value_id;
-    if (!tracking_bound_srv_.call(b))
-      ROS_ERROR("%s: Tracking bound server error.", name_.c_str());
-    else {
-      tracking_bound_marker.scale.x = 2.0 * b.response.x;
-      tracking_bound_marker.scale.y = 2.0 * b.response.y;
-      tracking_bound_marker.scale.z = 2.0 * b.response.z;
-    }
-  }
+  tracking_bound_marker.scale.x = 2.0 * bound(0);
+  tracking_bound_marker.scale.y = 2.0 * bound(1);
+  tracking_bound_marker.scale.z = 2.0 * bound(2);
 
   tracking_bound_marker.color.a = 0.3;
   tracking_bound_marker.color.r = 0.5;
@@ -319,9 +421,6 @@ void TrajectoryInterpreter::TimerCallback(const ros::TimerEvent& e) {
   tracking_bound_marker.color.b = 0.5;
 
   tracking_bound_pub_.publish(tracking_bound_marker);
-
-  // Visualize trajectory.
-  traj_->Visualize(traj_vis_pub_, fixed_frame_id_);
 }
 
 // Request a new trajectory from the meta planner.
@@ -361,7 +460,6 @@ void TrajectoryInterpreter::Hover() {
   // so that it has the largest error bound.
   if (traj_ == nullptr) {
     ROS_INFO("%s: No existing trajectory. Hovering in place.", name_.c_str());
-    traj_ = Trajectory::Create();
 
     // Get a zero-velocity version of the current state.
     // HACK! Assuming state layout.
@@ -370,8 +468,12 @@ void TrajectoryInterpreter::Hover() {
     hover_state(4) = 0.0;
     hover_state(5) = 0.0;
 
-    traj_->Add(now, hover_state, 0, 0);
-    traj_->Add(now + max_meta_runtime_ + 10.0, hover_state, 0, 0);
+    // Build it before following it, since it is resampled in the background.
+    const Trajectory::Ptr hover = Trajectory::Create();
+    hover->Add(now, hover_state, 0, 0);
+    hover->Add(now + max_meta_runtime_ + 10.0, hover_state, 0, 0);
+
+    SetTrajectory(hover);
     return;
   }
 
@@ -395,7 +497,7 @@ void TrajectoryInterpreter::Hover() {
              hover->LastControlValueFunction(),
              hover->LastControlValueFunction());
 
-  traj_ = hover;
+  SetTrajectory(hover);
 }
 
 } //\namespace meta
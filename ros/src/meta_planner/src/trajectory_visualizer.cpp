@@ -0,0 +1,122 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the TrajectoryVisualizer class, which publishes RVIZ markers for
+// the latest trajectory from a background thread at a capped rate.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <meta_planner/trajectory_visualizer.h>
+
+namespace meta {
+
+TrajectoryVisualizer::TrajectoryVisualizer(const ros::Publisher& pub,
+                                           const std::string& frame_id,
+                                           double rate, size_t max_points)
+  : pub_(pub),
+    frame_id_(frame_id),
+    period_(1.0 / rate),
+    max_points_(max_points),
+    version_(0),
+    stop_(false) {
+  thread_ = std::thread(&TrajectoryVisualizer::Run, this);
+}
+
+// Destructor. Stops the background thread.
+TrajectoryVisualizer::~TrajectoryVisualizer() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+
+  wake_.notify_one();
+  thread_.join();
+}
+
+// Factory method. Use this instead of the constructor.
+TrajectoryVisualizer::Ptr TrajectoryVisualizer::
+Create(const ros::Publisher& pub, const std::string& frame_id,
+       double rate, size_t max_points) {
+  if (rate <= 0.0) {
+    ROS_WARN("TrajectoryVisualizer: Rate must be positive. Using 1 Hz.");
+    rate = 1.0;
+  }
+
+  Ptr ptr(new TrajectoryVisualizer(pub, frame_id, rate, max_points));
+  return ptr;
+}
+
+// Visualize the given trajectory from now on.
+void TrajectoryVisualizer::Update(const Trajectory::ConstPtr& traj) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  traj_ = traj;
+  version_++;
+}
+
+// Background thread. Wakes up at the capped rate and republishes if
+// anything has changed.
+void TrajectoryVisualizer::Run() {
+  // Version last published, and to how many subscribers.
+  size_t version = 0;
+  size_t num_subscribers = 0;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    wake_.wait_for(lock, period_, [this]() { return stop_; });
+    if (stop_)
+      return;
+
+    // Republish for new subscribers, since markers are not latched.
+    const size_t subscribers = pub_.getNumSubscribers();
+    const bool joined = subscribers > num_subscribers;
+    num_subscribers = subscribers;
+    if (subscribers == 0 || (version == version_ && !joined))
+      continue;
+
+    version = version_;
+    const Trajectory::ConstPtr traj = traj_;
+    lock.unlock();
+
+    if (traj != nullptr)
+      traj->Visualize(pub_, frame_id_, max_points_);
+
+    lock.lock();
+  }
+}
+
+} //\namespace meta
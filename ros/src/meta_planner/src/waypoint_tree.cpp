@@ -49,53 +49,85 @@ namespace meta {
 WaypointTree::WaypointTree(const Vector3d& start,
                            ValueFunctionId start_value,
                            double start_time)
-  : root_(Waypoint::Create(start, start_value, nullptr, nullptr)),
+  : root_(Waypoint::Create(start, start_value, nullptr, nullptr, nullptr)),
     start_time_(start_time) {
   kdtree_.Insert(root_);
 }
 
 // Add Waypoint to tree.
 void WaypointTree::Insert(const Waypoint::ConstPtr& waypoint, bool is_terminal) {
-  kdtree_.Insert(waypoint);
-
-  if (is_terminal) {
-    if (terminus_ == nullptr) {
-      ROS_WARN("Set initial terminus.");
-      terminus_ = waypoint;
-    }
-    else if (waypoint->traj_->LastTime() < terminus_->traj_->LastTime()) {
-      ROS_WARN("Updated terminus.");
-      terminus_ = waypoint;
-    }
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    kdtree_.Insert(waypoint);
   }
+
+  if (!is_terminal)
+    return;
+
+  // Swap in this terminus unless another thread has a faster one.
+  Waypoint::ConstPtr terminus = std::atomic_load(&terminus_);
+  do {
+    if (terminus != nullptr &&
+        waypoint->traj_->LastTime() >= terminus->traj_->LastTime())
+      return;
+  } while (!std::atomic_compare_exchange_weak(&terminus_, &terminus, waypoint));
+
+  if (terminus == nullptr)
+    ROS_WARN("Set initial terminus.");
+  else
+    ROS_WARN("Updated terminus.");
 }
 
 // Get best total time (seconds) of any valid trajectory. Returns negative
 // if no valid trajectory exists.
 double WaypointTree::BestTime() const {
-  if (terminus_ == nullptr)
+  const Waypoint::ConstPtr terminus = std::atomic_load(&terminus_);
+  if (terminus == nullptr)
     return std::numeric_limits<double>::infinity();
 
-  return terminus_->traj_->LastTime() - start_time_;
+  return terminus->traj_->LastTime() - start_time_;
 }
 
 // Get best (fastest) trajectory (if it exists).
 Trajectory::Ptr WaypointTree::BestTrajectory() const {
-  if (terminus_ == nullptr) {
+  const Waypoint::ConstPtr terminus = std::atomic_load(&terminus_);
+  if (terminus == nullptr) {
     ROS_WARN("Tree did not reach to the terminus.");
     return nullptr;
   }
 
-  Trajectory::Ptr traj = Trajectory::Create();
-
-  // Walk back from the terminus, and append trajectories as we go.
-  Waypoint::ConstPtr waypoint = terminus_;
+  // Walk back from the terminus, collecting trajectories as we go.
+  std::vector<Trajectory::ConstPtr> segments;
+  Waypoint::ConstPtr waypoint = terminus;
   while (waypoint != nullptr && waypoint->traj_ != nullptr) {
-    traj->Add(waypoint->traj_);
+    segments.push_back(waypoint->traj_);
+    waypoint = waypoint->parent_;
+  }
+
+  // Concatenate them from the start.
+  std::reverse(segments.begin(), segments.end());
+  return Trajectory::Create(segments);
+}
+
+// Get best (fastest) trajectory (if it exists), in polynomial form.
+PolynomialTrajectory::Ptr WaypointTree::BestPolynomialTrajectory() const {
+  const Waypoint::ConstPtr terminus = std::atomic_load(&terminus_);
+  if (terminus == nullptr) {
+    ROS_WARN("Tree did not reach to the terminus.");
+    return nullptr;
+  }
+
+  // Walk back from the terminus, collecting polynomials as we go.
+  std::vector<PolynomialTrajectory::ConstPtr> pieces;
+  Waypoint::ConstPtr waypoint = terminus;
+  while (waypoint != nullptr && waypoint->poly_ != nullptr) {
+    pieces.push_back(waypoint->poly_);
     waypoint = waypoint->parent_;
   }
 
-  return traj;
+  // Concatenate them from the start.
+  std::reverse(pieces.begin(), pieces.end());
+  return PolynomialTrajectory::Create(pieces);
 }
 
 } //\namespace meta
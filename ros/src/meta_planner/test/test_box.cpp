@@ -0,0 +1,167 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Unit tests for the Box environment's swept collision check, which computes
+// the exact distance from a spherical obstacle to a box swept along a segment.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <meta_planner/box.h>
+
+#include <random>
+#include <algorithm>
+#include <cmath>
+#include <gtest/gtest.h>
+
+using namespace meta;
+
+namespace {
+
+const size_t kNumTrials = 2000;
+const size_t kNumSamples = 2000;
+const double kSmallNumber = 1e-9;
+const unsigned int kSeed = 1;
+
+// Exposes the swept distance, which is only used internally by Box.
+struct SweptBox : public Box {
+  static double SquaredDistance(const Vector3d& start, const Vector3d& stop,
+                                const Vector3d& bound,
+                                const Vector3d& point) {
+    return SweptBoxSquaredDistance(start, stop, bound, point);
+  }
+};
+
+// Distance from a point to a box with the given half-widths and center.
+double BoxDistance(const Vector3d& center, const Vector3d& bound,
+                   const Vector3d& point) {
+  const Vector3d gap =
+    ((point - center).cwiseAbs() - bound).cwiseMax(Vector3d::Zero());
+  return gap.norm();
+}
+
+// Distance to the swept box, approximated by densely sampling the segment.
+// Distance to the box is 1-Lipschitz in its center, so this overestimates
+// the true distance by at most half the sample spacing.
+double SampledDistance(const Vector3d& start, const Vector3d& stop,
+                       const Vector3d& bound, const Vector3d& point) {
+  double best = std::numeric_limits<double>::infinity();
+  for (size_t ii = 0; ii <= kNumSamples; ii++) {
+    const double fraction = static_cast<double>(ii) / kNumSamples;
+    best = std::min(best, BoxDistance(start + fraction * (stop - start),
+                                      bound, point));
+  }
+
+  return best;
+}
+
+// Check the swept distance against dense sampling.
+void ExpectMatchesSampling(const Vector3d& start, const Vector3d& stop,
+                           const Vector3d& bound, const Vector3d& point) {
+  const double distance =
+    std::sqrt(SweptBox::SquaredDistance(start, stop, bound, point));
+  const double sampled = SampledDistance(start, stop, bound, point);
+  const double spacing = (stop - start).norm() / kNumSamples;
+
+  EXPECT_LE(distance, sampled + kSmallNumber);
+  EXPECT_GE(distance, sampled - 0.5 * spacing - kSmallNumber);
+}
+
+} //\namespace
+
+// Random segments, box sizes, and sphere centers, including segments with
+// no extent in some or all dimensions.
+TEST(Box, TestSweptDistanceMatchesSampling) {
+  std::default_random_engine rng(kSeed);
+  std::uniform_real_distribution<double> position(-2.0, 2.0);
+  std::uniform_real_distribution<double> width(0.0, 0.7);
+
+  for (size_t ii = 0; ii < kNumTrials; ii++) {
+    const Vector3d start(position(rng), position(rng), position(rng));
+    Vector3d stop(position(rng), position(rng), position(rng));
+    const Vector3d bound(width(rng), width(rng), width(rng));
+    const Vector3d point(position(rng), position(rng), position(rng));
+
+    // Axis-aligned segments.
+    if (ii % 5 == 0)
+      stop(ii % 3) = start(ii % 3);
+    if (ii % 10 == 0)
+      stop((ii + 1) % 3) = start((ii + 1) % 3);
+
+    // Degenerate segments.
+    if (ii % 7 == 0)
+      stop = start;
+
+    ExpectMatchesSampling(start, stop, bound, point);
+  }
+}
+
+// Spheres just touching the swept box along one of its faces, or at the
+// corner of the box at the end of the segment.
+TEST(Box, TestSweptDistanceGrazing) {
+  std::default_random_engine rng(kSeed);
+  std::uniform_real_distribution<double> position(-2.0, 2.0);
+  std::uniform_real_distribution<double> width(0.0, 0.7);
+  std::uniform_real_distribution<double> unit(0.0, 1.0);
+
+  for (size_t ii = 0; ii < kNumTrials; ii++) {
+    const Vector3d bound(width(rng), width(rng), width(rng));
+    const double radius = width(rng);
+
+    // Segment parallel to the top face, with the sphere resting on that face
+    // above some point along the segment.
+    const Vector3d start(position(rng), position(rng), position(rng));
+    Vector3d stop(position(rng), position(rng), start(2));
+    Vector3d point = start + unit(rng) * (stop - start);
+    point(2) += bound(2) + radius;
+
+    EXPECT_NEAR(SweptBox::SquaredDistance(start, stop, bound, point),
+                radius * radius, kSmallNumber);
+    ExpectMatchesSampling(start, stop, bound, point);
+
+    // Segment moving towards the sphere in every dimension, so the box is
+    // closest at the end of the segment, where the sphere touches its corner.
+    const Vector3d direction(unit(rng), unit(rng), unit(rng));
+    stop = start + direction;
+    const Vector3d corner = Vector3d(unit(rng), unit(rng), unit(rng));
+    point = stop + bound + radius * corner.normalized();
+
+    EXPECT_NEAR(SweptBox::SquaredDistance(start, stop, bound, point),
+                radius * radius, kSmallNumber);
+    ExpectMatchesSampling(start, stop, bound, point);
+  }
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Unit tests for the Trajectory class, which shares contiguous segments of
+// waypoints between trajectories.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <meta_planner/trajectory.h>
+
+#include <vector>
+#include <gtest/gtest.h>
+
+using namespace meta;
+
+namespace {
+
+const size_t kStateDimension = 6;
+const double kSmallNumber = 1e-12;
+
+// Trajectory with a waypoint at each of the given times, whose state is
+// offset + time in every dimension, so interpolated states are easy to
+// predict. All waypoints use the given value function.
+Trajectory::Ptr CreateTrajectory(const std::vector<double>& times,
+                                 double offset = 0.0,
+                                 ValueFunctionId value = 0) {
+  std::vector<VectorXd> states;
+  for (const double time : times)
+    states.push_back(VectorXd::Constant(kStateDimension, offset + time));
+
+  const std::vector<ValueFunctionId> values(times.size(), value);
+  return Trajectory::Create(times, states, values, values);
+}
+
+// Check the state at the given time, in every dimension.
+void ExpectState(const Trajectory::ConstPtr& traj, double time,
+                 double expected) {
+  const VectorXd state = traj->GetState(time);
+  ASSERT_EQ(state.size(), kStateDimension);
+  EXPECT_NEAR(state.maxCoeff(), expected, kSmallNumber);
+  EXPECT_NEAR(state.minCoeff(), expected, kSmallNumber);
+}
+
+} //\namespace
+
+// Adding a waypoint at an existing time keeps the existing one.
+TEST(Trajectory, TestDuplicateTimeKeepsExisting) {
+  const Trajectory::Ptr traj = CreateTrajectory({ 0.0, 1.0, 2.0 });
+  traj->Add(1.0, VectorXd::Constant(kStateDimension, 42.0), 7, 7);
+
+  EXPECT_EQ(traj->Size(), 3);
+  ExpectState(traj, 1.0, 1.0);
+  EXPECT_EQ(traj->GetControlValueFunction(1.0), 0);
+
+  // Same when the existing waypoint sits in a shared segment.
+  const Trajectory::Ptr shared =
+    Trajectory::Create(std::vector<Trajectory::ConstPtr>({ traj }));
+  shared->Add(2.0, VectorXd::Constant(kStateDimension, 42.0), 7, 7);
+
+  EXPECT_EQ(shared->Size(), 3);
+  ExpectState(shared, 2.0, 2.0);
+  EXPECT_EQ(shared->LastControlValueFunction(), 0);
+}
+
+// Inserting into the middle of a shared segment must not change the other
+// trajectory sharing it.
+TEST(Trajectory, TestInsertIntoSharedSegment) {
+  const Trajectory::Ptr original =
+    CreateTrajectory({ 0.0, 1.0, 2.0, 3.0 });
+  const Trajectory::Ptr shared = Trajectory::Create(original, 0.5);
+  ASSERT_EQ(shared->Size(), 4);
+
+  shared->Add(1.5, VectorXd::Constant(kStateDimension, 42.0), 7, 7);
+
+  EXPECT_EQ(shared->Size(), 5);
+  ExpectState(shared, 1.5, 42.0);
+  ExpectState(shared, 0.5, 0.5);
+  ExpectState(shared, 2.5, 2.5);
+  EXPECT_EQ(shared->GetControlValueFunction(1.5), 7);
+
+  EXPECT_EQ(original->Size(), 4);
+  ExpectState(original, 1.5, 1.5);
+  EXPECT_EQ(original->GetControlValueFunction(1.5), 0);
+}
+
+// The remainder from an exact waypoint time starts at that waypoint,
+// without duplicating it.
+TEST(Trajectory, TestRemainderAtWaypoint) {
+  const Trajectory::Ptr traj = CreateTrajectory({ 0.0, 1.0, 2.0, 3.0 });
+
+  const Trajectory::Ptr at_waypoint = Trajectory::Create(traj, 1.0);
+  EXPECT_EQ(at_waypoint->Size(), 3);
+  EXPECT_EQ(at_waypoint->FirstTime(), 1.0);
+  EXPECT_EQ(at_waypoint->LastTime(), 3.0);
+  ExpectState(at_waypoint, 1.0, 1.0);
+  ExpectState(at_waypoint, 2.5, 2.5);
+
+  const Trajectory::Ptr between = Trajectory::Create(traj, 1.5);
+  EXPECT_EQ(between->Size(), 3);
+  EXPECT_EQ(between->FirstTime(), 1.5);
+  ExpectState(between, 1.5, 1.5);
+
+  const Trajectory::Ptr at_start = Trajectory::Create(traj, 0.0);
+  EXPECT_EQ(at_start->Size(), 4);
+  ExpectState(at_start, 0.5, 0.5);
+}
+
+// A cursor must agree with GetState after the trajectory is retimed.
+TEST(Trajectory, TestCursorAfterResetStartTime) {
+  std::vector<double> times;
+  for (size_t ii = 0; ii < 10; ii++)
+    times.push_back(static_cast<double>(ii));
+
+  const Trajectory::Ptr traj = CreateTrajectory(times);
+  Trajectory::Cursor cursor(traj);
+
+  VectorXd state;
+  ValueFunctionId control_value, bound_value;
+  cursor.Get(6.5, state, control_value, bound_value);
+  EXPECT_NEAR(state(0), 6.5, kSmallNumber);
+
+  // Shift later, so the cursor's remembered position is now too early.
+  traj->ResetStartTime(10.0);
+  for (double time = 10.25; time < 19.0; time += 0.5) {
+    cursor.Get(time, state, control_value, bound_value);
+    EXPECT_NEAR(state(0), time - 10.0, kSmallNumber);
+    EXPECT_NEAR((state - traj->GetState(time)).norm(), 0.0, kSmallNumber);
+  }
+
+  // Shift earlier, so it is now too late.
+  traj->ResetStartTime(-5.0);
+  for (double time = -4.75; time < 4.0; time += 0.5) {
+    cursor.Get(time, state, control_value, bound_value);
+    EXPECT_NEAR(state(0), time + 5.0, kSmallNumber);
+  }
+}
+
+// Splicing keeps the prefix's waypoints before the splice time and the
+// suffix's from then on, wherever the splice time falls.
+TEST(Trajectory, TestSplice) {
+  const Trajectory::Ptr prefix =
+    CreateTrajectory({ 0.0, 1.0, 2.0, 3.0 }, 0.0, 0);
+  const Trajectory::Ptr suffix =
+    CreateTrajectory({ 1.5, 2.5, 3.5, 4.5 }, 100.0, 1);
+
+  // Before both: all suffix.
+  const Trajectory::Ptr before = Trajectory::Create(prefix, -1.0, suffix);
+  EXPECT_EQ(before->Size(), 4);
+  EXPECT_EQ(before->FirstTime(), 1.5);
+  ExpectState(before, 2.0, 102.0);
+  EXPECT_EQ(before->FirstControlValueFunction(), 1);
+
+  // Inside both, at a prefix waypoint: that waypoint comes from the suffix.
+  const Trajectory::Ptr inside = Trajectory::Create(prefix, 2.0, suffix);
+  EXPECT_EQ(inside->Size(), 5);
+  EXPECT_EQ(inside->FirstTime(), 0.0);
+  EXPECT_EQ(inside->LastTime(), 4.5);
+  ExpectState(inside, 0.5, 0.5);
+  ExpectState(inside, 3.5, 103.5);
+  EXPECT_EQ(inside->GetControlValueFunction(0.5), 0);
+  EXPECT_EQ(inside->GetControlValueFunction(3.0), 1);
+
+  // Inside both, at a suffix waypoint.
+  const Trajectory::Ptr at_suffix = Trajectory::Create(prefix, 2.5, suffix);
+  EXPECT_EQ(at_suffix->Size(), 6);
+  ExpectState(at_suffix, 2.0, 2.0);
+  ExpectState(at_suffix, 2.5, 102.5);
+
+  // After both: all prefix.
+  const Trajectory::Ptr after = Trajectory::Create(prefix, 10.0, suffix);
+  EXPECT_EQ(after->Size(), 4);
+  EXPECT_EQ(after->LastTime(), 3.0);
+  ExpectState(after, 2.5, 2.5);
+
+  // Neither input changes.
+  EXPECT_EQ(prefix->Size(), 4);
+  EXPECT_EQ(suffix->Size(), 4);
+  ExpectState(prefix, 2.5, 2.5);
+  ExpectState(suffix, 2.0, 102.0);
+}
+
+// Patches leave out waypoints the receiver already has.
+TEST(Trajectory, TestPatchCarriesOnlyChanges) {
+  const Trajectory::Ptr previous =
+    CreateTrajectory({ 0.0, 1.0, 2.0, 3.0 }, 0.0, 0);
+
+  // Replanned from the third waypoint on: splice there.
+  const Trajectory::Ptr replanned = Trajectory::Create(
+    std::vector<Trajectory::ConstPtr>{
+      CreateTrajectory({ 0.0, 1.0, 2.0 }, 0.0, 0),
+      CreateTrajectory({ 3.0, 4.0 }, 100.0, 1) });
+
+  const meta_planner_msgs::TrajectoryPatch patch =
+    replanned->ToPatchRosMessage(previous);
+  EXPECT_EQ(patch.splice_time, 2.0);
+  EXPECT_EQ(patch.suffix.num_waypoints, 3);
+  EXPECT_EQ(patch.suffix.times.front(), 2.0);
+
+  // Nothing shared: all of it.
+  const Trajectory::Ptr moved =
+    CreateTrajectory({ 0.0, 1.0, 2.0, 3.0 }, 10.0, 0);
+  const meta_planner_msgs::TrajectoryPatch moved_patch =
+    moved->ToPatchRosMessage(previous);
+  EXPECT_EQ(moved_patch.splice_time, 0.0);
+  EXPECT_EQ(moved_patch.suffix.num_waypoints, 4);
+
+  // No previous trajectory: all of it.
+  EXPECT_EQ(replanned->ToPatchRosMessage(nullptr).suffix.num_waypoints, 5);
+
+  // Nothing changed: just the last waypoint.
+  const meta_planner_msgs::TrajectoryPatch same_patch =
+    previous->ToPatchRosMessage(previous);
+  EXPECT_EQ(same_patch.splice_time, 3.0);
+  EXPECT_EQ(same_patch.suffix.num_waypoints, 1);
+}
+
+// Receivers applying a patch end up following the replanned trajectory.
+TEST(Trajectory, TestApplyPatch) {
+  const Trajectory::Ptr previous =
+    CreateTrajectory({ 0.0, 1.0, 2.0, 3.0 }, 0.0, 0);
+  const Trajectory::Ptr replanned = Trajectory::Create(
+    std::vector<Trajectory::ConstPtr>{
+      CreateTrajectory({ 0.0, 1.0, 2.0 }, 0.0, 0),
+      CreateTrajectory({ 3.0, 4.0 }, 100.0, 1) });
+
+  const meta_planner_msgs::TrajectoryPatch::ConstPtr patch =
+    std::make_shared<meta_planner_msgs::TrajectoryPatch>(
+      replanned->ToPatchRosMessage(previous));
+
+  // Following the previous trajectory: matches the replanned one from now.
+  const Trajectory::Ptr patched = Trajectory::Create(previous, patch, 0.5);
+  EXPECT_EQ(patched->FirstTime(), 0.5);
+  EXPECT_EQ(patched->LastTime(), 4.0);
+  for (double time = 0.5; time <= 4.0; time += 0.25) {
+    ExpectState(patched, time, replanned->GetState(time)(0));
+    EXPECT_EQ(patched->GetControlValueFunction(time),
+              replanned->GetControlValueFunction(time));
+  }
+
+  // Received after the splice time: nothing before the splice is dropped.
+  const Trajectory::Ptr late = Trajectory::Create(previous, patch, 2.5);
+  EXPECT_EQ(late->FirstTime(), 2.0);
+  ExpectState(late, 3.0, 103.0);
+
+  // Following something else: kept up to the splice time.
+  const Trajectory::Ptr other =
+    CreateTrajectory({ 0.0, 1.0, 2.0, 3.0 }, 50.0, 2);
+  const Trajectory::Ptr spliced = Trajectory::Create(other, patch, 0.0);
+  ExpectState(spliced, 1.0, 51.0);
+  ExpectState(spliced, 3.0, 103.0);
+  EXPECT_EQ(spliced->GetControlValueFunction(1.0), 2);
+
+  // Following nothing: just the suffix.
+  const Trajectory::Ptr fresh = Trajectory::Create(nullptr, patch, 0.0);
+  EXPECT_EQ(fresh->Size(), 3);
+  EXPECT_EQ(fresh->FirstTime(), 2.0);
+
+  // Empty patches come out empty, so receivers can ignore them.
+  const meta_planner_msgs::TrajectoryPatch::ConstPtr empty =
+    std::make_shared<meta_planner_msgs::TrajectoryPatch>();
+  EXPECT_TRUE(Trajectory::Create(previous, empty, 0.0)->IsEmpty());
+}
@@ -41,17 +41,18 @@ class NeuralValueServer(object):
             rospy.logerr("%s: Error loading parameters.", self._name)
             return False
 
-        # Register callbacks.
-        if not self.RegisterCallbacks():
-            rospy.logerr("%s: Error registering callbacks.", self._name)
-            return False
-
         sess = tf.Session();
         ids = range(len(self._network_files + self._network_files))
 
         self.policies = [ NeuralPolicy(f, i, sess=sess, ppick=15, pick_=15) for f, i in
                           zip(self._network_files + self._network_files, ids) ]
 
+        # Register callbacks. Clients cache every table as soon as the
+        # services come up, so all policies must be loaded first.
+        if not self.RegisterCallbacks():
+            rospy.logerr("%s: Error registering callbacks.", self._name)
+            return False
+
         self._initialized = True
         return True
 
@@ -85,12 +86,30 @@ class NeuralValueServer(object):
         if not rospy.has_param("~srv/priority"):
             return False
         self._priority_name = rospy.get_param("~srv/priority")
+        if not rospy.has_param("~srv/optimal_control_and_priority"):
+            return False
+        self._optimal_control_and_priority_name = rospy.get_param("~srv/optimal_control_and_priority")
         if not rospy.has_param("~srv/max_planner_speed"):
             return False
         self._max_planner_speed_name = rospy.get_param("~srv/max_planner_speed")
         if not rospy.has_param("~srv/best_possible_time"):
             return False
         self._best_possible_time_name = rospy.get_param("~srv/best_possible_time")
+        if not rospy.has_param("~srv/num_values"):
+            return False
+        self._num_values_name = rospy.get_param("~srv/num_values")
+        if not rospy.has_param("~srv/optimal_control_batch"):
+            return False
+        self._optimal_control_batch_name = rospy.get_param("~srv/optimal_control_batch")
+        if not rospy.has_param("~srv/priority_batch"):
+            return False
+        self._priority_batch_name = rospy.get_param("~srv/priority_batch")
+        if not rospy.has_param("~srv/best_possible_time_batch"):
+            return False
+        self._best_possible_time_batch_name = rospy.get_param("~srv/best_possible_time_batch")
+        if not rospy.has_param("~srv/switching_tracking_bound_batch"):
+            return False
+        self._switching_tracking_bound_batch_name = rospy.get_param("~srv/switching_tracking_bound_batch")
 
         return True
 
@@ -102,8 +121,14 @@ class NeuralValueServer(object):
         self._guaranteed_switching_time_srv     = rospy.Service(self._guaranteed_switching_time_name, value_function_srvs.srv.GuaranteedSwitchingTime, self.GuaranteedSwitchingTimeCallback)
         self._guaranteed_switching_distance_srv = rospy.Service(self._guaranteed_switching_distance_name, value_function_srvs.srv.GuaranteedSwitchingDistance, self.GuaranteedSwitchingDistanceCallback)
         self._priority_srv                      = rospy.Service(self._priority_name, value_function_srvs.srv.Priority, self.PriorityCallback)
+        self._optimal_control_and_priority_srv  = rospy.Service(self._optimal_control_and_priority_name, value_function_srvs.srv.OptimalControlAndPriority, self.OptimalControlAndPriorityCallback)
         self._max_planner_speed_srv             = rospy.Service(self._max_planner_speed_name, value_function_srvs.srv.GeometricPlannerSpeed, self.MaxPlannerSpeedCallback)
         self._best_possible_time_srv            = rospy.Service(self._best_possible_time_name, value_function_srvs.srv.GeometricPlannerTime, self.BestPossibleTimeCallback)
+        self._num_values_srv                    = rospy.Service(self._num_values_name, value_function_srvs.srv.NumValueFunctions, self.NumValueFunctionsCallback)
+        self._optimal_control_batch_srv          = rospy.Service(self._optimal_control_batch_name, value_function_srvs.srv.OptimalControlBatch, self.OptimalControlBatchCallback)
+        self._priority_batch_srv                 = rospy.Service(self._priority_batch_name, value_function_srvs.srv.PriorityBatch, self.PriorityBatchCallback)
+        self._best_possible_time_batch_srv       = rospy.Service(self._best_possible_time_batch_name, value_function_srvs.srv.GeometricPlannerTimeBatch, self.BestPossibleTimeBatchCallback)
+        self._switching_tracking_bound_batch_srv = rospy.Service(self._switching_tracking_bound_batch_name, value_function_srvs.srv.SwitchingTrackingBoundBoxBatch, self.SwitchingTrackingBoundBatchCallback)
 
         return True
 
@@ -157,6 +182,14 @@ class NeuralValueServer(object):
         res.priority = 0.99
         return res
 
+    def OptimalControlAndPriorityCallback(self,req):
+        policy = self.policies[req.id]
+        control = policy.OptimalControl(Utils.UnpackState(req.state))
+        res = value_function_srvs.srv.OptimalControlAndPriorityResponse()
+        res.control = Utils.PackControl(control)
+        res.priority = 0.99
+        return res
+
     def MaxPlannerSpeedCallback(self,req):
         policy = self.policies[req.id]
         max_speed = policy.max_speed
@@ -178,3 +211,50 @@ class NeuralValueServer(object):
         res = value_function_srvs.srv.GeometricPlannerTimeResponse()
         res.time = max(t1,t2,t3)
         return res
+
+    def NumValueFunctionsCallback(self,req):
+        res = value_function_srvs.srv.NumValueFunctionsResponse()
+        res.num_values = len(self.policies)
+        return res
+
+    # Batched callbacks. States, points, and bounds are packed into flat
+    # arrays, one after another. States sharing a policy are evaluated in a
+    # single network pass.
+    def OptimalControlBatchCallback(self,req):
+        ids = np.array(req.ids, dtype=int)
+        states = np.array(req.states).reshape((len(ids), req.state_dim))
+        res = value_function_srvs.srv.OptimalControlBatchResponse()
+        if len(ids) == 0:
+            return res
+
+        controls = None
+        for id in np.unique(ids):
+            rows = np.where(ids == id)[0]
+            control = self.policies[id].OptimalControl(states[rows, :])
+            if controls is None:
+                controls = np.zeros((len(ids), control.shape[1]))
+            controls[rows, :] = control
+
+        res.control_dim = controls.shape[1]
+        res.controls = list(controls.flatten())
+        return res
+
+    def PriorityBatchCallback(self,req):
+        res = value_function_srvs.srv.PriorityBatchResponse()
+        res.priorities = [0.99] * len(req.ids)
+        return res
+
+    def BestPossibleTimeBatchCallback(self,req):
+        starts = np.array(req.starts).reshape((len(req.ids), 3))
+        stops = np.array(req.stops).reshape((len(req.ids), 3))
+        max_speeds = np.array([self.policies[id].max_speed[0:3] for id in req.ids]).reshape((len(req.ids), 3))
+        res = value_function_srvs.srv.GeometricPlannerTimeBatchResponse()
+        res.times = list((np.abs(stops - starts) / max_speeds).max(axis=1))
+        return res
+
+    def SwitchingTrackingBoundBatchCallback(self,req):
+        # NOTE: we are not really doing switching (for now).
+        res = value_function_srvs.srv.SwitchingTrackingBoundBoxBatchResponse()
+        res.bounds = [ float(self.policies[id].tracking_error_bound[ii])
+                       for id in req.to_ids for ii in range(3) ]
+        return res
@@ -69,38 +69,28 @@ inline geometry_msgs::Vector3 Pack(const Vector3d& point) {
 
 // Unpack a State message into a VectorXd.
 inline VectorXd Unpack(const meta_planner_msgs::State& msg) {
-  VectorXd state(msg.dimension);
-  for (size_t ii = 0; ii < state.size(); ii++)
-    state(ii) = msg.state[ii];
-
-  return state;
+  return Eigen::Map<const VectorXd>(msg.state.data(), msg.dimension);
 }
 
 // Pack a VectorXd into a State message.
 inline meta_planner_msgs::State PackState(const VectorXd& state) {
   meta_planner_msgs::State msg;
   msg.dimension = state.size();
-  for (size_t ii = 0; ii < state.size(); ii++)
-    msg.state.push_back(state(ii));
+  msg.state.assign(state.data(), state.data() + state.size());
 
   return msg;
 }
 
 // Unpack a Control message into a VectorXd.
 inline VectorXd Unpack(const meta_planner_msgs::Control& msg) {
-  VectorXd control(msg.dimension);
-  for (size_t ii = 0; ii < control.size(); ii++)
-    control(ii) = msg.control[ii];
-
-  return control;
+  return Eigen::Map<const VectorXd>(msg.control.data(), msg.dimension);
 }
 
 // Pack a VectorXd into a Control message.
 inline meta_planner_msgs::Control PackControl(const VectorXd& control) {
   meta_planner_msgs::Control msg;
   msg.dimension = control.size();
-  for (size_t ii = 0; ii < control.size(); ii++)
-    msg.control.push_back(control(ii));
+  msg.control.assign(control.data(), control.data() + control.size());
 
   return msg;
 }
@@ -0,0 +1,233 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the ValueFunctionClient class. Every quantity which depends only on
+// value function IDs (tracking bounds, pairwise switching bounds/times/
+// distances, and max planner speeds) is fetched from the value function
+// server once at startup and stored in flat arrays, so queries never leave
+// this process. If the server restarts, the cache is invalidated and
+// refetched. Refetched tables are built off to the side and swapped in
+// atomically, so queries are safe from any thread.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef UTILS_VALUE_FUNCTION_CLIENT_H
+#define UTILS_VALUE_FUNCTION_CLIENT_H
+
+#include <utils/types.h>
+#include <utils/uncopyable.h>
+
+#include <value_function_srvs/NumValueFunctions.h>
+#include <value_function_srvs/TrackingBoundBox.h>
+#include <value_function_srvs/SwitchingTrackingBoundBox.h>
+#include <value_function_srvs/GuaranteedSwitchingTime.h>
+#include <value_function_srvs/GuaranteedSwitchingDistance.h>
+#include <value_function_srvs/GeometricPlannerSpeed.h>
+
+#include <ros/ros.h>
+#include <memory>
+#include <vector>
+#include <string>
+
+namespace meta {
+
+class ValueFunctionClient : private Uncopyable {
+public:
+  typedef std::shared_ptr<ValueFunctionClient> Ptr;
+  typedef std::shared_ptr<const ValueFunctionClient> ConstPtr;
+
+  // Destructor.
+  ~ValueFunctionClient() {}
+
+  // Factory method. Use this instead of the constructor.
+  static Ptr Create();
+
+  // Initialize this class from a ROS node. Blocks until the server is up
+  // and all tables have been fetched.
+  bool Initialize(const ros::NodeHandle& n);
+
+  // Get the tracking error bound in each spatial dimension.
+  inline bool TrackingBound(ValueFunctionId id, Vector3d& bound) const {
+    return Lookup(&Tables::tracking_bounds_, id, bound);
+  }
+
+  // Get the tracking error bound in each spatial dimension for a planner
+  // switching from one value function INTO another.
+  inline bool SwitchingTrackingBound(ValueFunctionId from_id,
+                                     ValueFunctionId to_id,
+                                     Vector3d& bound) const {
+    return Lookup(&Tables::switching_bounds_, from_id, to_id, bound);
+  }
+
+  // Guaranteed time in which a planner with the 'from' value function
+  // can switch into the 'to' value function's tracking error bound.
+  inline bool GuaranteedSwitchingTime(ValueFunctionId from_id,
+                                      ValueFunctionId to_id,
+                                      Vector3d& time) const {
+    return Lookup(&Tables::switching_times_, from_id, to_id, time);
+  }
+
+  // Guaranteed distance in which a planner with the 'from' value function
+  // can switch into the 'to' value function's safe set.
+  inline bool GuaranteedSwitchingDistance(ValueFunctionId from_id,
+                                          ValueFunctionId to_id,
+                                          Vector3d& distance) const {
+    return Lookup(&Tables::switching_distances_, from_id, to_id, distance);
+  }
+
+  // Max planner speed in each spatial dimension.
+  inline bool MaxPlannerSpeed(ValueFunctionId id, Vector3d& speed) const {
+    return Lookup(&Tables::max_planner_speeds_, id, speed);
+  }
+
+  // Compute the shortest possible time to go from start to stop for a
+  // geometric planner with the max planner speed for this value function.
+  // Computed locally from the cached max planner speeds.
+  inline bool BestPossibleTime(ValueFunctionId id,
+                               const Vector3d& start, const Vector3d& stop,
+                               double& time) const {
+    Vector3d inv_speed;
+    if (!Lookup(&Tables::inv_max_planner_speeds_, id, inv_speed))
+      return false;
+
+    time = (stop - start).cwiseAbs().cwiseProduct(inv_speed).maxCoeff();
+    return true;
+  }
+
+  // Number of value functions on the server, and whether the cache is valid.
+  inline size_t NumValueFunctions() const {
+    const std::shared_ptr<const Tables> tables = Current();
+    return (tables) ? tables->num_values_ : 0;
+  }
+
+  inline bool IsValid() const { return Current() != nullptr; }
+
+private:
+  explicit ValueFunctionClient();
+
+  // Everything fetched from the server. Per-value tables hold 3 entries per
+  // ID, and pairwise tables hold 3 entries per (from_id, to_id), indexed by
+  // from_id * N + to_id. Never modified once published.
+  struct Tables {
+    size_t num_values_;
+    std::vector<double> tracking_bounds_;
+    std::vector<double> switching_bounds_;
+    std::vector<double> switching_times_;
+    std::vector<double> switching_distances_;
+    std::vector<double> max_planner_speeds_;
+    std::vector<double> inv_max_planner_speeds_;
+  };
+
+  typedef std::vector<double> Tables::*Table;
+
+  // Load parameters and register callbacks.
+  bool LoadParameters(const ros::NodeHandle& n);
+  bool RegisterCallbacks(const ros::NodeHandle& n);
+
+  // Timer callback which watches the server connection, and invalidates
+  // and refetches the cache if the server has gone away.
+  void TimerCallback(const ros::TimerEvent& e);
+
+  // Fetch all tables from the server. Returns true on success.
+  bool FetchTables();
+
+  // Current tables, or null if the cache is invalid.
+  inline std::shared_ptr<const Tables> Current() const {
+    return std::atomic_load(&tables_);
+  }
+
+  // Look up an entry in a per-value or a pairwise table. Each query reads
+  // one snapshot of the tables, even if they are refetched meanwhile.
+  inline bool Lookup(Table table, ValueFunctionId id, Vector3d& entry) const {
+    return Entry(Current(), table, id, entry);
+  }
+
+  inline bool Lookup(Table table,
+                     ValueFunctionId from_id, ValueFunctionId to_id,
+                     Vector3d& entry) const {
+    const std::shared_ptr<const Tables> tables = Current();
+    const size_t num_values = (tables) ? tables->num_values_ : 0;
+    if (tables && (from_id >= num_values || to_id >= num_values)) {
+      ROS_ERROR_THROTTLE(1.0, "%s: Invalid value function IDs %zu, %zu.",
+                         name_.c_str(), from_id, to_id);
+      return false;
+    }
+
+    return Entry(tables, table, from_id * num_values + to_id, entry);
+  }
+
+  inline bool Entry(const std::shared_ptr<const Tables>& tables, Table table,
+                    size_t index, Vector3d& entry) const {
+    if (!tables || 3 * index + 2 >= ((*tables).*table).size()) {
+      ROS_ERROR_THROTTLE(1.0, "%s: No cached value for index %zu.",
+                         name_.c_str(), index);
+      return false;
+    }
+
+    entry = Eigen::Map<const Vector3d>(((*tables).*table).data() + 3 * index);
+    return true;
+  }
+
+  // Current tables, or null if the cache is invalid. The timer swaps these
+  // out on the spinner thread while others read them, so always go through
+  // std::atomic_load and std::atomic_store.
+  std::shared_ptr<const Tables> tables_;
+
+  // Persistent connection used to detect server restarts.
+  ros::ServiceClient num_values_srv_;
+
+  // Service names. Tables whose service name is not set are not fetched.
+  std::string num_values_name_;
+  std::string tracking_bound_name_;
+  std::string switching_bound_name_;
+  std::string switching_time_name_;
+  std::string switching_distance_name_;
+  std::string max_planner_speed_name_;
+
+  // Timer for checking the server connection.
+  ros::Timer timer_;
+  double time_step_;
+
+  // Initialization and naming.
+  bool initialized_;
+  std::string name_;
+};
+
+} //\namespace meta
+
+#endif
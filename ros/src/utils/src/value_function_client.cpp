@@ -0,0 +1,268 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the ValueFunctionClient class. Every quantity which depends only on
+// value function IDs is fetched from the value function server once at
+// startup and stored in flat arrays.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <utils/value_function_client.h>
+
+namespace meta {
+
+// Factory method. Use this instead of the constructor.
+ValueFunctionClient::Ptr ValueFunctionClient::Create() {
+  ValueFunctionClient::Ptr ptr(new ValueFunctionClient());
+  return ptr;
+}
+
+// Constructor. Don't use this. Use the factory method instead.
+ValueFunctionClient::ValueFunctionClient()
+  : initialized_(false) {}
+
+// Initialize this class from a ROS node.
+bool ValueFunctionClient::Initialize(const ros::NodeHandle& n) {
+  name_ = ros::names::append(n.getNamespace(), "value_function_client");
+
+  if (!LoadParameters(n)) {
+    ROS_ERROR("%s: Failed to load parameters.", name_.c_str());
+    return false;
+  }
+
+  if (!RegisterCallbacks(n)) {
+    ROS_ERROR("%s: Failed to register callbacks.", name_.c_str());
+    return false;
+  }
+
+  if (!FetchTables()) {
+    ROS_ERROR("%s: Failed to fetch value function tables.", name_.c_str());
+    return false;
+  }
+
+  initialized_ = true;
+  return true;
+}
+
+// Load parameters. Only the number of values service is required; each
+// table is fetched only if its service is named.
+bool ValueFunctionClient::LoadParameters(const ros::NodeHandle& n) {
+  ros::NodeHandle nl(n);
+
+  if (!nl.getParam("srv/num_values", num_values_name_)) return false;
+
+  nl.param<std::string>("srv/tracking_bound", tracking_bound_name_, "");
+  nl.param<std::string>("srv/switching_bound", switching_bound_name_, "");
+  nl.param<std::string>("srv/switching_time", switching_time_name_, "");
+  nl.param<std::string>("srv/switching_distance", switching_distance_name_, "");
+  nl.param<std::string>("srv/max_planner_speed", max_planner_speed_name_, "");
+
+  nl.param("value_function/cache_check_time_step", time_step_, 1.0);
+
+  return true;
+}
+
+// Register all callbacks and publishers.
+bool ValueFunctionClient::RegisterCallbacks(const ros::NodeHandle& n) {
+  ros::NodeHandle nl(n);
+
+  ros::service::waitForService(num_values_name_.c_str());
+
+  const std::vector<std::string> table_names = {
+    tracking_bound_name_, switching_bound_name_, switching_time_name_,
+    switching_distance_name_, max_planner_speed_name_ };
+
+  for (const auto& table_name : table_names) {
+    if (!table_name.empty())
+      ros::service::waitForService(table_name.c_str());
+  }
+
+  num_values_srv_ = nl.serviceClient<value_function_srvs::NumValueFunctions>(
+    num_values_name_.c_str(), true);
+
+  timer_ = nl.createTimer(ros::Duration(time_step_),
+                          &ValueFunctionClient::TimerCallback, this);
+
+  return true;
+}
+
+// Timer callback. A persistent connection drops when the server goes away,
+// so an invalid client means the server restarted and the cache is stale.
+void ValueFunctionClient::TimerCallback(const ros::TimerEvent& e) {
+  if (num_values_srv_ && IsValid())
+    return;
+
+  if (IsValid()) {
+    ROS_WARN("%s: Server %s disconnected. Invalidating cache.",
+             name_.c_str(), num_values_name_.c_str());
+    std::atomic_store(&tables_, std::shared_ptr<const Tables>());
+  }
+
+  if (!ros::service::exists(num_values_name_, false))
+    return;
+
+  ros::NodeHandle nl;
+  num_values_srv_ = nl.serviceClient<value_function_srvs::NumValueFunctions>(
+    num_values_name_.c_str(), true);
+
+  if (FetchTables())
+    ROS_INFO("%s: Refetched value function tables.", name_.c_str());
+}
+
+// Fetch all tables from the server. Returns true on success. The new
+// tables only replace the current ones once they are complete.
+bool ValueFunctionClient::FetchTables() {
+  const std::shared_ptr<Tables> tables(new Tables);
+
+  value_function_srvs::NumValueFunctions num;
+  if (!num_values_srv_.call(num)) {
+    ROS_ERROR("%s: Error calling number of values server.", name_.c_str());
+    return false;
+  }
+
+  const size_t num_values = num.response.num_values;
+  const size_t kNumPairs = num_values * num_values;
+  tables->num_values_ = num_values;
+
+  // Per-value tables.
+  if (!tracking_bound_name_.empty()) {
+    tables->tracking_bounds_.resize(3 * num_values);
+
+    for (size_t ii = 0; ii < num_values; ii++) {
+      value_function_srvs::TrackingBoundBox b;
+      b.request.id = ii;
+
+      if (!ros::service::call(tracking_bound_name_, b)) {
+        ROS_ERROR("%s: Error calling tracking bound server.", name_.c_str());
+        return false;
+      }
+
+      tables->tracking_bounds_[3 * ii] = b.response.x;
+      tables->tracking_bounds_[3 * ii + 1] = b.response.y;
+      tables->tracking_bounds_[3 * ii + 2] = b.response.z;
+    }
+  }
+
+  if (!max_planner_speed_name_.empty()) {
+    tables->max_planner_speeds_.resize(3 * num_values);
+    tables->inv_max_planner_speeds_.resize(3 * num_values);
+
+    for (size_t ii = 0; ii < num_values; ii++) {
+      value_function_srvs::GeometricPlannerSpeed s;
+      s.request.id = ii;
+
+      if (!ros::service::call(max_planner_speed_name_, s)) {
+        ROS_ERROR("%s: Error calling max planner speed server.",
+                  name_.c_str());
+        return false;
+      }
+
+      tables->max_planner_speeds_[3 * ii] = s.response.x;
+      tables->max_planner_speeds_[3 * ii + 1] = s.response.y;
+      tables->max_planner_speeds_[3 * ii + 2] = s.response.z;
+    }
+
+    for (size_t ii = 0; ii < tables->max_planner_speeds_.size(); ii++)
+      tables->inv_max_planner_speeds_[ii] =
+        1.0 / tables->max_planner_speeds_[ii];
+  }
+
+  // Pairwise tables.
+  if (!switching_bound_name_.empty()) {
+    tables->switching_bounds_.resize(3 * kNumPairs);
+
+    for (size_t ii = 0; ii < kNumPairs; ii++) {
+      value_function_srvs::SwitchingTrackingBoundBox b;
+      b.request.from_id = ii / num_values;
+      b.request.to_id = ii % num_values;
+
+      if (!ros::service::call(switching_bound_name_, b)) {
+        ROS_ERROR("%s: Error calling switching bound server.", name_.c_str());
+        return false;
+      }
+
+      tables->switching_bounds_[3 * ii] = b.response.x;
+      tables->switching_bounds_[3 * ii + 1] = b.response.y;
+      tables->switching_bounds_[3 * ii + 2] = b.response.z;
+    }
+  }
+
+  if (!switching_time_name_.empty()) {
+    tables->switching_times_.resize(3 * kNumPairs);
+
+    for (size_t ii = 0; ii < kNumPairs; ii++) {
+      value_function_srvs::GuaranteedSwitchingTime t;
+      t.request.from_id = ii / num_values;
+      t.request.to_id = ii % num_values;
+
+      if (!ros::service::call(switching_time_name_, t)) {
+        ROS_ERROR("%s: Error calling switching time server.", name_.c_str());
+        return false;
+      }
+
+      tables->switching_times_[3 * ii] = t.response.x;
+      tables->switching_times_[3 * ii + 1] = t.response.y;
+      tables->switching_times_[3 * ii + 2] = t.response.z;
+    }
+  }
+
+  if (!switching_distance_name_.empty()) {
+    tables->switching_distances_.resize(3 * kNumPairs);
+
+    for (size_t ii = 0; ii < kNumPairs; ii++) {
+      value_function_srvs::GuaranteedSwitchingDistance d;
+      d.request.from_id = ii / num_values;
+      d.request.to_id = ii % num_values;
+
+      if (!ros::service::call(switching_distance_name_, d)) {
+        ROS_ERROR("%s: Error calling switching distance server.",
+                  name_.c_str());
+        return false;
+      }
+
+      tables->switching_distances_[3 * ii] = d.response.x;
+      tables->switching_distances_[3 * ii + 1] = d.response.y;
+      tables->switching_distances_[3 * ii + 2] = d.response.z;
+    }
+  }
+
+  std::atomic_store(&tables_, std::shared_ptr<const Tables>(tables));
+  return true;
+}
+
+} //\namespace meta
@@ -0,0 +1,148 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+///////////////////////////////////////////////////////////////////////////////
+//
+// Converts precomputed subsystem value functions from MATLAB .mat files to
+// the binary .grid format, which is memory-mapped at load time. Each
+// subsystem_*.mat file gets a .grid file with the same name next to it, and
+// the .grid file is read back and checked against the original.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <value_function/subsystem_value_function.h>
+
+#include <ros/ros.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <random>
+
+namespace fs = boost::filesystem;
+
+namespace {
+
+// Check that two subsystems agree at random states inside the grid.
+bool Agree(const meta::SubsystemValueFunction::ConstPtr& original,
+           const meta::SubsystemValueFunction::ConstPtr& converted) {
+  const std::vector<size_t>& dims = original->StateDimensions();
+  if (dims != converted->StateDimensions() ||
+      original->ControlDimensions() != converted->ControlDimensions())
+    return false;
+
+  const size_t x_dim = 1 + *std::max_element(dims.begin(), dims.end());
+
+  std::default_random_engine rng(0);
+  for (size_t kk = 0; kk < 1000; kk++) {
+    meta::VectorXd state = meta::VectorXd::Zero(x_dim);
+    for (size_t ii = 0; ii < dims.size(); ii++) {
+      std::uniform_real_distribution<double> unif(
+        original->LowerBound(ii), original->UpperBound(ii));
+      state(dims[ii]) = unif(rng);
+    }
+
+    if (original->Value(state) != converted->Value(state) ||
+        original->Gradient(state) != converted->Gradient(state))
+      return false;
+  }
+
+  return true;
+}
+
+} //\namespace
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "convert_value_grids");
+  ros::NodeHandle n("~");
+
+  // Convert every precomputation directory unless told otherwise.
+  std::vector<std::string> directories;
+  if (!n.getParam("directories", directories)) {
+    const fs::path path(PRECOMPUTATION_DIR);
+    for (auto iter = fs::directory_iterator(path);
+         iter != fs::directory_iterator();
+         iter++) {
+      if (fs::is_directory(*iter))
+        directories.push_back(iter->path().filename().string());
+    }
+  }
+
+  size_t num_converted = 0, num_failed = 0;
+  for (const auto& directory : directories) {
+    const fs::path path(PRECOMPUTATION_DIR + directory);
+    if (!fs::is_directory(path)) {
+      ROS_ERROR("%s: Not a directory: %s.",
+                ros::this_node::getName().c_str(), path.string().c_str());
+      num_failed++;
+      continue;
+    }
+
+    for (auto iter = fs::directory_iterator(path);
+         iter != fs::directory_iterator();
+         iter++) {
+      const fs::path& mat_file = iter->path();
+      if (!fs::is_regular_file(*iter) || mat_file.extension() != ".mat" ||
+          mat_file.filename().string().compare(0, 10, "subsystem_") != 0)
+        continue;
+
+      const std::string grid_file =
+        fs::path(mat_file).replace_extension(".grid").string();
+
+      const auto original =
+        meta::SubsystemValueFunction::Create(mat_file.string());
+      if (!original->IsInitialized() || !original->Save(grid_file)) {
+        ROS_ERROR("Could not convert %s.", mat_file.string().c_str());
+        num_failed++;
+        continue;
+      }
+
+      const auto converted = meta::SubsystemValueFunction::Create(grid_file);
+      if (!converted->IsInitialized() || !Agree(original, converted)) {
+        ROS_ERROR("Converted %s does not match the original.",
+                  grid_file.c_str());
+        fs::remove(grid_file);
+        num_failed++;
+        continue;
+      }
+
+      ROS_INFO("Wrote %s.", grid_file.c_str());
+      num_converted++;
+    }
+  }
+
+  ROS_INFO("%s: Converted %zu files (%zu failed).",
+           ros::this_node::getName().c_str(), num_converted, num_failed);
+
+  return (num_failed == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
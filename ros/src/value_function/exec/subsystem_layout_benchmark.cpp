@@ -0,0 +1,138 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Benchmarks SubsystemValueFunction interpolation with the separate and the
+// interleaved storage layouts. Loads every subsystem in the given
+// precomputation directory in both layouts, and times Value and Gradient
+// queries at the same random states inside each grid.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <value_function/subsystem_value_function.h>
+
+#include <ros/ros.h>
+#include <boost/filesystem.hpp>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace fs = boost::filesystem;
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "subsystem_layout_benchmark");
+  ros::NodeHandle n("~");
+
+  std::string directory;
+  int num_queries, seed;
+  n.param<std::string>("directory", directory, "speed_10_tenths");
+  n.param("num_queries", num_queries, 1000000);
+  n.param("random/seed", seed, 0);
+
+  const fs::path path(PRECOMPUTATION_DIR + directory);
+  if (!fs::is_directory(path)) {
+    ROS_ERROR("%s: Not a directory: %s.",
+              ros::this_node::getName().c_str(), path.string().c_str());
+    return EXIT_FAILURE;
+  }
+
+  std::default_random_engine rng(seed);
+
+  for (auto iter = fs::directory_iterator(path);
+       iter != fs::directory_iterator();
+       iter++) {
+    if (!fs::is_regular_file(*iter) || iter->path().extension() != ".mat")
+      continue;
+
+    const std::string file_name = iter->path().string();
+    const auto separate =
+      meta::SubsystemValueFunction::Create(file_name, false);
+    const auto interleaved =
+      meta::SubsystemValueFunction::Create(file_name, true);
+
+    if (!separate->IsInitialized() || !interleaved->IsInitialized()) {
+      ROS_ERROR("Could not load %s.", file_name.c_str());
+      continue;
+    }
+
+    // Draw random full states inside this subsystem's grid.
+    const std::vector<size_t>& dims = separate->StateDimensions();
+    const size_t x_dim = 1 + *std::max_element(dims.begin(), dims.end());
+
+    std::vector<meta::VectorXd> states(num_queries, meta::VectorXd::Zero(x_dim));
+    for (size_t ii = 0; ii < dims.size(); ii++) {
+      std::uniform_real_distribution<double> unif(
+        separate->LowerBound(ii), separate->UpperBound(ii));
+
+      for (auto& state : states)
+        state(dims[ii]) = unif(rng);
+    }
+
+    // Time value and gradient queries, and accumulate a checksum so that
+    // the compiler cannot skip any work.
+    const auto time_queries =
+      [&states, x_dim](const meta::SubsystemValueFunction::ConstPtr& value,
+                       double& checksum) {
+      meta::VectorXd gradient = meta::VectorXd::Zero(x_dim);
+      checksum = 0.0;
+
+      const auto start = std::chrono::steady_clock::now();
+      for (const auto& state : states) {
+        checksum += value->Value(state);
+        value->Gradient(state, gradient);
+        checksum += gradient.sum();
+      }
+
+      const std::chrono::duration<double, std::nano> elapsed =
+        std::chrono::steady_clock::now() - start;
+      return elapsed.count() / static_cast<double>(states.size());
+    };
+
+    double separate_checksum, interleaved_checksum;
+    const double separate_ns = time_queries(separate, separate_checksum);
+    const double interleaved_ns =
+      time_queries(interleaved, interleaved_checksum);
+
+    ROS_INFO("%s (%zuD): separate %.1f ns/query, interleaved %.1f ns/query "
+             "(%.2fx), checksum difference %g.",
+             iter->path().filename().string().c_str(), dims.size(),
+             separate_ns, interleaved_ns, separate_ns / interleaved_ns,
+             std::abs(separate_checksum - interleaved_checksum));
+  }
+
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+///////////////////////////////////////////////////////////////////////////////
+//
+// Benchmarks batch evaluation of value, gradient and optimal control against
+// one-state-at-a-time queries, for a numerical value function loaded from the
+// given precomputation directory and for an analytical point mass value
+// function. Reports throughput in states per second, and the largest
+// difference between the batch and single-state results.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <value_function/value_function.h>
+#include <value_function/analytical_point_mass_value_function.h>
+#include <value_function/near_hover_quad_no_yaw.h>
+
+#include <ros/ros.h>
+#include <algorithm>
+#include <chrono>
+#include <random>
+
+namespace {
+
+// Time single-state and batch queries on the same structure-of-arrays block.
+void Benchmark(const std::string& name,
+               const meta::ValueFunction::ConstPtr& value,
+               const std::vector<double>& states,
+               size_t x_dim, size_t u_dim, size_t num_states) {
+  typedef std::chrono::steady_clock Clock;
+  const auto seconds = [](const Clock::time_point& start) {
+    return std::chrono::duration<double>(Clock::now() - start).count();
+  };
+
+  // One state at a time.
+  std::vector<double> values(num_states);
+  std::vector<double> gradients(x_dim * num_states);
+  std::vector<double> controls(u_dim * num_states);
+  meta::VectorXd state(x_dim);
+
+  auto start = Clock::now();
+  for (size_t kk = 0; kk < num_states; kk++) {
+    for (size_t ii = 0; ii < x_dim; ii++)
+      state(ii) = states[ii * num_states + kk];
+
+    values[kk] = value->Value(state);
+
+    const meta::VectorXd gradient = value->Gradient(state);
+    for (size_t ii = 0; ii < x_dim; ii++)
+      gradients[ii * num_states + kk] = gradient(ii);
+
+    const meta::VectorXd control = value->OptimalControl(state);
+    for (size_t ii = 0; ii < u_dim; ii++)
+      controls[ii * num_states + kk] = control(ii);
+  }
+  const double single_time = seconds(start);
+
+  // Batch.
+  std::vector<double> batch_values(num_states);
+  std::vector<double> batch_gradients(x_dim * num_states);
+  std::vector<double> batch_controls(u_dim * num_states);
+
+  start = Clock::now();
+  value->ValueBatch(states.data(), num_states, batch_values.data());
+  value->GradientBatch(states.data(), num_states, batch_gradients.data());
+  value->OptimalControlBatch(states.data(), num_states,
+                             batch_controls.data());
+  const double batch_time = seconds(start);
+
+  // Compare.
+  double max_difference = 0.0;
+  for (size_t kk = 0; kk < values.size(); kk++)
+    max_difference = std::max(max_difference,
+                              std::abs(values[kk] - batch_values[kk]));
+  for (size_t kk = 0; kk < gradients.size(); kk++)
+    max_difference = std::max(max_difference,
+                              std::abs(gradients[kk] - batch_gradients[kk]));
+  for (size_t kk = 0; kk < controls.size(); kk++)
+    max_difference = std::max(max_difference,
+                              std::abs(controls[kk] - batch_controls[kk]));
+
+  ROS_INFO("%s: single %.3g states/s, batch %.3g states/s (%.2fx), "
+           "max difference %g.", name.c_str(),
+           static_cast<double>(num_states) / single_time,
+           static_cast<double>(num_states) / batch_time,
+           single_time / batch_time, max_difference);
+}
+
+} //\namespace
+
+int main(int argc, char** argv) {
+  ros::init(argc, argv, "value_batch_benchmark");
+  ros::NodeHandle n("~");
+
+  std::string directory;
+  int num_states, seed;
+  double max_speed;
+  std::vector<double> control_lower, control_upper;
+  n.param<std::string>("directory", directory, "speed_10_tenths");
+  n.param("num_states", num_states, 100000);
+  n.param("random/seed", seed, 0);
+  n.param("max_speed", max_speed, 0.3);
+  n.param("control/lower", control_lower,
+          std::vector<double>({ -0.15, -0.15, 7.81 }));
+  n.param("control/upper", control_upper,
+          std::vector<double>({ 0.15, 0.15, 11.81 }));
+
+  const size_t x_dim = 6;
+  const size_t u_dim = 3;
+  if (control_lower.size() != u_dim || control_upper.size() != u_dim) {
+    ROS_ERROR("%s: Control bounds must have dimension %zu.",
+              ros::this_node::getName().c_str(), u_dim);
+    return EXIT_FAILURE;
+  }
+
+  const meta::NearHoverQuadNoYaw::ConstPtr dynamics =
+    meta::NearHoverQuadNoYaw::Create(
+      Eigen::Map<const meta::VectorXd>(control_lower.data(), u_dim),
+      Eigen::Map<const meta::VectorXd>(control_upper.data(), u_dim));
+
+  std::default_random_engine rng(seed);
+  std::vector<double> states(x_dim * num_states);
+
+  // Numerical value function. Draw states inside every subsystem's grid.
+  std::vector<meta::SubsystemValueFunction::ConstPtr> subsystems;
+  for (const auto& file : meta::ValueFunction::SubsystemFiles(directory)) {
+    subsystems.push_back(meta::SubsystemValueFunction::Create(file));
+
+    const meta::SubsystemValueFunction::ConstPtr& subsystem =
+      subsystems.back();
+    const std::vector<size_t>& dims = subsystem->StateDimensions();
+    for (size_t ii = 0; ii < dims.size(); ii++) {
+      std::uniform_real_distribution<double> unif(
+        subsystem->LowerBound(ii), subsystem->UpperBound(ii));
+
+      for (int kk = 0; kk < num_states; kk++)
+        states[dims[ii] * num_states + kk] = unif(rng);
+    }
+  }
+
+  const meta::ValueFunction::ConstPtr numerical =
+    meta::ValueFunction::Create(std::move(subsystems), dynamics,
+                                x_dim, u_dim, 0);
+  if (numerical->IsInitialized())
+    Benchmark(directory, numerical, states, x_dim, u_dim, num_states);
+  else
+    ROS_ERROR("%s: Could not load value function from %s.",
+              ros::this_node::getName().c_str(), directory.c_str());
+
+  // Analytical value function, at states near its safe set.
+  const meta::ValueFunction::ConstPtr analytical =
+    meta::AnalyticalPointMassValueFunction::Create(
+      meta::Vector3d::Constant(max_speed), meta::Vector3d::Constant(0.6),
+      meta::Vector3d::Constant(0.1), meta::Vector3d::Constant(0.1),
+      dynamics, 0);
+
+  std::uniform_real_distribution<double> unif(-1.0, 1.0);
+  for (auto& entry : states)
+    entry = unif(rng);
+
+  Benchmark("analytical", analytical, states, x_dim, u_dim, num_states);
+
+  return EXIT_SUCCESS;
+}
@@ -56,7 +56,8 @@ int main(int argc, char** argv) {
     return EXIT_FAILURE;
   }
 
-  ros::spin();
+  // All services are served by the server's own thread pools.
+  ros::waitForShutdown();
 
   return EXIT_SUCCESS;
 }
@@ -87,11 +87,26 @@ public:
   // Get the optimal control at a particular state.
   VectorXd OptimalControl(const VectorXd& state) const;
 
+  // Batch versions of the above. See value_function.h for the layout.
+  void ValueBatch(const double* states, size_t num_states,
+                  double* values) const;
+  void GradientBatch(const double* states, size_t num_states,
+                     double* gradients) const;
+  void OptimalControlBatch(const double* states, size_t num_states,
+                           double* controls) const;
+
   // Priority of the optimal control at the given state. This is a number
   // between 0 and 1, where 1 means the final control signal should be exactly
   // the optimal control signal computed by this value function.
   double Priority(const VectorXd& state) const;
 
+  // Evaluate value, gradient, optimal control, and priority in a single pass
+  // over the spatial dimensions. Does not allocate if 'gradient' and
+  // 'control' are already sized.
+  void Evaluate(const VectorXd& state, double& value,
+                VectorXd& gradient, VectorXd& control,
+                double& priority) const;
+
   // Get the tracking error bound in this spatial dimension.
   double TrackingBound(size_t dimension) const;
 
@@ -123,6 +138,36 @@ private:
                                             const Dynamics::ConstPtr& dynamics,
                                             ValueFunctionId id);
 
+  // Evaluate any of value, gradient, and optimal control over a batch of
+  // states, skipping outputs that are null. Each block handles Ops::kWidth
+  // states starting at state kk.
+  void EvaluateBatch(const double* states, size_t num_states,
+                     double* values, double* gradients,
+                     double* controls) const;
+  template<class Ops>
+  void EvaluateBlock(const double* states, size_t num_states, size_t kk,
+                     double* values, double* gradients,
+                     double* controls) const;
+
+  // Values of surfaces A and B in the given spatial dimension.
+  inline void Surfaces(double x, double v, size_t dim,
+                       double& V_A, double& V_B) const {
+    const double v_ref = max_planner_speed_(dim);
+
+    // Value surface A: + for x "below" convex Acceleration parabola.
+    V_A = -x + (0.5 * (v - v_ref)*(v - v_ref) - v_ref*v_ref) *
+      inv_accel_(dim) - x_exp_(dim);
+
+    // Value surface B: + for x "above" concave Braking parabola.
+    V_B = x - (-0.5 * (v + v_ref)*(v + v_ref) + v_ref*v_ref) *
+      inv_accel_(dim) + x_exp_(dim);
+  }
+
+  // Priority corresponding to the given value.
+  inline double PriorityFromValue(double V) const {
+    return 1.0 - std::min(std::max(0.0, (V - V_low_) * inv_V_range_), 1.0);
+  }
+
   // Reference, tracker, and disturbance parameters
   const Vector3d u_max_;            // maximum control input
   const Vector3d u_min_;            // minimum control input (not symmetric)
@@ -133,6 +178,14 @@ private:
   Vector3d a_max_;                  // maximum absolute acceleration
   Vector3d u2a_;                    // bang-bang control-to-acceleration gain
 
+  // Constants precomputed at construction.
+  Vector3d inv_accel_;              // 1 / (a_max - d_a)
+  Vector3d u_acc_;                  // accelerating control input
+  Vector3d u_dec_;                  // decelerating control input
+  double V_safest_;                 // value at the origin
+  double V_low_;                    // value below which priority is 1
+  double inv_V_range_;              // 1 / (V_high - V_low)
+
   static const size_t p_dim_;       // number of spatial dimensions (always 3)
 };
 
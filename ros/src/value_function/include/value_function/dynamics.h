@@ -67,6 +67,29 @@ public:
   virtual VectorXd OptimalControl(const VectorXd& x,
                                   const VectorXd& value_gradient) const = 0;
 
+  // Batch version of the above. States and gradients are structure-of-arrays
+  // blocks with x_dim rows of num_states entries, and controls are written
+  // in the same layout with one row per control dimension. The default
+  // implementation calls OptimalControl once per state.
+  virtual void OptimalControlBatch(const double* states,
+                                   const double* value_gradients,
+                                   size_t x_dim, size_t num_states,
+                                   double* controls) const {
+    VectorXd x(x_dim);
+    VectorXd value_gradient(x_dim);
+
+    for (size_t kk = 0; kk < num_states; kk++) {
+      for (size_t ii = 0; ii < x_dim; ii++) {
+        x(ii) = states[ii * num_states + kk];
+        value_gradient(ii) = value_gradients[ii * num_states + kk];
+      }
+
+      const VectorXd u = OptimalControl(x, value_gradient);
+      for (size_t ii = 0; ii < u.size(); ii++)
+        controls[ii * num_states + kk] = u(ii);
+    }
+  }
+
   // Puncture a full state vector and return a position.
   virtual Vector3d Puncture(const VectorXd& x) const = 0;
 
@@ -86,6 +109,16 @@ public:
     const std::vector<Vector3d>& positions,
     const std::vector<double>& times) const = 0;
 
+  // Same as above, but with the velocity at each position known, e.g. from
+  // an analytic trajectory, rather than taken from forward differences.
+  // By default the velocities are ignored.
+  virtual std::vector<VectorXd> LiftGeometricTrajectory(
+    const std::vector<Vector3d>& positions,
+    const std::vector<Vector3d>& velocities,
+    const std::vector<double>& times) const {
+    return LiftGeometricTrajectory(positions, times);
+  }
+
 protected:
   // Protected constructor. Use the factory method instead.
   explicit Dynamics(const VectorXd& lower_u, const VectorXd& upper_u)
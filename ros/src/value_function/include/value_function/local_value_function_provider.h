@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the LocalValueFunctionProvider class, which inherits from
+// ValueFunctionProvider and holds all value functions in this process.
+// Value functions are constructed exactly as in the ValueFunctionServer,
+// either loaded from disk (numerical mode) or analytically.
+//
+// In numerical mode, the subsystem files of all value functions are loaded
+// concurrently on a pool of worker threads, and each file's load time is
+// reported. Large .mat arrays may optionally be deferred until first use.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef VALUE_FUNCTION_LOCAL_VALUE_FUNCTION_PROVIDER_H
+#define VALUE_FUNCTION_LOCAL_VALUE_FUNCTION_PROVIDER_H
+
+#include <value_function/value_function_provider.h>
+#include <value_function/value_function.h>
+#include <value_function/analytical_point_mass_value_function.h>
+#include <value_function/near_hover_quad_no_yaw.h>
+#include <utils/types.h>
+
+#include <ros/ros.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <atomic>
+
+namespace meta {
+
+class LocalValueFunctionProvider : public ValueFunctionProvider {
+public:
+  typedef std::shared_ptr<LocalValueFunctionProvider> Ptr;
+  typedef std::shared_ptr<const LocalValueFunctionProvider> ConstPtr;
+
+  // Destructor.
+  ~LocalValueFunctionProvider() {}
+
+  // Factory method. Use this instead of the constructor.
+  static Ptr Create();
+
+  // Initialize this class from a ROS node. Loads all value functions.
+  bool Initialize(const ros::NodeHandle& n);
+
+  // Inherited from ValueFunctionProvider. See value_function_provider.h.
+  bool OptimalControl(ValueFunctionId id, const VectorXd& state,
+                      VectorXd& control) const;
+  bool Priority(ValueFunctionId id, const VectorXd& state,
+                double& priority) const;
+  bool OptimalControlAndPriority(ValueFunctionId id, const VectorXd& state,
+                                 VectorXd& control, double& priority) const;
+  bool TrackingBound(ValueFunctionId id, Vector3d& bound) const;
+  bool SwitchingTrackingBound(ValueFunctionId from_id, ValueFunctionId to_id,
+                              Vector3d& bound) const;
+  bool GuaranteedSwitchingTime(ValueFunctionId from_id, ValueFunctionId to_id,
+                               Vector3d& time) const;
+  bool GuaranteedSwitchingDistance(ValueFunctionId from_id,
+                                   ValueFunctionId to_id,
+                                   Vector3d& distance) const;
+  bool MaxPlannerSpeed(ValueFunctionId id, Vector3d& speed) const;
+  bool BestPossibleTime(ValueFunctionId id,
+                        const Vector3d& start, const Vector3d& stop,
+                        double& time) const;
+
+  // Number of value functions held by this provider.
+  inline size_t NumValueFunctions() const { return values_.size(); }
+
+private:
+  explicit LocalValueFunctionProvider();
+
+  // Load parameters.
+  bool LoadParameters(const ros::NodeHandle& n);
+
+  // Check that this ID refers to a loaded value function.
+  bool IsValidId(ValueFunctionId id) const;
+
+  // Load all numerical value functions, with each subsystem file loaded
+  // concurrently. Returns whether or not it was successful.
+  bool LoadNumerical(const Dynamics::ConstPtr& dynamics);
+
+  // Numerical mode flag and associated parameters for both analytic
+  // and numerical modes.
+  bool numerical_mode_;
+  std::vector<std::string> value_dirs_;
+  std::vector<double> max_planner_speeds_;
+  std::vector<double> max_velocity_disturbances_;
+  std::vector<double> max_acceleration_disturbances_;
+
+  // Number of threads on which to load subsystem files, and whether to
+  // defer reading large arrays until first use.
+  size_t num_load_threads_;
+  bool lazy_load_;
+
+  // Control upper/lower bounds.
+  size_t control_dim_, state_dim_;
+  std::vector<double> control_upper_;
+  std::vector<double> control_lower_;
+
+  // List of value functions.
+  std::vector<ValueFunction::ConstPtr> values_;
+};
+
+} //\namespace meta
+
+#endif
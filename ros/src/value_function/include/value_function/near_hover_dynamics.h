@@ -110,6 +110,12 @@ public:
     const std::vector<Vector3d>& positions,
     const std::vector<double>& times) const;
 
+  // Same as above, but with the velocity at each position given.
+  std::vector<VectorXd> LiftGeometricTrajectory(
+    const std::vector<Vector3d>& positions,
+    const std::vector<Vector3d>& velocities,
+    const std::vector<double>& times) const;
+
 private:
   // Private constructor. Use the factory method instead.
   explicit NearHoverDynamics(const VectorXd& lower_u,
@@ -91,6 +91,10 @@ public:
   // gradient of the value function at that state.
   VectorXd OptimalControl(const VectorXd& x,
                           const VectorXd& value_gradient) const;
+  void OptimalControlBatch(const double* states,
+                           const double* value_gradients,
+                           size_t x_dim, size_t num_states,
+                           double* controls) const;
 
   // Puncture a full state vector and return a position.
   Vector3d Puncture(const VectorXd& x) const;
@@ -107,6 +111,12 @@ public:
     const std::vector<Vector3d>& positions,
     const std::vector<double>& times) const;
 
+  // Same as above, but with the velocity at each position given.
+  std::vector<VectorXd> LiftGeometricTrajectory(
+    const std::vector<Vector3d>& positions,
+    const std::vector<Vector3d>& velocities,
+    const std::vector<double>& times) const;
+
 private:
   // Private constructor. Use the factory method instead.
   explicit NearHoverQuadNoYaw(const VectorXd& lower_u, const VectorXd& upper_u);
@@ -0,0 +1,154 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the RemoteValueFunctionProvider class, which inherits from
+// ValueFunctionProvider and forwards state-dependent queries to a
+// ValueFunctionServer over persistent ROS service connections. Queries which
+// depend only on value function IDs are answered from a ValueFunctionClient,
+// which caches them locally.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef VALUE_FUNCTION_REMOTE_VALUE_FUNCTION_PROVIDER_H
+#define VALUE_FUNCTION_REMOTE_VALUE_FUNCTION_PROVIDER_H
+
+#include <value_function/value_function_provider.h>
+#include <utils/value_function_client.h>
+#include <utils/types.h>
+
+#include <value_function_srvs/OptimalControl.h>
+#include <value_function_srvs/Priority.h>
+#include <value_function_srvs/OptimalControlAndPriority.h>
+
+#include <ros/ros.h>
+#include <string>
+
+namespace meta {
+
+class RemoteValueFunctionProvider : public ValueFunctionProvider {
+public:
+  typedef std::shared_ptr<RemoteValueFunctionProvider> Ptr;
+  typedef std::shared_ptr<const RemoteValueFunctionProvider> ConstPtr;
+
+  // Destructor.
+  ~RemoteValueFunctionProvider() {}
+
+  // Factory method. Use this instead of the constructor.
+  static Ptr Create();
+
+  // Initialize this class from a ROS node. Waits for all named services and
+  // fetches all cached tables.
+  bool Initialize(const ros::NodeHandle& n);
+
+  // Inherited from ValueFunctionProvider. See value_function_provider.h.
+  bool OptimalControl(ValueFunctionId id, const VectorXd& state,
+                      VectorXd& control) const;
+  bool Priority(ValueFunctionId id, const VectorXd& state,
+                double& priority) const;
+  bool OptimalControlAndPriority(ValueFunctionId id, const VectorXd& state,
+                                 VectorXd& control, double& priority) const;
+  bool TrackingBound(ValueFunctionId id, Vector3d& bound) const;
+  bool SwitchingTrackingBound(ValueFunctionId from_id, ValueFunctionId to_id,
+                              Vector3d& bound) const;
+  bool GuaranteedSwitchingTime(ValueFunctionId from_id, ValueFunctionId to_id,
+                               Vector3d& time) const;
+  bool GuaranteedSwitchingDistance(ValueFunctionId from_id,
+                                   ValueFunctionId to_id,
+                                   Vector3d& distance) const;
+  bool MaxPlannerSpeed(ValueFunctionId id, Vector3d& speed) const;
+  bool BestPossibleTime(ValueFunctionId id,
+                        const Vector3d& start, const Vector3d& stop,
+                        double& time) const;
+
+private:
+  explicit RemoteValueFunctionProvider();
+
+  // Load parameters and register callbacks.
+  bool LoadParameters(const ros::NodeHandle& n);
+  bool RegisterCallbacks(const ros::NodeHandle& n);
+
+  // Make sure the given client is connected. If it is not, try to reconnect
+  // and return false. Returns false without reconnecting if no service name
+  // was provided.
+  template<typename ServiceType>
+  bool CheckConnection(ros::ServiceClient& client,
+                       const std::string& service_name) const;
+
+  // Persistent service clients for state-dependent queries.
+  mutable ros::ServiceClient optimal_control_srv_;
+  mutable ros::ServiceClient priority_srv_;
+  mutable ros::ServiceClient optimal_control_and_priority_srv_;
+
+  std::string optimal_control_name_;
+  std::string priority_name_;
+  std::string optimal_control_and_priority_name_;
+
+  // Cache of all queries which depend only on value function IDs.
+  ValueFunctionClient::Ptr client_;
+};
+
+// ------------------------------- IMPLEMENTATION --------------------------- //
+
+// Make sure the given client is connected. If it is not, try to reconnect
+// and return false. Returns false without reconnecting if no service name
+// was provided.
+template<typename ServiceType>
+bool RemoteValueFunctionProvider::
+CheckConnection(ros::ServiceClient& client,
+                const std::string& service_name) const {
+  if (service_name.empty()) {
+    ROS_ERROR_THROTTLE(1.0, "%s: No service name provided for this query.",
+                       name_.c_str());
+    return false;
+  }
+
+  if (!client) {
+    ROS_WARN("%s: Server %s disconnected.",
+             name_.c_str(), service_name.c_str());
+
+    ros::NodeHandle nl;
+    client = nl.serviceClient<ServiceType>(service_name.c_str(), true);
+    return false;
+  }
+
+  return true;
+}
+
+} //\namespace meta
+
+#endif
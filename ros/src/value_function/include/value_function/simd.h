@@ -0,0 +1,179 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+///////////////////////////////////////////////////////////////////////////////
+//
+// Thin wrappers around the SIMD operations used by the batch value function
+// kernels. Each wrapper exposes the same static functions on a vector of
+// kWidth doubles, so a kernel written once against a template parameter
+// compiles to AVX-512, AVX2, or plain scalar code.
+//
+// The widest instruction set enabled at compile time is used as NativeOps
+// (see the ENABLE_NATIVE_SIMD CMake option). ScalarOps is always available,
+// and handles the remainder of a batch that does not fill a whole vector.
+//
+// Gather indices are held in doubles and converted to 32-bit integers, so
+// callers must only use the vector paths for arrays of fewer than 2^31
+// elements.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef VALUE_FUNCTION_SIMD_H
+#define VALUE_FUNCTION_SIMD_H
+
+#include <cmath>
+#include <algorithm>
+
+#if defined(__AVX2__) || defined(__AVX512F__)
+#include <immintrin.h>
+#endif
+
+namespace meta {
+namespace simd {
+
+// Largest number of elements that may be gathered by the vector paths.
+const size_t kMaxGatherElements = static_cast<size_t>(1) << 31;
+
+// Scalar fallback.
+struct ScalarOps {
+  typedef double Vec;
+  typedef bool Mask;
+  static const size_t kWidth = 1;
+
+  static inline Vec Load(const double* p) { return *p; }
+  static inline void Store(double* p, Vec a) { *p = a; }
+  static inline Vec Set(double a) { return a; }
+  static inline Vec Add(Vec a, Vec b) { return a + b; }
+  static inline Vec Sub(Vec a, Vec b) { return a - b; }
+  static inline Vec Mul(Vec a, Vec b) { return a * b; }
+  static inline Vec Div(Vec a, Vec b) { return a / b; }
+  static inline Vec Min(Vec a, Vec b) { return (a < b) ? a : b; }
+  static inline Vec Max(Vec a, Vec b) { return (a > b) ? a : b; }
+  static inline Vec Floor(Vec a) { return std::floor(a); }
+  static inline Mask Less(Vec a, Vec b) { return a < b; }
+  static inline Mask Greater(Vec a, Vec b) { return a > b; }
+  static inline Mask GreaterEqual(Vec a, Vec b) { return a >= b; }
+  static inline Vec Select(Mask m, Vec a, Vec b) { return m ? a : b; }
+
+  // Gather base[index], where index holds a non-negative integer.
+  static inline Vec Gather(const double* base, Vec index) {
+    return base[static_cast<size_t>(index)];
+  }
+};
+
+#ifdef __AVX2__
+// Four doubles at a time.
+struct Avx2Ops {
+  typedef __m256d Vec;
+  typedef __m256d Mask;
+  static const size_t kWidth = 4;
+
+  static inline Vec Load(const double* p) { return _mm256_loadu_pd(p); }
+  static inline void Store(double* p, Vec a) { _mm256_storeu_pd(p, a); }
+  static inline Vec Set(double a) { return _mm256_set1_pd(a); }
+  static inline Vec Add(Vec a, Vec b) { return _mm256_add_pd(a, b); }
+  static inline Vec Sub(Vec a, Vec b) { return _mm256_sub_pd(a, b); }
+  static inline Vec Mul(Vec a, Vec b) { return _mm256_mul_pd(a, b); }
+  static inline Vec Div(Vec a, Vec b) { return _mm256_div_pd(a, b); }
+  static inline Vec Min(Vec a, Vec b) { return _mm256_min_pd(a, b); }
+  static inline Vec Max(Vec a, Vec b) { return _mm256_max_pd(a, b); }
+  static inline Vec Floor(Vec a) { return _mm256_floor_pd(a); }
+  static inline Mask Less(Vec a, Vec b) {
+    return _mm256_cmp_pd(a, b, _CMP_LT_OQ);
+  }
+  static inline Mask Greater(Vec a, Vec b) {
+    return _mm256_cmp_pd(a, b, _CMP_GT_OQ);
+  }
+  static inline Mask GreaterEqual(Vec a, Vec b) {
+    return _mm256_cmp_pd(a, b, _CMP_GE_OQ);
+  }
+  static inline Vec Select(Mask m, Vec a, Vec b) {
+    return _mm256_blendv_pd(b, a, m);
+  }
+  static inline Vec Gather(const double* base, Vec index) {
+    return _mm256_i32gather_pd(base, _mm256_cvttpd_epi32(index), 8);
+  }
+};
+#endif
+
+#ifdef __AVX512F__
+// Eight doubles at a time.
+struct Avx512Ops {
+  typedef __m512d Vec;
+  typedef __mmask8 Mask;
+  static const size_t kWidth = 8;
+
+  static inline Vec Load(const double* p) { return _mm512_loadu_pd(p); }
+  static inline void Store(double* p, Vec a) { _mm512_storeu_pd(p, a); }
+  static inline Vec Set(double a) { return _mm512_set1_pd(a); }
+  static inline Vec Add(Vec a, Vec b) { return _mm512_add_pd(a, b); }
+  static inline Vec Sub(Vec a, Vec b) { return _mm512_sub_pd(a, b); }
+  static inline Vec Mul(Vec a, Vec b) { return _mm512_mul_pd(a, b); }
+  static inline Vec Div(Vec a, Vec b) { return _mm512_div_pd(a, b); }
+  static inline Vec Min(Vec a, Vec b) { return _mm512_min_pd(a, b); }
+  static inline Vec Max(Vec a, Vec b) { return _mm512_max_pd(a, b); }
+  static inline Vec Floor(Vec a) {
+    return _mm512_roundscale_pd(a, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+  }
+  static inline Mask Less(Vec a, Vec b) {
+    return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ);
+  }
+  static inline Mask Greater(Vec a, Vec b) {
+    return _mm512_cmp_pd_mask(a, b, _CMP_GT_OQ);
+  }
+  static inline Mask GreaterEqual(Vec a, Vec b) {
+    return _mm512_cmp_pd_mask(a, b, _CMP_GE_OQ);
+  }
+  static inline Vec Select(Mask m, Vec a, Vec b) {
+    return _mm512_mask_blend_pd(m, b, a);
+  }
+  static inline Vec Gather(const double* base, Vec index) {
+    return _mm512_i32gather_pd(_mm512_cvttpd_epi32(index), base, 8);
+  }
+};
+#endif
+
+#if defined(__AVX512F__)
+typedef Avx512Ops NativeOps;
+#elif defined(__AVX2__)
+typedef Avx2Ops NativeOps;
+#else
+typedef ScalarOps NativeOps;
+#endif
+
+} //\namespace simd
+} //\namespace meta
+
+#endif
@@ -38,19 +38,50 @@
 //
 // Defines the SubsystemValueFunction class.
 //
+// Subsystems of dimension 1 through 4 are interpolated by kernels specialized
+// on the dimension at compile time, using precomputed strides and reciprocal
+// voxel sizes. These never allocate, so Value() and the in-place Gradient()
+// do no heap allocation. Larger subsystems fall back to a generic path.
+//
+// By default, each voxel's value and gradient are interleaved into a single
+// 32-byte-aligned record (64 bytes for 4D), so interpolating at a corner
+// touches a single cache line. The separate layout (one array for values and
+// one per gradient component) is kept for comparison.
+//
+// Grids may be loaded from MATLAB .mat files, or from the binary .grid format
+// written by Save(). Binary grids are memory-mapped read-only and used in
+// place, so loading is nearly free and processes share the same pages.
+//
+// Batch queries take a structure-of-arrays block of full states, where
+// states[ii * num_states + kk] is state dimension ii of state kk, and use
+// the SIMD kernels in simd.h for subsystems of dimension 1 through 4. Unlike
+// single queries, they clamp states outside the grid without warning.
+//
+// A .mat file may instead be loaded lazily: only the small arrays are read
+// up front, and the value and gradient arrays are read on first use.
+//
+// Thread safety: the grid is never modified after it is loaded, and all
+// interpolation uses only local scratch space, so const methods may be
+// called concurrently from any number of threads. Deferred data is loaded
+// exactly once, under std::call_once, before any query touches it.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifndef VALUE_FUNCTION_SUBSYSTEM_VALUE_FUNCTION_H
 #define VALUE_FUNCTION_SUBSYSTEM_VALUE_FUNCTION_H
 
 #include <value_function/dynamics.h>
+#include <value_function/simd.h>
 #include <utils/types.h>
 #include <utils/uncopyable.h>
 
 #include <ros/ros.h>
+#include <mutex>
 #include <matio.h>
 #include <math.h>
 #include <memory>
+#include <array>
+#include <algorithm>
 
 namespace meta {
 
@@ -58,18 +89,42 @@ class SubsystemValueFunction : private Uncopyable {
 public:
   typedef std::unique_ptr<const SubsystemValueFunction> ConstPtr;
 
-  // Destructor.
-  ~SubsystemValueFunction() {}
+  // Destructor. Unmaps the grid file, if any.
+  ~SubsystemValueFunction();
 
   // Factory method. Use this instead of the constructor.
   // Note that this class is const-only, which means that once it is
-  // instantiated it can never be changed.
-  static ConstPtr Create(const std::string& file_name);
+  // instantiated it can never be changed. Files ending in ".grid" are
+  // memory-mapped and always interleaved; anything else is read as a .mat.
+  // If 'lazy' is set, a .mat file's value and gradient arrays are not read
+  // until the first query.
+  static ConstPtr Create(const std::string& file_name,
+                         bool interleaved = true, bool lazy = false);
+
+  // Write this subsystem to a file in the binary .grid format.
+  // Returns whether or not it was successful.
+  bool Save(const std::string& file_name) const;
 
   // Linearly interpolate to get the value/gradient at a particular state.
+  // The returned gradient has one entry per subsystem state dimension.
   double Value(const VectorXd& state) const;
   VectorXd Gradient(const VectorXd& state) const;
 
+  // Same as above, but write each gradient entry into the corresponding
+  // full state dimension of 'gradient', which must already be sized for the
+  // full state. Other entries are untouched. Does not allocate.
+  void Gradient(const VectorXd& state, VectorXd& gradient) const;
+
+  // Batch versions of the above, over a structure-of-arrays block of full
+  // states. MaxValueBatch replaces each entry of 'values' by the max of it
+  // and the value at the corresponding state. GradientBatch writes only the
+  // rows of 'gradients' (also structure-of-arrays, full state dimension)
+  // corresponding to this subsystem.
+  void MaxValueBatch(const double* states, size_t num_states,
+                     double* values) const;
+  void GradientBatch(const double* states, size_t num_states,
+                     double* gradients) const;
+
   // Priority of the optimal control at the given state. This is a number
   // between 0 and 1, where 1 means the final control signal should be exactly
   // the optimal control signal computed by this value function.
@@ -83,6 +138,10 @@ public:
     return control_dimensions_;
   }
 
+  // Grid bounds in the specified subsystem dimension.
+  inline double LowerBound(size_t ii) const { return lower_[ii]; }
+  inline double UpperBound(size_t ii) const { return upper_[ii]; }
+
   // Get the tracking error bound in the specified subsystem dimension.
   inline double TrackingBound(size_t ii) const { return tracking_bound_[ii]; }
 
@@ -95,7 +154,91 @@ public:
   inline bool IsInitialized() const { return initialized_; }
 
 private:
-  explicit SubsystemValueFunction(const std::string& file_name);
+  explicit SubsystemValueFunction(const std::string& file_name,
+                                  bool interleaved, bool lazy);
+
+  // Make sure deferred value and gradient arrays have been loaded.
+  inline void EnsureLoaded() const {
+    if (lazy_)
+      std::call_once(deferred_once_, &SubsystemValueFunction::LoadDeferred,
+                     const_cast<SubsystemValueFunction*>(this));
+  }
+
+  // Value and gradient component ii at the voxel with the given index,
+  // in either storage layout.
+  inline double VoxelValue(size_t index) const {
+    return (interleaved_) ? voxels_[index * voxel_stride_] : data_[index];
+  }
+  inline double VoxelGradient(size_t index, size_t ii) const {
+    return (interleaved_) ?
+      voxels_[index * voxel_stride_ + 1 + ii] : gradient_[ii][index];
+  }
+
+  // Pack data_ and gradient_ into interleaved voxel records, and release
+  // the separate arrays.
+  void Interleave();
+
+  // Interpolation kernels for subsystems of fixed dimension D. The gradient
+  // is written into D entries of the given buffer, in subsystem order.
+  template<size_t D>
+  double FixedValue(const VectorXd& state) const;
+  template<size_t D>
+  void FixedGradient(const VectorXd& state, double* gradient) const;
+
+  // Batch kernels for subsystems of fixed dimension D. Each block handles
+  // Ops::kWidth states starting at state kk.
+  template<size_t D>
+  void FixedMaxValueBatch(const double* states, size_t num_states,
+                          double* values) const;
+  template<size_t D>
+  void FixedGradientBatch(const double* states, size_t num_states,
+                          double* gradients) const;
+  template<class Ops, size_t D>
+  void MaxValueBlock(const double* states, size_t num_states, size_t kk,
+                     double* values) const;
+  template<class Ops, size_t D>
+  void GradientBlock(const double* states, size_t num_states, size_t kk,
+                     double* gradients) const;
+
+  // Base pointers and record stride for batch gathers, in either layout.
+  inline const double* ValueBase() const {
+    return (interleaved_) ? voxels_ : data_.data();
+  }
+  inline const double* GradientBase(size_t ii) const {
+    return (interleaved_) ? voxels_ + 1 + ii : gradient_[ii].data();
+  }
+  inline size_t RecordStride() const {
+    return (interleaved_) ? voxel_stride_ : 1;
+  }
+
+  // Can the vector batch kernels index the whole grid?
+  inline bool FitsVectorGather() const {
+    return strides_[0] * num_voxels_[0] * RecordStride() <
+      simd::kMaxGatherElements;
+  }
+
+  // Generic interpolation for subsystems of any dimension. Allocates.
+  double GenericValue(const VectorXd& state) const;
+  VectorXd GenericGradient(const VectorXd& state) const;
+
+  // Quantize a (punctured) coordinate in subsystem dimension ii, clamping
+  // to the grid.
+  inline size_t Quantize(double x, size_t ii) const {
+    if (x < lower_[ii]) {
+      ROS_WARN("State is below the SubsystemValueFunction grid in dimension %zu.", ii);
+      return 0;
+    }
+
+    if (x > upper_[ii]) {
+      ROS_WARN("State is above the SubsystemValueFunction grid in dimension %zu.", ii);
+      return num_voxels_[ii] - 1;
+    }
+
+    // In bounds, so quantize. This works because of 0-indexing and casting.
+    return std::min(
+      static_cast<size_t>((x - lower_[ii]) * inv_voxel_size_[ii]),
+      num_voxels_[ii] - 1);
+  }
 
   // Puncture a state vector for the overall system to get a
   // valid state vector for this subsystem.
@@ -120,6 +263,18 @@ private:
 
   // Load from file. Returns whether or not it was successful.
   bool Load(const std::string& file_name);
+  bool LoadMat(const std::string& file_name);
+  bool LoadMapped(const std::string& file_name);
+
+  // Read the value and gradient arrays from an open .mat file.
+  bool LoadMatData(mat_t* matfp);
+
+  // Load deferred value and gradient arrays. Called exactly once.
+  void LoadDeferred();
+
+  // Compute voxel sizes, reciprocal voxel sizes, and strides from the
+  // grid bounds and number of voxels.
+  void ComputeGridConstants();
 
   // Which dimensions in the full state/control space does this
   // value grid correspond to?
@@ -132,6 +287,10 @@ private:
   std::vector<double> lower_;
   std::vector<double> upper_;
 
+  // Precomputed reciprocal voxel sizes, and row-major strides into data_.
+  std::vector<double> inv_voxel_size_;
+  std::vector<size_t> strides_;
+
   // Lower and upper bounds for the value function. Used for computing the
   // 'priority' of the optimal control signal.
   double priority_lower_;
@@ -144,12 +303,31 @@ private:
   // in the same order as data_.
   std::vector< std::vector<double> > gradient_;
 
+  // Interleaved storage. Each voxel is a record of voxel_stride_ doubles:
+  // the value followed by each gradient component, then padding. voxels_
+  // points to the first 64-byte-aligned entry of voxel_storage_.
+  bool interleaved_;
+  size_t voxel_stride_;
+  std::vector<double> voxel_storage_;
+  const double* voxels_;
+
+  // Memory-mapped grid file, if loaded from one. When set, voxels_ points
+  // into this mapping instead of voxel_storage_.
+  void* mapping_;
+  size_t mapping_size_;
+
   // Tracking error bound in each subsystem dimension.
   std::vector<double> tracking_bound_;
 
   // Max planner speed in each spatial dimension.
   std::vector<double> max_planner_speed_;
 
+  // Lazy loading. The file name is kept so that deferred arrays can be
+  // read on first use.
+  const bool lazy_;
+  const std::string file_name_;
+  mutable std::once_flag deferred_once_;
+
   // Was this value function initialized/loaded properly?
   bool initialized_;
 };
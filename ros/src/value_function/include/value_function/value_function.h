@@ -39,6 +39,11 @@
 // Defines the ValueFunction class. Many functions in this class are declared
 // virtual so that analytical value functions may inherit from this class.
 //
+// Thread safety: a ValueFunction is never modified after construction, so
+// its const methods may be called concurrently from any number of threads.
+// Derived classes must preserve this, i.e. they may not keep mutable members
+// or static scratch space.
+//
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifndef VALUE_FUNCTION_VALUE_FUNCTION_H
@@ -70,6 +75,18 @@ public:
                          const Dynamics::ConstPtr& dynamics,
                          size_t x_dim, size_t u_dim, ValueFunctionId id);
 
+  // Same as above, but take ownership of subsystems that have already been
+  // loaded, e.g. concurrently from the files listed by SubsystemFiles().
+  static ConstPtr Create(
+    std::vector<SubsystemValueFunction::ConstPtr>&& subsystems,
+    const Dynamics::ConstPtr& dynamics,
+    size_t x_dim, size_t u_dim, ValueFunctionId id);
+
+  // List the subsystem files to load from this precomputation directory
+  // (relative to PRECOMPUTATION_DIR). Binary .grid files are preferred over
+  // .mat files with the same name. Returns full paths.
+  static std::vector<std::string> SubsystemFiles(const std::string& directory);
+
   // Get velocity expansion in the subsystem containing the given spatial dim.
   virtual double VelocityExpansion(size_t dimension) const;
 
@@ -82,6 +99,18 @@ public:
     return dynamics_->OptimalControl(state, Gradient(state));
   }
 
+  // Batch versions of the above, over a structure-of-arrays block of states:
+  // states[ii * num_states + kk] is state dimension ii of state kk. Results
+  // are written to caller-provided buffers in the same layout, with one row
+  // per state dimension for gradients and one per control dimension for
+  // controls. These use SIMD kernels where available.
+  virtual void ValueBatch(const double* states, size_t num_states,
+                          double* values) const;
+  virtual void GradientBatch(const double* states, size_t num_states,
+                             double* gradients) const;
+  virtual void OptimalControlBatch(const double* states, size_t num_states,
+                                   double* controls) const;
+
   // Get the tracking error bound in this spatial dimension.
   virtual double TrackingBound(size_t dimension) const;
 
@@ -106,6 +135,13 @@ public:
   // the optimal control signal computed by this value function.
   virtual double Priority(const VectorXd& state) const;
 
+  // Evaluate value, gradient, optimal control, and priority at once.
+  // 'gradient' and 'control' should already be sized for the state and
+  // control dimensions, in which case derived classes need not allocate.
+  virtual void Evaluate(const VectorXd& state, double& value,
+                        VectorXd& gradient, VectorXd& control,
+                        double& priority) const;
+
   // Get the dynamics.
   inline Dynamics::ConstPtr GetDynamics() const { return dynamics_; }
 
@@ -166,9 +202,10 @@ protected:
 
 private:
   // Constructor for use by this class.
-  explicit ValueFunction(const std::string& directory,
-                         const Dynamics::ConstPtr& dynamics,
-                         size_t x_dim, size_t u_dim, ValueFunctionId id);
+  explicit ValueFunction(
+    std::vector<SubsystemValueFunction::ConstPtr>&& subsystems,
+    const Dynamics::ConstPtr& dynamics,
+    size_t x_dim, size_t u_dim, ValueFunctionId id);
 
   // List of value functions for independent subsystems.
   std::vector<SubsystemValueFunction::ConstPtr> subsystems_;
@@ -0,0 +1,136 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the ValueFunctionProvider abstract class interface. Providers
+// answer every value function query used by the planner, environment,
+// trajectory interpreter, and tracker. Two backends exist: one which holds
+// the value functions in this process, and one which forwards each query to
+// a ValueFunctionServer over ROS services.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#ifndef VALUE_FUNCTION_VALUE_FUNCTION_PROVIDER_H
+#define VALUE_FUNCTION_VALUE_FUNCTION_PROVIDER_H
+
+#include <utils/types.h>
+#include <utils/uncopyable.h>
+
+#include <ros/ros.h>
+#include <memory>
+#include <string>
+
+namespace meta {
+
+class ValueFunctionProvider : private Uncopyable {
+public:
+  typedef std::shared_ptr<ValueFunctionProvider> Ptr;
+  typedef std::shared_ptr<const ValueFunctionProvider> ConstPtr;
+
+  // Destructor.
+  virtual ~ValueFunctionProvider() {}
+
+  // Factory method. Reads the "value_function/in_process" parameter and
+  // creates/initializes either an in-process or a remote (service) backend.
+  // Returns a null pointer on failure.
+  static ConstPtr Create(const ros::NodeHandle& n);
+
+  // Initialize this class from a ROS node.
+  virtual bool Initialize(const ros::NodeHandle& n) = 0;
+
+  // Get the optimal control at a particular (relative) state.
+  virtual bool OptimalControl(ValueFunctionId id, const VectorXd& state,
+                              VectorXd& control) const = 0;
+
+  // Priority of the optimal control at the given state. This is a number
+  // between 0 and 1, where 1 means the final control signal should be exactly
+  // the optimal control signal computed by this value function.
+  virtual bool Priority(ValueFunctionId id, const VectorXd& state,
+                        double& priority) const = 0;
+
+  // Optimal control and its priority at the given state, in one query.
+  // By default this just calls OptimalControl and Priority.
+  virtual bool OptimalControlAndPriority(ValueFunctionId id,
+                                         const VectorXd& state,
+                                         VectorXd& control,
+                                         double& priority) const;
+
+  // Get the tracking error bound in each spatial dimension.
+  virtual bool TrackingBound(ValueFunctionId id, Vector3d& bound) const = 0;
+
+  // Get the tracking error bound in each spatial dimension for a planner
+  // switching from one value function INTO another.
+  virtual bool SwitchingTrackingBound(ValueFunctionId from_id,
+                                      ValueFunctionId to_id,
+                                      Vector3d& bound) const = 0;
+
+  // Guaranteed time in which a planner with the 'from' value function
+  // can switch into the 'to' value function's tracking error bound.
+  virtual bool GuaranteedSwitchingTime(ValueFunctionId from_id,
+                                       ValueFunctionId to_id,
+                                       Vector3d& time) const = 0;
+
+  // Guaranteed distance in which a planner with the 'from' value function
+  // can switch into the 'to' value function's safe set.
+  virtual bool GuaranteedSwitchingDistance(ValueFunctionId from_id,
+                                           ValueFunctionId to_id,
+                                           Vector3d& distance) const = 0;
+
+  // Max planner speed in each spatial dimension.
+  virtual bool MaxPlannerSpeed(ValueFunctionId id, Vector3d& speed) const = 0;
+
+  // Compute the shortest possible time to go from start to stop for a
+  // geometric planner with the max planner speed for this value function.
+  virtual bool BestPossibleTime(ValueFunctionId id,
+                                const Vector3d& start, const Vector3d& stop,
+                                double& time) const = 0;
+
+  // Was this provider properly initialized?
+  inline bool IsInitialized() const { return initialized_; }
+
+protected:
+  explicit ValueFunctionProvider()
+    : initialized_(false) {}
+
+  // Initialization and naming.
+  bool initialized_;
+  std::string name_;
+};
+
+} //\namespace meta
+
+#endif
@@ -37,17 +37,16 @@
 ///////////////////////////////////////////////////////////////////////////////
 //
 // Defines the ValueFunctionServer class, which manages the service-based
-// interface to all value functions.
+// interface to all value functions. Latency-critical control services
+// (optimal control and priority) are served from their own callback queue
+// and thread pool, so that bursts of planner queries cannot delay them.
 //
 ///////////////////////////////////////////////////////////////////////////////
 
 #ifndef VALUE_FUNCTION_VALUE_FUNCTION_SERVER_H
 #define VALUE_FUNCTION_VALUE_FUNCTION_SERVER_H
 
-#include <value_function/value_function.h>
-#include <value_function/analytical_point_mass_value_function.h>
-#include <value_function/dynamics.h>
-#include <value_function/near_hover_quad_no_yaw.h>
+#include <value_function/local_value_function_provider.h>
 #include <utils/types.h>
 #include <utils/uncopyable.h>
 
@@ -59,18 +58,32 @@
 #include <value_function_srvs/TrackingBoundBox.h>
 #include <value_function_srvs/SwitchingTrackingBoundBox.h>
 #include <value_function_srvs/Priority.h>
+#include <value_function_srvs/OptimalControlAndPriority.h>
+#include <value_function_srvs/NumValueFunctions.h>
+#include <value_function_srvs/OptimalControlBatch.h>
+#include <value_function_srvs/PriorityBatch.h>
+#include <value_function_srvs/GeometricPlannerTimeBatch.h>
+#include <value_function_srvs/SwitchingTrackingBoundBoxBatch.h>
 
 #include <ros/ros.h>
+#include <ros/callback_queue.h>
+#include <memory>
 
 namespace meta {
 
 class ValueFunctionServer : private Uncopyable {
 public:
-  ~ValueFunctionServer() {}
+  // Destructor. Stops serving before anything the callbacks use goes away.
+  ~ValueFunctionServer() {
+    if (control_spinner_) control_spinner_->stop();
+    if (planner_spinner_) planner_spinner_->stop();
+  }
+
   explicit ValueFunctionServer()
     : initialized_(false) {}
 
-  // Initialize this class with all parameters and callbacks.
+  // Initialize this class with all parameters and callbacks, and start
+  // serving on both thread pools.
   bool Initialize(const ros::NodeHandle& n);
 
   // Get the optimal control at a particular state.
@@ -107,6 +120,12 @@ public:
   bool PriorityCallback(value_function_srvs::Priority::Request& req,
                         value_function_srvs::Priority::Response& res);
 
+  // Optimal control and its priority, from one fused evaluation. This is
+  // what the tracker calls every tick.
+  bool OptimalControlAndPriorityCallback(
+    value_function_srvs::OptimalControlAndPriority::Request& req,
+    value_function_srvs::OptimalControlAndPriority::Response& res);
+
   // Max planner speed in the given spatial dimension.
   bool MaxPlannerSpeedCallback(
     value_function_srvs::GeometricPlannerSpeed::Request& req,
@@ -118,10 +137,40 @@ public:
     value_function_srvs::GeometricPlannerTime::Request& req,
     value_function_srvs::GeometricPlannerTime::Response& res);
 
+  // Number of value functions held by this server.
+  bool NumValueFunctionsCallback(
+    value_function_srvs::NumValueFunctions::Request& req,
+    value_function_srvs::NumValueFunctions::Response& res);
+
+  // Batched variants of the above. States, points, and bounds are packed
+  // into flat arrays, one after another.
+  bool OptimalControlBatchCallback(
+    value_function_srvs::OptimalControlBatch::Request& req,
+    value_function_srvs::OptimalControlBatch::Response& res);
+  bool PriorityBatchCallback(
+    value_function_srvs::PriorityBatch::Request& req,
+    value_function_srvs::PriorityBatch::Response& res);
+  bool BestPossibleTimeBatchCallback(
+    value_function_srvs::GeometricPlannerTimeBatch::Request& req,
+    value_function_srvs::GeometricPlannerTimeBatch::Response& res);
+  bool SwitchingTrackingBoundBatchCallback(
+    value_function_srvs::SwitchingTrackingBoundBoxBatch::Request& req,
+    value_function_srvs::SwitchingTrackingBoundBoxBatch::Response& res);
+
 private:
   bool LoadParameters(const ros::NodeHandle& n);
   bool RegisterCallbacks(const ros::NodeHandle& n);
 
+  // All value functions, held in this process. Only const methods are
+  // called after initialization, so this is shared across all threads.
+  // Declared before the services and spinners so that it outlives them.
+  LocalValueFunctionProvider::Ptr values_;
+
+  // Callback queues for control and planner services. Declared before the
+  // services and spinners so that they are destroyed after them.
+  ros::CallbackQueue control_queue_;
+  ros::CallbackQueue planner_queue_;
+
   // Services.
   ros::ServiceServer optimal_control_srv_;
   ros::ServiceServer tracking_bound_srv_;
@@ -129,8 +178,14 @@ private:
   ros::ServiceServer guaranteed_switching_time_srv_;
   ros::ServiceServer guaranteed_switching_distance_srv_;
   ros::ServiceServer priority_srv_;
+  ros::ServiceServer optimal_control_and_priority_srv_;
   ros::ServiceServer max_planner_speed_srv_;
   ros::ServiceServer best_possible_time_srv_;
+  ros::ServiceServer num_values_srv_;
+  ros::ServiceServer optimal_control_batch_srv_;
+  ros::ServiceServer priority_batch_srv_;
+  ros::ServiceServer best_possible_time_batch_srv_;
+  ros::ServiceServer switching_tracking_bound_batch_srv_;
 
   std::string optimal_control_name_;
   std::string tracking_bound_name_;
@@ -138,24 +193,20 @@ private:
   std::string guaranteed_switching_time_name_;
   std::string guaranteed_switching_distance_name_;
   std::string priority_name_;
+  std::string optimal_control_and_priority_name_;
   std::string max_planner_speed_name_;
   std::string best_possible_time_name_;
-
-  // Numerical mode flag and associated parameters for both analytic
-  // and numerical modes.
-  bool numerical_mode_;
-  std::vector<std::string> value_dirs_;
-  std::vector<double> max_planner_speeds_;
-  std::vector<double> max_velocity_disturbances_;
-  std::vector<double> max_acceleration_disturbances_;
-
-  // Control upper/lower bounds.
-  size_t control_dim_, state_dim_;
-  std::vector<double> control_upper_;
-  std::vector<double> control_lower_;
-
-  // List of value functions.
-  std::vector<ValueFunction::ConstPtr> values_;
+  std::string num_values_name_;
+  std::string optimal_control_batch_name_;
+  std::string priority_batch_name_;
+  std::string best_possible_time_batch_name_;
+  std::string switching_tracking_bound_batch_name_;
+
+  // Thread pools serving each callback queue.
+  std::unique_ptr<ros::AsyncSpinner> control_spinner_;
+  std::unique_ptr<ros::AsyncSpinner> planner_spinner_;
+  int num_control_threads_;
+  int num_planner_threads_;
 
   // Initialization and naming.
   bool initialized_;
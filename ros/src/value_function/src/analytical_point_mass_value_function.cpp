@@ -46,6 +46,7 @@
 ///////////////////////////////////////////////////////////////////////////////
 
 #include <value_function/analytical_point_mass_value_function.h>
+#include <value_function/simd.h>
 
 namespace meta {
 
@@ -79,23 +80,8 @@ double AnalyticalPointMassValueFunction::
 Value(const VectorXd& state) const {
   double V = -std::numeric_limits<double>::infinity();
   for (size_t dim = 0; dim < p_dim_; dim++){
-    const double x = state(dim);
-    const double v = state(p_dim_ + dim);
-    const double v_ref = max_planner_speed_(dim);
-
-    // Value surface A: + for x "below" convex Acceleration parabola.
-    const double V_A = -x +
-      (0.5 * (v - v_ref)*(v - v_ref) - v_ref*v_ref) /
-      (a_max_(dim) - d_a_(dim)) - x_exp_(dim);
-    //    const double V_A = ( 1/2*pow(v-v_ref,2) - pow(v_ref,2) )
-    //      /   ( a_max_(dim) - d_a_(dim) ) - x;
-
-    // Value surface B: + for x "above" concave Braking parabola.
-    const double V_B = x -
-      (-0.5 * (v + v_ref)*(v + v_ref) + v_ref*v_ref) /
-      (a_max_(dim) - d_a_(dim)) + x_exp_(dim);
-    //    const double V_B = x - ( -1/2*pow(v+v_ref,2) + pow(v_ref,2) )
-    //      /   ( a_max_(dim) - d_a_(dim) );
+    double V_A, V_B;
+    Surfaces(state(dim), state(p_dim_ + dim), dim, V_A, V_B);
 
     // Value function is the maximum of the above two surfaces.
     const double V_this_dim = std::max(V_A, V_B);
@@ -111,24 +97,17 @@ Gradient(const VectorXd& state) const {
 
   // Loop through each subsystem and populate grad_V.
   for (size_t dim = 0; dim < p_dim_; dim++){
-    const double x = state(dim);
     const double v = state(p_dim_ + dim);
     const double v_ref = max_planner_speed_(dim);
 
-    // Value surface A: + for x "below" convex Acceleration parabola.
-    const double V_A = -x +
-      (0.5 * (v - v_ref)*(v - v_ref) - v_ref*v_ref) /
-      (a_max_(dim) - d_a_(dim)) - x_exp_(dim);
-    // Value surface B: + for x "above" concave Braking parabola.
-    const double V_B = x -
-      (-0.5 * (v + v_ref)*(v + v_ref) + v_ref*v_ref) /
-      (a_max_(dim) - d_a_(dim)) + x_exp_(dim);
+    double V_A, V_B;
+    Surfaces(state(dim), v, dim, V_A, V_B);
     if (V_A > V_B) {
       grad_V(dim) = -1.0;         // if on A side, grad points towards -pos
-      grad_V(p_dim_ + dim) = (v - v_ref) / (a_max_(dim) - d_a_(dim));
+      grad_V(p_dim_ + dim) = (v - v_ref) * inv_accel_(dim);
     } else {
       grad_V(dim) = 1.0;          // if on B side, grad points towards +pos
-      grad_V(p_dim_ + dim) = (v + v_ref) / (a_max_(dim) - d_a_(dim));
+      grad_V(p_dim_ + dim) = (v + v_ref) * inv_accel_(dim);
     }
   }
 
@@ -142,33 +121,16 @@ OptimalControl(const VectorXd& state) const {
 
   for (size_t dim = 0; dim < p_dim_; dim++){
     const double x = state(dim);
-    const double v = state(p_dim_+dim);
-    const double v_ref = max_planner_speed_(dim);
-    VectorXd grad_V = VectorXd::Zero(x_dim_);
 
-    // Value surface A: + for x "below" convex Acceleration parabola.
-    const double V_A = -x +
-      (0.5 * (v - v_ref)*(v - v_ref) - v_ref*v_ref) /
-      (a_max_(dim) - d_a_(dim)) - x_exp_(dim);
-    // Value surface B: + for x "above" concave Braking parabola.
-    const double V_B = x -
-      (-0.5 * (v + v_ref)*(v + v_ref) + v_ref*v_ref) /
-      (a_max_(dim) - d_a_(dim)) + x_exp_(dim);
-    const double V = std::max(V_A,V_B);
-    // Determine acceleration and deceleration input in this dimension
-    const double u_acc = u2a_(dim) > 0.0 ? u_max_(dim) : u_min_(dim);
-    const double u_dec = u2a_(dim) > 0.0 ? u_min_(dim) : u_max_(dim);
-    // Inside rule
-    //    if (V <= 0)
-    if (false)
-      u_opt(dim) = (V_A > V_B) ? u_acc : u_dec;
-    // Outside rule
-    else {
-      if (x >= 0) // If A-curve can catch you brake, else accelerate.
-        u_opt(dim) = (V_A < 0) ? u_dec : u_acc;
-      else // If B-curve can catch you accelerate, else brake.
-        u_opt(dim) = (V_B < 0) ? u_acc : u_dec;
-    } // if V <= 0, else
+    double V_A, V_B;
+    Surfaces(x, state(p_dim_ + dim), dim, V_A, V_B);
+
+    // Outside rule. (The inside rule, which picks u_acc on the A side and
+    // u_dec on the B side when V <= 0, is currently disabled.)
+    if (x >= 0) // If A-curve can catch you brake, else accelerate.
+      u_opt(dim) = (V_A < 0) ? u_dec_(dim) : u_acc_(dim);
+    else // If B-curve can catch you accelerate, else brake.
+      u_opt(dim) = (V_B < 0) ? u_acc_(dim) : u_dec_(dim);
   } // for dim
 
   return u_opt;
@@ -179,21 +141,135 @@ OptimalControl(const VectorXd& state) const {
 // the optimal control signal computed by this value function.
 double AnalyticalPointMassValueFunction::
 Priority(const VectorXd& state) const {
-  const double V = Value(state);
+  return PriorityFromValue(Value(state));
+}
 
-  // HACK! The threshold should probably be externally set via config.
-  const double relative_high = 0.20; // 10% of max inside value
-  const double relative_low  = 0.05; // 5% of max inside value
+// Evaluate value, gradient, optimal control, and priority in a single pass
+// over the spatial dimensions.
+void AnalyticalPointMassValueFunction::
+Evaluate(const VectorXd& state, double& value, VectorXd& gradient,
+         VectorXd& control, double& priority) const {
+  gradient.resize(x_dim_);
+  control.resize(u_dim_);
+
+  value = -std::numeric_limits<double>::infinity();
+  for (size_t dim = 0; dim < p_dim_; dim++) {
+    const double x = state(dim);
+    const double v = state(p_dim_ + dim);
+    const double v_ref = max_planner_speed_(dim);
 
-  const double V_safest = Value(VectorXd::Zero(6));
+    double V_A, V_B;
+    Surfaces(x, v, dim, V_A, V_B);
+    value = std::max(value, std::max(V_A, V_B));
 
-  // BUG! @JFF this needs to be multiplying the MAX V in the set, not the MIN.
-  const double V_high = relative_high * V_safest;
-  const double V_low = relative_low * V_safest;
+    if (V_A > V_B) {
+      gradient(dim) = -1.0;
+      gradient(p_dim_ + dim) = (v - v_ref) * inv_accel_(dim);
+    } else {
+      gradient(dim) = 1.0;
+      gradient(p_dim_ + dim) = (v + v_ref) * inv_accel_(dim);
+    }
+
+    if (x >= 0)
+      control(dim) = (V_A < 0) ? u_dec_(dim) : u_acc_(dim);
+    else
+      control(dim) = (V_B < 0) ? u_acc_(dim) : u_dec_(dim);
+  }
 
-  const double priority = 1.0 -
-                          std::min(std::max(0.0,(V-V_low)/(V_high-V_low)),1.0);
-  return priority;
+  priority = PriorityFromValue(value);
+}
+
+// Batch versions of Value, Gradient, and OptimalControl.
+void AnalyticalPointMassValueFunction::
+ValueBatch(const double* states, size_t num_states, double* values) const {
+  EvaluateBatch(states, num_states, values, nullptr, nullptr);
+}
+
+void AnalyticalPointMassValueFunction::
+GradientBatch(const double* states, size_t num_states,
+              double* gradients) const {
+  EvaluateBatch(states, num_states, nullptr, gradients, nullptr);
+}
+
+void AnalyticalPointMassValueFunction::
+OptimalControlBatch(const double* states, size_t num_states,
+                    double* controls) const {
+  EvaluateBatch(states, num_states, nullptr, nullptr, controls);
+}
+
+// Run the widest available kernel over as many whole blocks as possible,
+// and the scalar kernel over the rest.
+void AnalyticalPointMassValueFunction::
+EvaluateBatch(const double* states, size_t num_states,
+              double* values, double* gradients, double* controls) const {
+  const size_t width = simd::NativeOps::kWidth;
+
+  size_t kk = 0;
+  for (; kk + width <= num_states; kk += width)
+    EvaluateBlock<simd::NativeOps>(states, num_states, kk,
+                                   values, gradients, controls);
+
+  for (; kk < num_states; kk++)
+    EvaluateBlock<simd::ScalarOps>(states, num_states, kk,
+                                   values, gradients, controls);
+}
+
+// Block version of Value, Gradient, and OptimalControl. Performs exactly the
+// same arithmetic as the single-state versions.
+template<class Ops>
+void AnalyticalPointMassValueFunction::
+EvaluateBlock(const double* states, size_t num_states, size_t kk,
+              double* values, double* gradients, double* controls) const {
+  typedef typename Ops::Vec Vec;
+  typedef typename Ops::Mask Mask;
+  const Vec zero = Ops::Set(0.0);
+  const Vec half = Ops::Set(0.5);
+
+  Vec V = Ops::Set(-std::numeric_limits<double>::infinity());
+  for (size_t dim = 0; dim < p_dim_; dim++) {
+    const Vec x = Ops::Load(states + dim * num_states + kk);
+    const Vec v = Ops::Load(states + (p_dim_ + dim) * num_states + kk);
+    const Vec v_ref = Ops::Set(max_planner_speed_(dim));
+    const Vec v_ref_sq = Ops::Mul(v_ref, v_ref);
+    const Vec inv_accel = Ops::Set(inv_accel_(dim));
+    const Vec x_exp = Ops::Set(x_exp_(dim));
+    const Vec v_minus = Ops::Sub(v, v_ref);
+    const Vec v_plus = Ops::Add(v, v_ref);
+
+    // Value surface A: + for x "below" convex Acceleration parabola.
+    const Vec V_A = Ops::Sub(Ops::Add(Ops::Sub(zero, x), Ops::Mul(
+      Ops::Sub(Ops::Mul(Ops::Mul(half, v_minus), v_minus), v_ref_sq),
+      inv_accel)), x_exp);
+
+    // Value surface B: + for x "above" concave Braking parabola.
+    const Vec V_B = Ops::Add(Ops::Sub(x, Ops::Mul(
+      Ops::Add(Ops::Mul(Ops::Mul(Ops::Set(-0.5), v_plus), v_plus), v_ref_sq),
+      inv_accel)), x_exp);
+
+    if (values != nullptr)
+      V = Ops::Max(V, Ops::Max(V_A, V_B));
+
+    if (gradients != nullptr) {
+      const Mask on_A = Ops::Greater(V_A, V_B);
+      Ops::Store(gradients + dim * num_states + kk,
+                 Ops::Select(on_A, Ops::Set(-1.0), Ops::Set(1.0)));
+      Ops::Store(gradients + (p_dim_ + dim) * num_states + kk,
+                 Ops::Mul(Ops::Select(on_A, v_minus, v_plus), inv_accel));
+    }
+
+    if (controls != nullptr) {
+      // If A-curve can catch you brake, else accelerate. Vice versa for B.
+      const Vec u_acc = Ops::Set(u_acc_(dim));
+      const Vec u_dec = Ops::Set(u_dec_(dim));
+      Ops::Store(controls + dim * num_states + kk, Ops::Select(
+        Ops::GreaterEqual(x, zero),
+        Ops::Select(Ops::Less(V_A, zero), u_dec, u_acc),
+        Ops::Select(Ops::Less(V_B, zero), u_acc, u_dec)));
+    }
+  }
+
+  if (values != nullptr)
+    Ops::Store(values + kk, V);
 }
 
 // Get the tracking error bound in this spatial dimension.
@@ -303,6 +379,23 @@ AnalyticalPointMassValueFunction(const Vector3d& max_planner_speed,
   // Expansion of set boundaries in the position dimension
   x_exp_ = expansion_vel.cwiseProduct(2*max_planner_speed + 0.5*expansion_vel)
             .cwiseQuotient(a_max_ - d_a_);
+
+  // Precompute constants used on every query.
+  inv_accel_ = (a_max_ - d_a_).cwiseInverse();
+
+  for (size_t dim = 0; dim < p_dim_; dim++) {
+    u_acc_(dim) = u2a_(dim) > 0.0 ? u_max_(dim) : u_min_(dim);
+    u_dec_(dim) = u2a_(dim) > 0.0 ? u_min_(dim) : u_max_(dim);
+  }
+
+  // HACK! The threshold should probably be externally set via config.
+  const double relative_high = 0.20; // 10% of max inside value
+  const double relative_low  = 0.05; // 5% of max inside value
+
+  // BUG! @JFF this needs to be multiplying the MAX V in the set, not the MIN.
+  V_safest_ = Value(VectorXd::Zero(x_dim_));
+  V_low_ = relative_low * V_safest_;
+  inv_V_range_ = 1.0 / ((relative_high - relative_low) * V_safest_);
 }
 
 } //\namespace meta
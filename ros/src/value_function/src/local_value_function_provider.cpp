@@ -0,0 +1,416 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the LocalValueFunctionProvider class, which inherits from
+// ValueFunctionProvider and holds all value functions in this process.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <value_function/local_value_function_provider.h>
+
+namespace meta {
+
+// Factory method. Use this instead of the constructor.
+LocalValueFunctionProvider::Ptr LocalValueFunctionProvider::Create() {
+  LocalValueFunctionProvider::Ptr ptr(new LocalValueFunctionProvider());
+  return ptr;
+}
+
+// Constructor. Don't use this. Use the factory method instead.
+LocalValueFunctionProvider::LocalValueFunctionProvider()
+  : ValueFunctionProvider() {}
+
+// Initialize this class from a ROS node. Loads all value functions.
+bool LocalValueFunctionProvider::Initialize(const ros::NodeHandle& n) {
+  name_ = ros::names::append(n.getNamespace(), "local_value_functions");
+
+  if (!LoadParameters(n)) {
+    ROS_ERROR("%s: Failed to load parameters.", name_.c_str());
+    return false;
+  }
+
+  // Convert control bounds to Eigen format.
+  VectorXd control_upper_vec(control_dim_);
+  VectorXd control_lower_vec(control_dim_);
+  for (size_t ii = 0; ii < control_dim_; ii++) {
+    control_upper_vec(ii) = control_upper_[ii];
+    control_lower_vec(ii) = control_lower_[ii];
+  }
+
+  // Set up dynamics.
+  NearHoverQuadNoYaw::ConstPtr dynamics =
+    NearHoverQuadNoYaw::Create(control_lower_vec, control_upper_vec);
+
+  // Create value functions.
+  values_.clear();
+  if (numerical_mode_) {
+    if (!LoadNumerical(dynamics))
+      return false;
+  } else {
+    for (size_t ii = 0; ii < max_planner_speeds_.size(); ii++) {
+      // Generate inputs for AnalyticalPointMassValueFunction.
+      // SEMI-HACK! Manually feeding control/disturbance bounds.
+      const Vector3d max_planner_speed =
+        Vector3d::Constant(max_planner_speeds_[ii]);
+      const Vector3d max_velocity_disturbance =
+        Vector3d::Constant(max_velocity_disturbances_[ii]);
+      const Vector3d max_acceleration_disturbance =
+        Vector3d::Constant(max_acceleration_disturbances_[ii]);
+      const Vector3d velocity_expansion = Vector3d::Constant(0.1);
+
+      // Create analytical value function.
+      const AnalyticalPointMassValueFunction::ConstPtr value =
+        AnalyticalPointMassValueFunction::Create(max_planner_speed,
+                                                 max_velocity_disturbance,
+                                                 max_acceleration_disturbance,
+                                                 velocity_expansion,
+                                                 dynamics,
+                                                 static_cast<ValueFunctionId>(ii));
+
+      values_.push_back(value);
+    }
+  }
+
+  // Make sure value functions were provided in pairs.
+  if (values_.size() % 2 != 0) {
+    ROS_ERROR("%s: Must provide value functions in pairs.", name_.c_str());
+    return false;
+  }
+
+  initialized_ = true;
+  return true;
+}
+
+// Load all numerical value functions, with each subsystem file loaded
+// concurrently. Returns whether or not it was successful.
+bool LocalValueFunctionProvider::
+LoadNumerical(const Dynamics::ConstPtr& dynamics) {
+  const ros::WallTime start = ros::WallTime::now();
+
+  // List every subsystem file, and remember which value function it is for.
+  std::vector<std::string> files;
+  std::vector<size_t> owners;
+  for (size_t ii = 0; ii < value_dirs_.size(); ii++) {
+    const std::vector<std::string> dir_files =
+      ValueFunction::SubsystemFiles(value_dirs_[ii]);
+
+    if (dir_files.empty()) {
+      ROS_ERROR("%s: No valid files in directory %s.",
+                name_.c_str(), value_dirs_[ii].c_str());
+      return false;
+    }
+
+    files.insert(files.end(), dir_files.begin(), dir_files.end());
+    owners.insert(owners.end(), dir_files.size(), ii);
+  }
+
+  // Load files on a pool of worker threads, each taking the next file
+  // until none remain.
+  std::vector<SubsystemValueFunction::ConstPtr> subsystems(files.size());
+  std::vector<double> load_times(files.size(), 0.0);
+  std::atomic<size_t> next_file(0);
+
+  const auto worker = [&]() {
+    for (size_t ii = next_file++; ii < files.size(); ii = next_file++) {
+      const ros::WallTime file_start = ros::WallTime::now();
+      subsystems[ii] = SubsystemValueFunction::Create(files[ii], true,
+                                                      lazy_load_);
+      load_times[ii] = (ros::WallTime::now() - file_start).toSec();
+    }
+  };
+
+  const size_t num_threads = std::min(num_load_threads_, files.size());
+  std::vector<std::thread> threads;
+  for (size_t ii = 1; ii < num_threads; ii++)
+    threads.emplace_back(worker);
+
+  worker();
+  for (auto& thread : threads)
+    thread.join();
+
+  // Report per-file timings.
+  for (size_t ii = 0; ii < files.size(); ii++) {
+    ROS_INFO("%s: Loaded %s in %.1f ms%s.", name_.c_str(), files[ii].c_str(),
+             1e3 * load_times[ii], (lazy_load_) ? " (deferred)" : "");
+  }
+
+  // Assemble value functions.
+  for (size_t ii = 0; ii < value_dirs_.size(); ii++) {
+    std::vector<SubsystemValueFunction::ConstPtr> owned;
+    for (size_t jj = 0; jj < files.size(); jj++) {
+      if (owners[jj] == ii)
+        owned.push_back(std::move(subsystems[jj]));
+    }
+
+    values_.push_back(ValueFunction::Create(
+      std::move(owned), dynamics, state_dim_, control_dim_,
+      static_cast<ValueFunctionId>(ii)));
+
+    if (!values_.back()->IsInitialized()) {
+      ROS_ERROR("%s: Could not load value function from %s.",
+                name_.c_str(), value_dirs_[ii].c_str());
+      return false;
+    }
+  }
+
+  ROS_INFO("%s: Loaded %zu files for %zu value functions on %zu threads "
+           "in %.1f ms.", name_.c_str(), files.size(), value_dirs_.size(),
+           num_threads, 1e3 * (ros::WallTime::now() - start).toSec());
+  return true;
+}
+
+// Load parameters.
+bool LocalValueFunctionProvider::LoadParameters(const ros::NodeHandle& n) {
+  ros::NodeHandle nl(n);
+
+  // Numerical mode flag and associated parameters for loading value functions.
+  if (!nl.getParam("numerical_mode", numerical_mode_)) return false;
+  if (!nl.getParam("planners/value_directories", value_dirs_)) return false;
+
+  if (value_dirs_.size() == 0) {
+    ROS_ERROR("%s: Must specify at least one value function directory.",
+              name_.c_str());
+    return false;
+  }
+
+  // Loading options. By default, use one thread per core.
+  int num_load_threads = 0;
+  nl.param("value_function/load_threads", num_load_threads, 0);
+  num_load_threads_ = (num_load_threads > 0) ?
+    static_cast<size_t>(num_load_threads) :
+    std::max(1u, std::thread::hardware_concurrency());
+
+  nl.param("value_function/lazy_load", lazy_load_, false);
+
+  if (!nl.getParam("planners/max_speeds", max_planner_speeds_)) return false;
+  if (!nl.getParam("planners/max_velocity_disturbances",
+                   max_velocity_disturbances_)) return false;
+  if (!nl.getParam("planners/max_acceleration_disturbances",
+                   max_acceleration_disturbances_)) return false;
+
+  if (max_planner_speeds_.size() != max_velocity_disturbances_.size() ||
+      max_planner_speeds_.size() != max_acceleration_disturbances_.size()) {
+    ROS_ERROR("%s: Must specify max speed/velocity/acceleration disturbances.",
+              name_.c_str());
+    return false;
+  }
+
+  // Dimensions and control bounds.
+  int dimension = 1;
+  if (!nl.getParam("control/dim", dimension)) return false;
+  control_dim_ = static_cast<size_t>(dimension);
+
+  if (!nl.getParam("state/dim", dimension)) return false;
+  state_dim_ = static_cast<size_t>(dimension);
+
+  if (!nl.getParam("control/upper", control_upper_)) return false;
+  if (!nl.getParam("control/lower", control_lower_)) return false;
+
+  if (control_upper_.size() != control_dim_ ||
+      control_lower_.size() != control_dim_) {
+    ROS_ERROR("%s: Upper and/or lower bounds are in the wrong dimension.",
+              name_.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+// Check that this ID refers to a loaded value function.
+bool LocalValueFunctionProvider::IsValidId(ValueFunctionId id) const {
+  if (id >= values_.size()) {
+    ROS_ERROR_THROTTLE(1.0, "%s: Invalid value function ID %zu.",
+                       name_.c_str(), id);
+    return false;
+  }
+
+  return true;
+}
+
+// Get the optimal control at a particular (relative) state.
+bool LocalValueFunctionProvider::
+OptimalControl(ValueFunctionId id, const VectorXd& state,
+               VectorXd& control) const {
+  if (!IsValidId(id))
+    return false;
+
+  control = values_[id]->OptimalControl(state);
+  return true;
+}
+
+// Priority of the optimal control at the given state.
+bool LocalValueFunctionProvider::
+Priority(ValueFunctionId id, const VectorXd& state, double& priority) const {
+  if (!IsValidId(id))
+    return false;
+
+  priority = values_[id]->Priority(state);
+  return true;
+}
+
+// Optimal control and its priority at the given state, from a single
+// fused evaluation.
+bool LocalValueFunctionProvider::
+OptimalControlAndPriority(ValueFunctionId id, const VectorXd& state,
+                          VectorXd& control, double& priority) const {
+  if (!IsValidId(id))
+    return false;
+
+  // Scratch space, so that repeated queries on each thread do not allocate.
+  static thread_local VectorXd gradient;
+  gradient.resize(state_dim_);
+  control.resize(control_dim_);
+
+  double value;
+  values_[id]->Evaluate(state, value, gradient, control, priority);
+  return true;
+}
+
+// Get the tracking error bound in each spatial dimension.
+bool LocalValueFunctionProvider::
+TrackingBound(ValueFunctionId id, Vector3d& bound) const {
+  if (!IsValidId(id))
+    return false;
+
+  for (size_t ii = 0; ii < 3; ii++)
+    bound(ii) = values_[id]->TrackingBound(ii);
+
+  return true;
+}
+
+// Get the tracking error bound in each spatial dimension for a planner
+// switching from one value function INTO another.
+bool LocalValueFunctionProvider::
+SwitchingTrackingBound(ValueFunctionId from_id, ValueFunctionId to_id,
+                       Vector3d& bound) const {
+  if (!IsValidId(from_id) || !IsValidId(to_id))
+    return false;
+
+  // Check which mode we're in.
+  if (numerical_mode_) {
+    for (size_t ii = 0; ii < 3; ii++)
+      bound(ii) = values_[to_id]->SwitchingTrackingBound(ii, values_[from_id]);
+  } else {
+    const auto cast_to = std::static_pointer_cast<
+      const AnalyticalPointMassValueFunction>(values_[to_id]);
+    const auto cast_from = std::static_pointer_cast<
+      const AnalyticalPointMassValueFunction>(values_[from_id]);
+
+    for (size_t ii = 0; ii < 3; ii++)
+      bound(ii) = cast_to->SwitchingTrackingBound(ii, cast_from);
+  }
+
+  return true;
+}
+
+// Guaranteed time in which a planner with the 'from' value function
+// can switch into the 'to' value function's tracking error bound.
+bool LocalValueFunctionProvider::
+GuaranteedSwitchingTime(ValueFunctionId from_id, ValueFunctionId to_id,
+                        Vector3d& time) const {
+  if (!IsValidId(from_id) || !IsValidId(to_id))
+    return false;
+
+  // Check which mode we're in.
+  if (numerical_mode_) {
+    for (size_t ii = 0; ii < 3; ii++)
+      time(ii) = values_[to_id]->GuaranteedSwitchingTime(ii, values_[from_id]);
+  } else {
+    const auto cast_to = std::static_pointer_cast<
+      const AnalyticalPointMassValueFunction>(values_[to_id]);
+    const auto cast_from = std::static_pointer_cast<
+      const AnalyticalPointMassValueFunction>(values_[from_id]);
+
+    for (size_t ii = 0; ii < 3; ii++)
+      time(ii) = cast_to->GuaranteedSwitchingTime(ii, cast_from);
+  }
+
+  return true;
+}
+
+// Guaranteed distance in which a planner with the 'from' value function
+// can switch into the 'to' value function's safe set.
+bool LocalValueFunctionProvider::
+GuaranteedSwitchingDistance(ValueFunctionId from_id, ValueFunctionId to_id,
+                            Vector3d& distance) const {
+  if (!IsValidId(from_id) || !IsValidId(to_id))
+    return false;
+
+  // Check which mode we're in.
+  if (numerical_mode_) {
+    for (size_t ii = 0; ii < 3; ii++)
+      distance(ii) =
+        values_[to_id]->GuaranteedSwitchingDistance(ii, values_[from_id]);
+  } else {
+    const auto cast_to = std::static_pointer_cast<
+      const AnalyticalPointMassValueFunction>(values_[to_id]);
+    const auto cast_from = std::static_pointer_cast<
+      const AnalyticalPointMassValueFunction>(values_[from_id]);
+
+    for (size_t ii = 0; ii < 3; ii++)
+      distance(ii) = cast_to->GuaranteedSwitchingDistance(ii, cast_from);
+  }
+
+  return true;
+}
+
+// Max planner speed in each spatial dimension.
+bool LocalValueFunctionProvider::
+MaxPlannerSpeed(ValueFunctionId id, Vector3d& speed) const {
+  if (!IsValidId(id))
+    return false;
+
+  for (size_t ii = 0; ii < 3; ii++)
+    speed(ii) = values_[id]->MaxPlannerSpeed(ii);
+
+  return true;
+}
+
+// Compute the shortest possible time to go from start to stop for a
+// geometric planner with the max planner speed for this value function.
+bool LocalValueFunctionProvider::
+BestPossibleTime(ValueFunctionId id, const Vector3d& start,
+                 const Vector3d& stop, double& time) const {
+  if (!IsValidId(id))
+    return false;
+
+  time = values_[id]->BestPossibleTime(start, stop);
+  return true;
+}
+
+} //\namespace meta
@@ -177,4 +177,41 @@ LiftGeometricTrajectory(const std::vector<Vector3d>& positions,
   return full_states;
 }
 
+// Same as above, but with the velocity at each position given.
+std::vector<VectorXd> NearHoverDynamics::LiftGeometricTrajectory(
+  const std::vector<Vector3d>& positions,
+  const std::vector<Vector3d>& velocities,
+  const std::vector<double>& times) const {
+  // Number of entries in trajectory.
+  size_t num_waypoints = positions.size();
+
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (positions.size() != velocities.size() ||
+      positions.size() != times.size()) {
+    ROS_WARN("Inconsistent number of states, velocities and times.");
+    num_waypoints = std::min(num_waypoints,
+                             std::min(velocities.size(), times.size()));
+  }
+#endif
+
+  std::vector<VectorXd> full_states;
+  for (size_t ii = 0; ii < num_waypoints; ii++) {
+    VectorXd full(X_DIM);
+    full(0) = positions[ii](0);
+    full(1) = positions[ii](1);
+    full(2) = positions[ii](2);
+
+    full(3) = velocities[ii](0);
+    full(4) = velocities[ii](1);
+    full(5) = velocities[ii](2);
+
+    // Assume zero yaw.
+    full(6) = 0.0;
+
+    full_states.push_back(full);
+  }
+
+  return full_states;
+}
+
 } //\namespace meta
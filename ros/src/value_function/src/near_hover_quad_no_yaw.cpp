@@ -85,6 +85,25 @@ VectorXd NearHoverQuadNoYaw::OptimalControl(
   return optimal_control;
 }
 
+// Batch version of the above. Each control row depends only on one
+// gradient row, so these loops vectorize without intrinsics.
+void NearHoverQuadNoYaw::
+OptimalControlBatch(const double* states, const double* value_gradients,
+                    size_t x_dim, size_t num_states, double* controls) const {
+  const double* grad_vx = value_gradients + 3 * num_states;
+  const double* grad_vy = value_gradients + 4 * num_states;
+  const double* grad_vz = value_gradients + 5 * num_states;
+  double* pitch = controls;
+  double* roll = controls + num_states;
+  double* thrust = controls + 2 * num_states;
+
+  for (size_t kk = 0; kk < num_states; kk++) {
+    pitch[kk] = (grad_vx[kk] < 0.0) ? upper_u_(0) : lower_u_(0);
+    roll[kk] = (grad_vy[kk] > 0.0) ? upper_u_(1) : lower_u_(1);
+    thrust[kk] = (grad_vz[kk] < 0.0) ? upper_u_(2) : lower_u_(2);
+  }
+}
+
 // Get the corresponding full state dimension to the given spatial dimension.
 size_t NearHoverQuadNoYaw::SpatialDimension(size_t dimension) const {
   if (dimension == 0)
@@ -173,6 +192,40 @@ std::vector<VectorXd> NearHoverQuadNoYaw::LiftGeometricTrajectory(
   return full_states;
 }
 
+// Same as above, but with the velocity at each position given.
+std::vector<VectorXd> NearHoverQuadNoYaw::LiftGeometricTrajectory(
+  const std::vector<Vector3d>& positions,
+  const std::vector<Vector3d>& velocities,
+  const std::vector<double>& times) const {
+  // Number of entries in trajectory.
+  size_t num_waypoints = positions.size();
+
+#ifdef ENABLE_DEBUG_MESSAGES
+  if (positions.size() != velocities.size() ||
+      positions.size() != times.size()) {
+    ROS_WARN("Inconsistent number of states, velocities and times.");
+    num_waypoints = std::min(num_waypoints,
+                             std::min(velocities.size(), times.size()));
+  }
+#endif
+
+  std::vector<VectorXd> full_states;
+  for (size_t ii = 0; ii < num_waypoints; ii++) {
+    VectorXd full(X_DIM);
+    full(0) = positions[ii](0);
+    full(1) = positions[ii](1);
+    full(2) = positions[ii](2);
+
+    full(3) = velocities[ii](0);
+    full(4) = velocities[ii](1);
+    full(5) = velocities[ii](2);
+
+    full_states.push_back(full);
+  }
+
+  return full_states;
+}
+
 // Private constructor. Use the factory method instead.
 NearHoverQuadNoYaw::NearHoverQuadNoYaw(
   const VectorXd& lower_u, const VectorXd& upper_u)
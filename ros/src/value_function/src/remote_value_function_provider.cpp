@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the RemoteValueFunctionProvider class, which inherits from
+// ValueFunctionProvider and forwards state-dependent queries to a
+// ValueFunctionServer. All other queries are answered from a local cache.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <value_function/remote_value_function_provider.h>
+#include <utils/message_interfacing.h>
+
+namespace meta {
+
+// Factory method. Use this instead of the constructor.
+RemoteValueFunctionProvider::Ptr RemoteValueFunctionProvider::Create() {
+  RemoteValueFunctionProvider::Ptr ptr(new RemoteValueFunctionProvider());
+  return ptr;
+}
+
+// Constructor. Don't use this. Use the factory method instead.
+RemoteValueFunctionProvider::RemoteValueFunctionProvider()
+  : ValueFunctionProvider() {}
+
+// Initialize this class from a ROS node. Waits for all named services and
+// fetches all cached tables.
+bool RemoteValueFunctionProvider::Initialize(const ros::NodeHandle& n) {
+  name_ = ros::names::append(n.getNamespace(), "remote_value_functions");
+
+  client_ = ValueFunctionClient::Create();
+  if (!client_->Initialize(n)) {
+    ROS_ERROR("%s: Failed to initialize value function client.",
+              name_.c_str());
+    return false;
+  }
+
+  if (!LoadParameters(n)) {
+    ROS_ERROR("%s: Failed to load parameters.", name_.c_str());
+    return false;
+  }
+
+  if (!RegisterCallbacks(n)) {
+    ROS_ERROR("%s: Failed to register callbacks.", name_.c_str());
+    return false;
+  }
+
+  initialized_ = true;
+  return true;
+}
+
+// Load parameters. Each node only names the services it actually uses, so
+// none of these are required. Cached services are loaded by the client.
+bool RemoteValueFunctionProvider::LoadParameters(const ros::NodeHandle& n) {
+  ros::NodeHandle nl(n);
+
+  nl.param<std::string>("srv/optimal_control", optimal_control_name_, "");
+  nl.param<std::string>("srv/priority", priority_name_, "");
+  nl.param<std::string>("srv/optimal_control_and_priority",
+                        optimal_control_and_priority_name_, "");
+
+  return true;
+}
+
+// Register all callbacks and publishers.
+bool RemoteValueFunctionProvider::RegisterCallbacks(const ros::NodeHandle& n) {
+  ros::NodeHandle nl(n);
+
+  if (!optimal_control_name_.empty()) {
+    ros::service::waitForService(optimal_control_name_.c_str());
+    optimal_control_srv_ = nl.serviceClient<value_function_srvs::OptimalControl>(
+      optimal_control_name_.c_str(), true);
+  }
+
+  if (!priority_name_.empty()) {
+    ros::service::waitForService(priority_name_.c_str());
+    priority_srv_ = nl.serviceClient<value_function_srvs::Priority>(
+      priority_name_.c_str(), true);
+  }
+
+  if (!optimal_control_and_priority_name_.empty()) {
+    ros::service::waitForService(optimal_control_and_priority_name_.c_str());
+    optimal_control_and_priority_srv_ =
+      nl.serviceClient<value_function_srvs::OptimalControlAndPriority>(
+        optimal_control_and_priority_name_.c_str(), true);
+  }
+
+  return true;
+}
+
+// Get the optimal control at a particular (relative) state.
+bool RemoteValueFunctionProvider::
+OptimalControl(ValueFunctionId id, const VectorXd& state,
+               VectorXd& control) const {
+  if (!CheckConnection<value_function_srvs::OptimalControl>(
+        optimal_control_srv_, optimal_control_name_))
+    return false;
+
+  value_function_srvs::OptimalControl c;
+  c.request.state = utils::PackState(state);
+  c.request.id = id;
+
+  if (!optimal_control_srv_.call(c)) {
+    ROS_ERROR("%s: Error calling optimal control server.", name_.c_str());
+    return false;
+  }
+
+  control = utils::Unpack(c.response.control);
+  return true;
+}
+
+// Priority of the optimal control at the given state.
+bool RemoteValueFunctionProvider::
+Priority(ValueFunctionId id, const VectorXd& state, double& priority) const {
+  if (!CheckConnection<value_function_srvs::Priority>(
+        priority_srv_, priority_name_))
+    return false;
+
+  value_function_srvs::Priority p;
+  p.request.state = utils::PackState(state);
+  p.request.id = id;
+
+  if (!priority_srv_.call(p)) {
+    ROS_ERROR("%s: Error calling priority server.", name_.c_str());
+    return false;
+  }
+
+  priority = p.response.priority;
+  return true;
+}
+
+// Optimal control and its priority at the given state, in one service call.
+// Falls back to separate calls if no combined service was named.
+bool RemoteValueFunctionProvider::
+OptimalControlAndPriority(ValueFunctionId id, const VectorXd& state,
+                          VectorXd& control, double& priority) const {
+  if (optimal_control_and_priority_name_.empty())
+    return ValueFunctionProvider::OptimalControlAndPriority(
+      id, state, control, priority);
+
+  if (!CheckConnection<value_function_srvs::OptimalControlAndPriority>(
+        optimal_control_and_priority_srv_,
+        optimal_control_and_priority_name_))
+    return false;
+
+  value_function_srvs::OptimalControlAndPriority cp;
+  cp.request.state = utils::PackState(state);
+  cp.request.id = id;
+
+  if (!optimal_control_and_priority_srv_.call(cp)) {
+    ROS_ERROR("%s: Error calling optimal control and priority server.",
+              name_.c_str());
+    return false;
+  }
+
+  control = utils::Unpack(cp.response.control);
+  priority = cp.response.priority;
+  return true;
+}
+
+// Get the tracking error bound in each spatial dimension.
+bool RemoteValueFunctionProvider::
+TrackingBound(ValueFunctionId id, Vector3d& bound) const {
+  return client_->TrackingBound(id, bound);
+}
+
+// Get the tracking error bound in each spatial dimension for a planner
+// switching from one value function INTO another.
+bool RemoteValueFunctionProvider::
+SwitchingTrackingBound(ValueFunctionId from_id, ValueFunctionId to_id,
+                       Vector3d& bound) const {
+  return client_->SwitchingTrackingBound(from_id, to_id, bound);
+}
+
+// Guaranteed time in which a planner with the 'from' value function
+// can switch into the 'to' value function's tracking error bound.
+bool RemoteValueFunctionProvider::
+GuaranteedSwitchingTime(ValueFunctionId from_id, ValueFunctionId to_id,
+                        Vector3d& time) const {
+  return client_->GuaranteedSwitchingTime(from_id, to_id, time);
+}
+
+// Guaranteed distance in which a planner with the 'from' value function
+// can switch into the 'to' value function's safe set.
+bool RemoteValueFunctionProvider::
+GuaranteedSwitchingDistance(ValueFunctionId from_id, ValueFunctionId to_id,
+                            Vector3d& distance) const {
+  return client_->GuaranteedSwitchingDistance(from_id, to_id, distance);
+}
+
+// Max planner speed in each spatial dimension.
+bool RemoteValueFunctionProvider::
+MaxPlannerSpeed(ValueFunctionId id, Vector3d& speed) const {
+  return client_->MaxPlannerSpeed(id, speed);
+}
+
+// Compute the shortest possible time to go from start to stop for a
+// geometric planner with the max planner speed for this value function.
+bool RemoteValueFunctionProvider::
+BestPossibleTime(ValueFunctionId id, const Vector3d& start,
+                 const Vector3d& stop, double& time) const {
+  return client_->BestPossibleTime(id, start, stop, time);
+}
+
+} //\namespace meta
@@ -42,22 +42,122 @@
 
 #include <value_function/subsystem_value_function.h>
 
+#include <fstream>
+#include <cstring>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
 namespace meta {
 
+namespace {
+
+// Binary grid file format. All fields are native-endian.
+//
+//   GridFileHeader
+//   double  grid_min[num_dims]
+//   double  grid_max[num_dims]
+//   uint64  grid_N[num_dims]
+//   uint64  x_dims[num_dims]
+//   uint64  u_dims[num_controls]
+//   double  teb[num_teb]
+//   double  max_planner_speed[num_speeds]
+//   zero padding up to voxel_offset, which is a multiple of 64 bytes
+//   double  voxels[num_voxels * voxel_stride]
+//
+// Each voxel record holds the value, then each gradient component, then
+// zero padding, exactly as in the in-memory interleaved layout.
+const char kGridFileMagic[8] = { 'M', 'E', 'T', 'A', 'G', 'R', 'I', 'D' };
+const uint32_t kGridFileVersion = 1;
+const size_t kGridFileAlignment = 64;
+
+struct GridFileHeader {
+  char magic[8];
+  uint32_t version;
+  uint32_t header_size;
+  uint32_t num_dims;
+  uint32_t num_controls;
+  uint32_t num_teb;
+  uint32_t num_speeds;
+  uint64_t num_voxels;
+  uint64_t voxel_stride;
+  uint64_t voxel_offset;
+  double priority_lower;
+  double priority_upper;
+};
+
+// Does this file name have the binary grid file extension?
+bool IsGridFile(const std::string& file_name) {
+  const std::string extension = ".grid";
+  return file_name.size() >= extension.size() &&
+    file_name.compare(file_name.size() - extension.size(),
+                      extension.size(), extension) == 0;
+}
+
+} //\namespace
+
 // Factory method. Use this instead of the constructor.
 // Note that this class is const-only, which means that once it is
 // instantiated it can never be changed.
 SubsystemValueFunction::ConstPtr SubsystemValueFunction::
-Create(const std::string& file_name) {
-  SubsystemValueFunction::ConstPtr ptr(new SubsystemValueFunction(file_name));
+Create(const std::string& file_name, bool interleaved, bool lazy) {
+  SubsystemValueFunction::ConstPtr ptr(
+    new SubsystemValueFunction(file_name, interleaved, lazy));
   return ptr;
 }
 
 // Constructor. Don't use this. Use the factory method instead.
-SubsystemValueFunction::SubsystemValueFunction(const std::string& file_name)
-  : tracking_bound_(0.0),
+SubsystemValueFunction::SubsystemValueFunction(const std::string& file_name,
+                                               bool interleaved, bool lazy)
+  : interleaved_(interleaved),
+    voxel_stride_(0),
+    voxels_(nullptr),
+    mapping_(nullptr),
+    mapping_size_(0),
+    tracking_bound_(0.0),
+    lazy_(lazy && !IsGridFile(file_name)),
+    file_name_(file_name),
     initialized_(Load(file_name)) {}
 
+// Destructor. Unmaps the grid file, if any.
+SubsystemValueFunction::~SubsystemValueFunction() {
+  if (mapping_ != nullptr)
+    munmap(mapping_, mapping_size_);
+}
+
+// Pack data_ and gradient_ into interleaved voxel records, and release
+// the separate arrays.
+void SubsystemValueFunction::Interleave() {
+  const size_t kAlignmentBytes = 64;
+
+  // Round each record up to a multiple of 32 bytes.
+  voxel_stride_ = 4 * ((gradient_.size() + 4) / 4);
+
+  // Over-allocate so that we can align the start of the first record.
+  voxel_storage_.assign(voxel_stride_ * data_.size() +
+                        kAlignmentBytes / sizeof(double), 0.0);
+
+  const size_t address = reinterpret_cast<size_t>(voxel_storage_.data());
+  const size_t offset =
+    ((kAlignmentBytes - address % kAlignmentBytes) % kAlignmentBytes) /
+    sizeof(double);
+  double* voxels = voxel_storage_.data() + offset;
+
+  for (size_t ii = 0; ii < data_.size(); ii++) {
+    double* voxel = voxels + ii * voxel_stride_;
+    voxel[0] = data_[ii];
+
+    for (size_t jj = 0; jj < gradient_.size(); jj++)
+      voxel[1 + jj] = gradient_[jj][ii];
+  }
+
+  voxels_ = voxels;
+  std::vector<double>().swap(data_);
+  std::vector< std::vector<double> >().swap(gradient_);
+}
+
 // Priority of the optimal control at the given state. This is a number
 // between 0 and 1, where 1 means the final control signal should be exactly
 // the optimal control signal computed by this value function.
@@ -189,13 +289,423 @@ RecursiveGradientInterpolator(const VectorXd& x, size_t idx) const {
 
 // Linearly interpolate to get the value at a particular state.
 double SubsystemValueFunction::Value(const VectorXd& state) const {
+  EnsureLoaded();
+
+  switch (state_dimensions_.size()) {
+  case 1:
+    return FixedValue<1>(state);
+  case 2:
+    return FixedValue<2>(state);
+  case 3:
+    return FixedValue<3>(state);
+  case 4:
+    return FixedValue<4>(state);
+  default:
+    return GenericValue(state);
+  }
+}
+
+// Linearly interpolate to get the gradient at a particular state.
+VectorXd SubsystemValueFunction::Gradient(const VectorXd& state) const {
+  EnsureLoaded();
+  VectorXd gradient(state_dimensions_.size());
+
+  switch (state_dimensions_.size()) {
+  case 1:
+    FixedGradient<1>(state, gradient.data());
+    return gradient;
+  case 2:
+    FixedGradient<2>(state, gradient.data());
+    return gradient;
+  case 3:
+    FixedGradient<3>(state, gradient.data());
+    return gradient;
+  case 4:
+    FixedGradient<4>(state, gradient.data());
+    return gradient;
+  default:
+    return GenericGradient(state);
+  }
+}
+
+// Linearly interpolate to get the gradient at a particular state, and write
+// it into the corresponding full state dimensions.
+void SubsystemValueFunction::
+Gradient(const VectorXd& state, VectorXd& gradient) const {
+  EnsureLoaded();
+  double fixed[4];
+
+  switch (state_dimensions_.size()) {
+  case 1:
+    FixedGradient<1>(state, fixed);
+    break;
+  case 2:
+    FixedGradient<2>(state, fixed);
+    break;
+  case 3:
+    FixedGradient<3>(state, fixed);
+    break;
+  case 4:
+    FixedGradient<4>(state, fixed);
+    break;
+  default:
+    const VectorXd generic = GenericGradient(state);
+    for (size_t ii = 0; ii < state_dimensions_.size(); ii++)
+      gradient(state_dimensions_[ii]) = generic(ii);
+    return;
+  }
+
+  for (size_t ii = 0; ii < state_dimensions_.size(); ii++)
+    gradient(state_dimensions_[ii]) = fixed[ii];
+}
+
+// Fixed-dimension value interpolation. Takes the value at the voxel
+// containing the state, and adds a first-order correction along each
+// dimension using a one-sided difference toward the state.
+template<size_t D>
+double SubsystemValueFunction::FixedValue(const VectorXd& state) const {
+  std::array<double, D> punctured;
+  std::array<double, D> center_distance;
+  std::array<size_t, D> quantized;
+
+  size_t index = 0;
+  for (size_t ii = 0; ii < D; ii++) {
+    punctured[ii] = state(state_dimensions_[ii]);
+
+    const double center = lower_[ii] + voxel_size_[ii] *
+      (std::floor((punctured[ii] - lower_[ii]) * inv_voxel_size_[ii]) + 0.5);
+    center_distance[ii] = punctured[ii] - center;
+
+    quantized[ii] = Quantize(punctured[ii], ii);
+    index += quantized[ii] * strides_[ii];
+  }
+
+  // Interpolate.
+  const double nn_value = VoxelValue(index);
+  double approx_value = nn_value;
+
+  for (size_t ii = 0; ii < D; ii++) {
+    const bool forward = center_distance[ii] >= 0.0;
+
+    // Get neighboring value, only changing the index in this dimension.
+    const size_t neighbor_quantized = Quantize(forward ?
+      punctured[ii] + voxel_size_[ii] : punctured[ii] - voxel_size_[ii], ii);
+    const double neighbor_value = VoxelValue(
+      index - quantized[ii] * strides_[ii] + neighbor_quantized * strides_[ii]);
+
+    // Compute one-sided difference.
+    const double slope = inv_voxel_size_[ii] * (forward ?
+      neighbor_value - nn_value : nn_value - neighbor_value);
+
+    // Add to the Taylor approximation.
+    approx_value += slope * center_distance[ii];
+  }
+
+  return approx_value;
+}
+
+// Fixed-dimension gradient interpolation. Multilinear interpolation of the
+// stored gradients at the 2^D voxel centers surrounding the state. This is
+// the closed form of RecursiveGradientInterpolator.
+template<size_t D>
+void SubsystemValueFunction::
+FixedGradient(const VectorXd& state, double* gradient) const {
+  std::array<double, D> fraction;
+  std::array<size_t, D> lower_offset;
+  std::array<size_t, D> upper_offset;
+
+  for (size_t ii = 0; ii < D; ii++) {
+    const double x = state(state_dimensions_[ii]);
+
+    // Grid point (voxel center) at or below x.
+    double lower = lower_[ii] + voxel_size_[ii] *
+      (std::floor((x - lower_[ii]) * inv_voxel_size_[ii]) + 0.5);
+    if (lower > x)
+      lower -= voxel_size_[ii];
+
+    fraction[ii] = (x - lower) * inv_voxel_size_[ii];
+    lower_offset[ii] = Quantize(lower, ii) * strides_[ii];
+    upper_offset[ii] = Quantize(lower + voxel_size_[ii], ii) * strides_[ii];
+  }
+
+  std::fill(gradient, gradient + D, 0.0);
+  for (size_t corner = 0; corner < (1 << D); corner++) {
+    double weight = 1.0;
+    size_t index = 0;
+
+    for (size_t ii = 0; ii < D; ii++) {
+      if (corner & (1 << ii)) {
+        weight *= fraction[ii];
+        index += upper_offset[ii];
+      } else {
+        weight *= 1.0 - fraction[ii];
+        index += lower_offset[ii];
+      }
+    }
+
+    // All components of this corner's gradient are in one record.
+    if (interleaved_) {
+      const double* voxel = voxels_ + index * voxel_stride_ + 1;
+      for (size_t ii = 0; ii < D; ii++)
+        gradient[ii] += weight * voxel[ii];
+    } else {
+      for (size_t ii = 0; ii < D; ii++)
+        gradient[ii] += weight * gradient_[ii][index];
+    }
+  }
+}
+
+// Batch value interpolation. Replaces each entry of 'values' by the max of
+// it and the value at the corresponding state.
+void SubsystemValueFunction::
+MaxValueBatch(const double* states, size_t num_states, double* values) const {
+  EnsureLoaded();
+
+  switch (state_dimensions_.size()) {
+  case 1:
+    FixedMaxValueBatch<1>(states, num_states, values);
+    return;
+  case 2:
+    FixedMaxValueBatch<2>(states, num_states, values);
+    return;
+  case 3:
+    FixedMaxValueBatch<3>(states, num_states, values);
+    return;
+  case 4:
+    FixedMaxValueBatch<4>(states, num_states, values);
+    return;
+  }
+
+  // Generic fallback, one state at a time.
+  const size_t x_dim = 1 + *std::max_element(state_dimensions_.begin(),
+                                             state_dimensions_.end());
+  VectorXd state(VectorXd::Zero(x_dim));
+  for (size_t kk = 0; kk < num_states; kk++) {
+    for (size_t ii : state_dimensions_)
+      state(ii) = states[ii * num_states + kk];
+
+    values[kk] = std::max(values[kk], GenericValue(state));
+  }
+}
+
+// Batch gradient interpolation. Writes the rows of 'gradients'
+// corresponding to this subsystem.
+void SubsystemValueFunction::
+GradientBatch(const double* states, size_t num_states,
+              double* gradients) const {
+  EnsureLoaded();
+
+  switch (state_dimensions_.size()) {
+  case 1:
+    FixedGradientBatch<1>(states, num_states, gradients);
+    return;
+  case 2:
+    FixedGradientBatch<2>(states, num_states, gradients);
+    return;
+  case 3:
+    FixedGradientBatch<3>(states, num_states, gradients);
+    return;
+  case 4:
+    FixedGradientBatch<4>(states, num_states, gradients);
+    return;
+  }
+
+  // Generic fallback, one state at a time.
+  const size_t x_dim = 1 + *std::max_element(state_dimensions_.begin(),
+                                             state_dimensions_.end());
+  VectorXd state(VectorXd::Zero(x_dim));
+  for (size_t kk = 0; kk < num_states; kk++) {
+    for (size_t ii : state_dimensions_)
+      state(ii) = states[ii * num_states + kk];
+
+    const VectorXd gradient = GenericGradient(state);
+    for (size_t ii = 0; ii < state_dimensions_.size(); ii++)
+      gradients[state_dimensions_[ii] * num_states + kk] = gradient(ii);
+  }
+}
+
+// Run the widest available kernel over as many whole blocks as possible,
+// and the scalar kernel over the rest.
+template<size_t D>
+void SubsystemValueFunction::
+FixedMaxValueBatch(const double* states, size_t num_states,
+                   double* values) const {
+  const size_t width = simd::NativeOps::kWidth;
+
+  size_t kk = 0;
+  if (FitsVectorGather()) {
+    for (; kk + width <= num_states; kk += width)
+      MaxValueBlock<simd::NativeOps, D>(states, num_states, kk, values);
+  }
+
+  for (; kk < num_states; kk++)
+    MaxValueBlock<simd::ScalarOps, D>(states, num_states, kk, values);
+}
+
+template<size_t D>
+void SubsystemValueFunction::
+FixedGradientBatch(const double* states, size_t num_states,
+                   double* gradients) const {
+  const size_t width = simd::NativeOps::kWidth;
+
+  size_t kk = 0;
+  if (FitsVectorGather()) {
+    for (; kk + width <= num_states; kk += width)
+      GradientBlock<simd::NativeOps, D>(states, num_states, kk, gradients);
+  }
+
+  for (; kk < num_states; kk++)
+    GradientBlock<simd::ScalarOps, D>(states, num_states, kk, gradients);
+}
+
+// Block version of FixedValue. Performs exactly the same arithmetic, with
+// voxel indices held in doubles so they can be used directly for gathers.
+template<class Ops, size_t D>
+void SubsystemValueFunction::
+MaxValueBlock(const double* states, size_t num_states, size_t kk,
+              double* values) const {
+  typedef typename Ops::Vec Vec;
+  const Vec zero = Ops::Set(0.0);
+  const Vec half = Ops::Set(0.5);
+
+  Vec punctured[D];
+  Vec center_distance[D];
+  Vec quantized[D];
+  Vec index = zero;
+
+  for (size_t ii = 0; ii < D; ii++) {
+    const Vec lower = Ops::Set(lower_[ii]);
+    punctured[ii] = Ops::Load(states + state_dimensions_[ii] * num_states + kk);
+
+    const Vec cell = Ops::Floor(
+      Ops::Mul(Ops::Sub(punctured[ii], lower), Ops::Set(inv_voxel_size_[ii])));
+    const Vec center = Ops::Add(
+      lower, Ops::Mul(Ops::Set(voxel_size_[ii]), Ops::Add(cell, half)));
+    center_distance[ii] = Ops::Sub(punctured[ii], center);
+
+    quantized[ii] = Ops::Min(Ops::Max(cell, zero),
+                             Ops::Set(num_voxels_[ii] - 1));
+    index = Ops::Add(index,
+                     Ops::Mul(quantized[ii], Ops::Set(strides_[ii])));
+  }
+
+  // Interpolate.
+  const double* base = ValueBase();
+  const Vec record_stride = Ops::Set(RecordStride());
+  const Vec nn_value = Ops::Gather(base, Ops::Mul(index, record_stride));
+  Vec approx_value = nn_value;
+
+  for (size_t ii = 0; ii < D; ii++) {
+    const Vec lower = Ops::Set(lower_[ii]);
+    const Vec voxel_size = Ops::Set(voxel_size_[ii]);
+    const Vec inv_voxel_size = Ops::Set(inv_voxel_size_[ii]);
+    const Vec stride = Ops::Set(strides_[ii]);
+    const typename Ops::Mask forward =
+      Ops::GreaterEqual(center_distance[ii], zero);
+
+    // Get neighboring value, only changing the index in this dimension.
+    const Vec neighbor = Ops::Select(forward,
+                                     Ops::Add(punctured[ii], voxel_size),
+                                     Ops::Sub(punctured[ii], voxel_size));
+    const Vec neighbor_quantized = Ops::Min(
+      Ops::Max(Ops::Floor(Ops::Mul(Ops::Sub(neighbor, lower), inv_voxel_size)),
+               zero),
+      Ops::Set(num_voxels_[ii] - 1));
+    const Vec neighbor_index = Ops::Add(
+      Ops::Sub(index, Ops::Mul(quantized[ii], stride)),
+      Ops::Mul(neighbor_quantized, stride));
+    const Vec neighbor_value =
+      Ops::Gather(base, Ops::Mul(neighbor_index, record_stride));
+
+    // Compute one-sided difference, and add to the Taylor approximation.
+    const Vec slope = Ops::Mul(inv_voxel_size, Ops::Select(
+      forward, Ops::Sub(neighbor_value, nn_value),
+      Ops::Sub(nn_value, neighbor_value)));
+    approx_value = Ops::Add(approx_value,
+                            Ops::Mul(slope, center_distance[ii]));
+  }
+
+  Ops::Store(values + kk, Ops::Max(Ops::Load(values + kk), approx_value));
+}
+
+// Block version of FixedGradient.
+template<class Ops, size_t D>
+void SubsystemValueFunction::
+GradientBlock(const double* states, size_t num_states, size_t kk,
+              double* gradients) const {
+  typedef typename Ops::Vec Vec;
+  const Vec zero = Ops::Set(0.0);
+  const Vec one = Ops::Set(1.0);
+
+  Vec fraction[D];
+  Vec lower_offset[D];
+  Vec upper_offset[D];
+
+  for (size_t ii = 0; ii < D; ii++) {
+    const Vec grid_lower = Ops::Set(lower_[ii]);
+    const Vec voxel_size = Ops::Set(voxel_size_[ii]);
+    const Vec inv_voxel_size = Ops::Set(inv_voxel_size_[ii]);
+    const Vec max_quantized = Ops::Set(num_voxels_[ii] - 1);
+    const Vec stride = Ops::Set(strides_[ii]);
+    const Vec x = Ops::Load(states + state_dimensions_[ii] * num_states + kk);
+
+    // Grid point (voxel center) at or below x.
+    Vec lower = Ops::Add(grid_lower, Ops::Mul(voxel_size, Ops::Add(
+      Ops::Floor(Ops::Mul(Ops::Sub(x, grid_lower), inv_voxel_size)),
+      Ops::Set(0.5))));
+    lower = Ops::Select(Ops::Greater(lower, x),
+                        Ops::Sub(lower, voxel_size), lower);
+    const Vec upper = Ops::Add(lower, voxel_size);
+
+    fraction[ii] = Ops::Mul(Ops::Sub(x, lower), inv_voxel_size);
+    lower_offset[ii] = Ops::Mul(stride, Ops::Min(Ops::Max(Ops::Floor(
+      Ops::Mul(Ops::Sub(lower, grid_lower), inv_voxel_size)), zero),
+                                                 max_quantized));
+    upper_offset[ii] = Ops::Mul(stride, Ops::Min(Ops::Max(Ops::Floor(
+      Ops::Mul(Ops::Sub(upper, grid_lower), inv_voxel_size)), zero),
+                                                 max_quantized));
+  }
+
+  Vec gradient[D];
+  for (size_t ii = 0; ii < D; ii++)
+    gradient[ii] = zero;
+
+  const Vec record_stride = Ops::Set(RecordStride());
+  for (size_t corner = 0; corner < (1 << D); corner++) {
+    Vec weight = one;
+    Vec index = zero;
+
+    for (size_t ii = 0; ii < D; ii++) {
+      if (corner & (1 << ii)) {
+        weight = Ops::Mul(weight, fraction[ii]);
+        index = Ops::Add(index, upper_offset[ii]);
+      } else {
+        weight = Ops::Mul(weight, Ops::Sub(one, fraction[ii]));
+        index = Ops::Add(index, lower_offset[ii]);
+      }
+    }
+
+    const Vec record = Ops::Mul(index, record_stride);
+    for (size_t ii = 0; ii < D; ii++) {
+      gradient[ii] = Ops::Add(gradient[ii], Ops::Mul(
+        weight, Ops::Gather(GradientBase(ii), record)));
+    }
+  }
+
+  for (size_t ii = 0; ii < D; ii++)
+    Ops::Store(gradients + state_dimensions_[ii] * num_states + kk,
+               gradient[ii]);
+}
+
+// Generic value interpolation for subsystems of any dimension.
+double SubsystemValueFunction::GenericValue(const VectorXd& state) const {
   const VectorXd punctured = Puncture(state);
 
   // Get distance from voxel center in each dimension.
   const VectorXd center_distance = DistanceToCenter(punctured);
 
   // Interpolate.
-  const double nn_value = data_[StateToIndex(punctured)];
+  const double nn_value = VoxelValue(StateToIndex(punctured));
   double approx_value = nn_value;
 
   VectorXd neighbor = punctured;
@@ -206,7 +716,7 @@ double SubsystemValueFunction::Value(const VectorXd& state) const {
     else
       neighbor(ii) -= voxel_size_[ii];
 
-    const double neighbor_value = data_[StateToIndex(neighbor)];
+    const double neighbor_value = VoxelValue(StateToIndex(neighbor));
     neighbor(ii) = punctured(ii);
 
     // Compute forward difference.
@@ -221,8 +731,8 @@ double SubsystemValueFunction::Value(const VectorXd& state) const {
   return approx_value;
 }
 
-// Linearly interpolate to get the gradient at a particular state.
-VectorXd SubsystemValueFunction::Gradient(const VectorXd& state) const {
+// Generic gradient interpolation for subsystems of any dimension.
+VectorXd SubsystemValueFunction::GenericGradient(const VectorXd& state) const {
   const VectorXd punctured = Puncture(state);
   const VectorXd gradient = RecursiveGradientInterpolator(punctured, 0);
 
@@ -276,7 +786,7 @@ CentralDifference(const VectorXd& punctured) const {
   // Read the gradient one dimension at a time.
   const size_t idx = StateToIndex(punctured);
   for (size_t ii = 0; ii < gradient.size(); ii++)
-    gradient(ii) = gradient_[ii][idx];
+    gradient(ii) = VoxelGradient(idx, ii);
 
 #if 0
   // Get the value at the voxel containing this state.
@@ -317,9 +827,235 @@ DistanceToCenter(const VectorXd& punctured) const {
 
 
 // Load from file. Returns whether or not it was successful.
-// TODO! Reserve enough space initially for each vector so it does
-// resize so much.
 bool SubsystemValueFunction::Load(const std::string& file_name) {
+  if (IsGridFile(file_name))
+    return LoadMapped(file_name);
+
+  return LoadMat(file_name);
+}
+
+// Compute voxel sizes, reciprocal voxel sizes, and strides from the
+// grid bounds and number of voxels.
+void SubsystemValueFunction::ComputeGridConstants() {
+  voxel_size_.resize(num_voxels_.size());
+  inv_voxel_size_.resize(num_voxels_.size());
+  strides_.resize(num_voxels_.size());
+
+  size_t stride = 1;
+  for (size_t ii = num_voxels_.size(); ii > 0; ii--) {
+    voxel_size_[ii - 1] = (upper_[ii - 1] - lower_[ii - 1]) /
+      static_cast<double>(num_voxels_[ii - 1]);
+    inv_voxel_size_[ii - 1] = 1.0 / voxel_size_[ii - 1];
+    strides_[ii - 1] = stride;
+    stride *= num_voxels_[ii - 1];
+  }
+}
+
+// Memory-map a binary .grid file, and use its voxel records in place.
+bool SubsystemValueFunction::LoadMapped(const std::string& file_name) {
+  const int fd = open(file_name.c_str(), O_RDONLY);
+  if (fd < 0) {
+    ROS_ERROR("Could not open file: %s.", file_name.c_str());
+    return false;
+  }
+
+  struct stat info;
+  if (fstat(fd, &info) != 0 ||
+      static_cast<size_t>(info.st_size) < sizeof(GridFileHeader)) {
+    ROS_ERROR("%s: File is too small.", file_name.c_str());
+    close(fd);
+    return false;
+  }
+
+  mapping_size_ = info.st_size;
+  void* mapping = mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+
+  if (mapping == MAP_FAILED) {
+    ROS_ERROR("%s: Could not map file.", file_name.c_str());
+    return false;
+  }
+
+  mapping_ = mapping;
+  const char* bytes = static_cast<const char*>(mapping_);
+
+  // Check the header.
+  GridFileHeader header;
+  std::memcpy(&header, bytes, sizeof(header));
+
+  if (std::memcmp(header.magic, kGridFileMagic, sizeof(kGridFileMagic)) != 0 ||
+      header.header_size != sizeof(GridFileHeader)) {
+    ROS_ERROR("%s: Not a grid file.", file_name.c_str());
+    return false;
+  }
+
+  if (header.version != kGridFileVersion) {
+    ROS_ERROR("%s: Unsupported grid file version %u (expected %u).",
+              file_name.c_str(), header.version, kGridFileVersion);
+    return false;
+  }
+
+  // The fixed-dimension kernels only handle up to four dimensions.
+  const size_t D = header.num_dims;
+  if (D < 1 || D > 4) {
+    ROS_ERROR("%s: Unsupported number of dimensions %zu.",
+              file_name.c_str(), D);
+    return false;
+  }
+
+  // Make sure the small arrays fit before the voxel records, and the voxel
+  // records fit in the file, before reading any of them. Counts are 32 bits,
+  // so their total cannot overflow.
+  const size_t preamble = sizeof(GridFileHeader) + sizeof(double) *
+    (4 * D + static_cast<size_t>(header.num_controls) + header.num_teb +
+     header.num_speeds);
+
+  if (header.voxel_stride < D + 1 ||
+      header.voxel_offset % kGridFileAlignment != 0 ||
+      header.voxel_offset < preamble ||
+      header.voxel_offset > mapping_size_ ||
+      header.num_voxels > (mapping_size_ - header.voxel_offset) /
+      (header.voxel_stride * sizeof(double))) {
+    ROS_ERROR("%s: Inconsistent grid file header.", file_name.c_str());
+    return false;
+  }
+
+  // Read the small arrays.
+  const char* cursor = bytes + sizeof(GridFileHeader);
+  const auto read_doubles = [&cursor](std::vector<double>& out, size_t n) {
+    out.resize(n);
+    if (n > 0)
+      std::memcpy(out.data(), cursor, n * sizeof(double));
+    cursor += n * sizeof(double);
+  };
+  const auto read_sizes = [&cursor](std::vector<size_t>& out, size_t n) {
+    out.resize(n);
+    for (size_t ii = 0; ii < n; ii++) {
+      uint64_t value;
+      std::memcpy(&value, cursor, sizeof(value));
+      out[ii] = value;
+      cursor += sizeof(value);
+    }
+  };
+
+  read_doubles(lower_, D);
+  read_doubles(upper_, D);
+  read_sizes(num_voxels_, D);
+  read_sizes(state_dimensions_, D);
+  read_sizes(control_dimensions_, header.num_controls);
+  read_doubles(tracking_bound_, header.num_teb);
+  read_doubles(max_planner_speed_, header.num_speeds);
+
+  priority_lower_ = header.priority_lower;
+  priority_upper_ = header.priority_upper;
+
+  ComputeGridConstants();
+
+  size_t num_voxels = 1;
+  for (size_t ii = 0; ii < D; ii++)
+    num_voxels *= num_voxels_[ii];
+
+  if (num_voxels != header.num_voxels) {
+    ROS_ERROR("%s: Expected %zu voxels but found %zu.", file_name.c_str(),
+              num_voxels, static_cast<size_t>(header.num_voxels));
+    return false;
+  }
+
+  // Use the voxel records in place.
+  interleaved_ = true;
+  voxel_stride_ = header.voxel_stride;
+  voxels_ = reinterpret_cast<const double*>(bytes + header.voxel_offset);
+
+  return true;
+}
+
+// Write this subsystem to a file in the binary .grid format.
+bool SubsystemValueFunction::Save(const std::string& file_name) const {
+  if (!initialized_) {
+    ROS_ERROR("Cannot save an uninitialized SubsystemValueFunction.");
+    return false;
+  }
+
+  EnsureLoaded();
+
+  std::ofstream file(file_name.c_str(), std::ios::binary | std::ios::trunc);
+  if (!file.is_open()) {
+    ROS_ERROR("Could not open file: %s.", file_name.c_str());
+    return false;
+  }
+
+  const size_t D = state_dimensions_.size();
+  const size_t stride = 4 * ((D + 4) / 4);
+
+  size_t num_voxels = 1;
+  for (size_t ii = 0; ii < D; ii++)
+    num_voxels *= num_voxels_[ii];
+
+  // Size of the header and small arrays, rounded up for the voxel records.
+  const size_t preamble = sizeof(GridFileHeader) +
+    sizeof(double) * (4 * D + control_dimensions_.size() +
+                      tracking_bound_.size() + max_planner_speed_.size());
+
+  GridFileHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kGridFileMagic, sizeof(kGridFileMagic));
+  header.version = kGridFileVersion;
+  header.header_size = sizeof(GridFileHeader);
+  header.num_dims = D;
+  header.num_controls = control_dimensions_.size();
+  header.num_teb = tracking_bound_.size();
+  header.num_speeds = max_planner_speed_.size();
+  header.num_voxels = num_voxels;
+  header.voxel_stride = stride;
+  header.voxel_offset = kGridFileAlignment *
+    ((preamble + kGridFileAlignment - 1) / kGridFileAlignment);
+  header.priority_lower = priority_lower_;
+  header.priority_upper = priority_upper_;
+
+  const auto write_doubles = [&file](const std::vector<double>& values) {
+    file.write(reinterpret_cast<const char*>(values.data()),
+               values.size() * sizeof(double));
+  };
+  const auto write_sizes = [&file](const std::vector<size_t>& values) {
+    for (const size_t value : values) {
+      const uint64_t fixed = value;
+      file.write(reinterpret_cast<const char*>(&fixed), sizeof(fixed));
+    }
+  };
+
+  file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  write_doubles(lower_);
+  write_doubles(upper_);
+  write_sizes(num_voxels_);
+  write_sizes(state_dimensions_);
+  write_sizes(control_dimensions_);
+  write_doubles(tracking_bound_);
+  write_doubles(max_planner_speed_);
+
+  const std::vector<char> padding(header.voxel_offset - preamble, 0);
+  file.write(padding.data(), padding.size());
+
+  // Write voxel records.
+  std::vector<double> record(stride, 0.0);
+  for (size_t ii = 0; ii < num_voxels; ii++) {
+    record[0] = VoxelValue(ii);
+    for (size_t jj = 0; jj < D; jj++)
+      record[1 + jj] = VoxelGradient(ii, jj);
+
+    file.write(reinterpret_cast<const char*>(record.data()),
+               stride * sizeof(double));
+  }
+
+  if (!file.good()) {
+    ROS_ERROR("Error writing file: %s.", file_name.c_str());
+    return false;
+  }
+
+  return true;
+}
+
+// Load from a MATLAB .mat file. Returns whether or not it was successful.
+bool SubsystemValueFunction::LoadMat(const std::string& file_name) {
   // Open the file.
   mat_t* matfp = Mat_Open(file_name.c_str(), MAT_ACC_RDONLY);
   if (matfp == NULL) {
@@ -392,13 +1128,6 @@ bool SubsystemValueFunction::Load(const std::string& file_name) {
     return false;
   }
 
-  const std::string data = "data";
-  matvar_t* data_mat = Mat_VarRead(matfp, data.c_str());
-  if (data_mat == NULL) {
-    ROS_ERROR("Could not read variable: %s.", data.c_str());
-    return false;
-  }
-
   // Populate class variables.
   if (grid_min_mat->data_type != MAT_T_DOUBLE) {
     ROS_ERROR("%s: Wrong type of data.", grid_min.c_str());
@@ -465,7 +1194,7 @@ bool SubsystemValueFunction::Load(const std::string& file_name) {
     return false;
   }
 
-  priority_upper_ = *static_cast<double*>(priority_upper_mat->data);
+  priority_lower_ = *static_cast<double*>(priority_lower_mat->data);
 
   if (priority_upper_mat->data_type != MAT_T_DOUBLE) {
     ROS_ERROR("%s: Wrong type of data.", priority_upper.c_str());
@@ -488,25 +1217,79 @@ bool SubsystemValueFunction::Load(const std::string& file_name) {
     max_planner_speed_.push_back(static_cast<double*>(max_planner_speed_mat->data)[ii]);
   }
 
+  ComputeGridConstants();
+
+  // Read value and gradient arrays now, unless deferred. In that case just
+  // make sure they are present.
+  bool data_ok = true;
+  if (!lazy_) {
+    data_ok = LoadMatData(matfp);
+  } else {
+    for (size_t ii = 0; ii <= num_voxels_.size(); ii++) {
+      const std::string name =
+        (ii == 0) ? "data" : "deriv" + std::to_string(ii - 1);
+      matvar_t* info = Mat_VarReadInfo(matfp, name.c_str());
+      if (info == NULL) {
+        ROS_ERROR("Could not read variable: %s.", name.c_str());
+        data_ok = false;
+        break;
+      }
+
+      Mat_VarFree(info);
+    }
+  }
+
+  // Free memory and close file.
+  Mat_VarFree(grid_min_mat);
+  Mat_VarFree(grid_max_mat);
+  Mat_VarFree(grid_N_mat);
+  Mat_VarFree(x_dims_mat);
+  Mat_VarFree(u_dims_mat);
+  Mat_VarFree(teb_mat);
+  Mat_VarFree(priority_lower_mat);
+  Mat_VarFree(priority_upper_mat);
+  Mat_VarFree(max_planner_speed_mat);
+  Mat_Close(matfp);
+
+  return data_ok;
+}
+
+// Read the value and gradient arrays from an open .mat file.
+bool SubsystemValueFunction::LoadMatData(mat_t* matfp) {
+  size_t num_voxels = 1;
+  for (size_t ii = 0; ii < num_voxels_.size(); ii++)
+    num_voxels *= num_voxels_[ii];
+
+  const std::string data = "data";
+  matvar_t* data_mat = Mat_VarRead(matfp, data.c_str());
+  if (data_mat == NULL) {
+    ROS_ERROR("Could not read variable: %s.", data.c_str());
+    return false;
+  }
+
   if (data_mat->data_type != MAT_T_DOUBLE) {
     ROS_ERROR("%s: Wrong type of data.", data.c_str());
+    Mat_VarFree(data_mat);
     return false;
   }
 
-  num_elements = data_mat->nbytes / data_mat->data_size;
-  for (size_t ii = 0; ii < num_elements; ii++) {
-    // NOTE: Could scale up by a large factor here to improve reliability in
-    // the sign of the interpolated gradients. Seems to have at best only a
-    // minor positive effect on tracking though so reverting to no scaling.
-    data_.push_back(static_cast<double*>(data_mat->data)[ii]);
+  // NOTE: Could scale up by a large factor here to improve reliability in
+  // the sign of the interpolated gradients. Seems to have at best only a
+  // minor positive effect on tracking though so reverting to no scaling.
+  size_t num_elements = data_mat->nbytes / data_mat->data_size;
+  if (num_elements != num_voxels) {
+    ROS_ERROR("%s: Expected %zu elements but found %zu.",
+              data.c_str(), num_voxels, num_elements);
+    Mat_VarFree(data_mat);
+    return false;
   }
 
-  // Determine voxel size.
-  for (size_t ii = 0; ii < num_voxels_.size(); ii++)
-    voxel_size_.push_back((upper_[ii] - lower_[ii]) /
-                          static_cast<double>(num_voxels_[ii]));
+  const double* data_ptr = static_cast<const double*>(data_mat->data);
+  data_.assign(data_ptr, data_ptr + num_elements);
+  Mat_VarFree(data_mat);
 
   // Read gradient information one dimension at a time.
+  gradient_.clear();
   for (size_t ii = 0; ii < num_voxels_.size(); ii++) {
     const std::string deriv = "deriv" + std::to_string(ii);
     matvar_t* deriv_mat = Mat_VarRead(matfp, deriv.c_str());
@@ -516,32 +1299,52 @@ bool SubsystemValueFunction::Load(const std::string& file_name) {
     }
 
     num_elements = deriv_mat->nbytes / deriv_mat->data_size;
-    if (num_elements != data_.size())
+    if (num_elements != data_.size()) {
       ROS_ERROR("Derivative %zu had wrong number of elements.", ii);
-
-    std::vector<double> grad;
-    for (size_t ii = 0; ii < num_elements; ii++) {
-      grad.push_back(static_cast<double*>(deriv_mat->data)[ii]);
+      Mat_VarFree(deriv_mat);
+      return false;
     }
 
-    gradient_.push_back(grad);
+    const double* deriv_ptr = static_cast<const double*>(deriv_mat->data);
+    gradient_.emplace_back(deriv_ptr, deriv_ptr + num_elements);
     Mat_VarFree(deriv_mat);
   }
 
-  // Free memory and close file.
-  Mat_VarFree(grid_min_mat);
-  Mat_VarFree(grid_max_mat);
-  Mat_VarFree(grid_N_mat);
-  Mat_VarFree(x_dims_mat);
-  Mat_VarFree(u_dims_mat);
-  Mat_VarFree(teb_mat);
-  Mat_VarFree(priority_lower_mat);
-  Mat_VarFree(priority_upper_mat);
-  Mat_VarFree(max_planner_speed_mat);
-  Mat_VarFree(data_mat);
-  Mat_Close(matfp);
+  // Pack values and gradients together.
+  if (interleaved_)
+    Interleave();
 
   return true;
 }
 
+// Load deferred value and gradient arrays. Called exactly once. The file
+// was already checked at construction, so failure here means it changed
+// underneath us; fall back to an all-zero grid rather than crash.
+void SubsystemValueFunction::LoadDeferred() {
+  const ros::WallTime start = ros::WallTime::now();
+
+  mat_t* matfp = Mat_Open(file_name_.c_str(), MAT_ACC_RDONLY);
+  const bool success = (matfp != NULL) && LoadMatData(matfp);
+  if (matfp != NULL)
+    Mat_Close(matfp);
+
+  if (!success) {
+    ROS_ERROR("Could not load deferred data from %s. Using zeros.",
+              file_name_.c_str());
+
+    size_t num_voxels = 1;
+    for (size_t ii = 0; ii < num_voxels_.size(); ii++)
+      num_voxels *= num_voxels_[ii];
+
+    data_.assign(num_voxels, 0.0);
+    gradient_.assign(num_voxels_.size(), std::vector<double>(num_voxels, 0.0));
+    if (interleaved_)
+      Interleave();
+    return;
+  }
+
+  ROS_INFO("Loaded deferred data from %s in %.1f ms.", file_name_.c_str(),
+           1e3 * (ros::WallTime::now() - start).toSec());
+}
+
 } //\namespace meta
@@ -43,6 +43,7 @@
 #include <value_function/value_function.h>
 
 #include <boost/filesystem.hpp>
+#include <algorithm>
 
 namespace meta {
 
@@ -54,43 +55,93 @@ namespace fs = boost::filesystem;
 ValueFunction::ConstPtr ValueFunction::
 Create(const std::string& directory, const Dynamics::ConstPtr& dynamics,
        size_t x_dim, size_t u_dim, ValueFunctionId id) {
+  std::vector<SubsystemValueFunction::ConstPtr> subsystems;
+  for (const auto& file : SubsystemFiles(directory))
+    subsystems.push_back(SubsystemValueFunction::Create(file));
+
+  return Create(std::move(subsystems), dynamics, x_dim, u_dim, id);
+}
+
+// Factory method from subsystems that have already been loaded.
+ValueFunction::ConstPtr ValueFunction::
+Create(std::vector<SubsystemValueFunction::ConstPtr>&& subsystems,
+       const Dynamics::ConstPtr& dynamics,
+       size_t x_dim, size_t u_dim, ValueFunctionId id) {
   ValueFunction::ConstPtr ptr(
-    new ValueFunction(directory, dynamics, x_dim, u_dim, id));
+    new ValueFunction(std::move(subsystems), dynamics, x_dim, u_dim, id));
   return ptr;
 }
 
-// Constructor. Don't use this. Use the factory method instead.
-ValueFunction::ValueFunction(const std::string& directory,
-                             const Dynamics::ConstPtr& dynamics,
-                             size_t x_dim, size_t u_dim, ValueFunctionId id)
-  : id_(id),
-    x_dim_(x_dim),
-    u_dim_(u_dim),
-    dynamics_(dynamics),
-    initialized_(true) {
-  // Extract a list of files from this directory.
+namespace {
+
+// Is this .grid file older than the .mat file it was converted from? Then
+// precomputation has been re-run since, and the .mat file should be used.
+bool IsStaleGrid(const fs::path& grid) {
+  const fs::path mat = fs::path(grid).replace_extension(".mat");
+  return fs::is_regular_file(mat) &&
+    fs::last_write_time(grid) < fs::last_write_time(mat);
+}
+
+} //\namespace
+
+// List the subsystem files to load from this precomputation directory.
+// Binary .grid files are memory-mapped, so prefer them over .mat files
+// with the same name, unless they are out of date.
+std::vector<std::string> ValueFunction::
+SubsystemFiles(const std::string& directory) {
   std::vector<std::string> file_names;
   const fs::path path(PRECOMPUTATION_DIR + directory);
+  if (!fs::is_directory(path)) {
+    ROS_ERROR("Not a directory: %s.", path.string().c_str());
+    return file_names;
+  }
+
   for (auto iter = fs::directory_iterator(path);
        iter != fs::directory_iterator();
        iter++) {
-    if (fs::is_regular_file(*iter) && iter->path().extension() == ".mat")
-      file_names.push_back(iter->path().filename().string());
+    if (!fs::is_regular_file(*iter))
+      continue;
+
+    const fs::path& file = iter->path();
+    if (file.extension() == ".grid") {
+      if (!IsStaleGrid(file))
+        file_names.push_back(file.string());
+    } else if (file.extension() == ".mat") {
+      const fs::path grid = fs::path(file).replace_extension(".grid");
+      if (!fs::is_regular_file(grid)) {
+        file_names.push_back(file.string());
+      } else if (IsStaleGrid(grid)) {
+        ROS_WARN("%s is older than %s. Loading the .mat file instead.",
+                 grid.string().c_str(), file.string().c_str());
+        file_names.push_back(file.string());
+      }
+    }
   }
 
-  if (file_names.size() == 0) {
-    ROS_ERROR("No valid files in this directory: %s.",
-              std::string(PRECOMPUTATION_DIR + directory).c_str());
+  // Directory iteration order is unspecified, so sort for repeatability.
+  std::sort(file_names.begin(), file_names.end());
+  return file_names;
+}
+
+// Constructor. Don't use this. Use the factory method instead.
+ValueFunction::ValueFunction(
+  std::vector<SubsystemValueFunction::ConstPtr>&& subsystems,
+  const Dynamics::ConstPtr& dynamics,
+  size_t x_dim, size_t u_dim, ValueFunctionId id)
+  : id_(id),
+    x_dim_(x_dim),
+    u_dim_(u_dim),
+    dynamics_(dynamics),
+    initialized_(true),
+    subsystems_(std::move(subsystems)) {
+  if (subsystems_.size() == 0) {
+    ROS_ERROR("No subsystems for value function %zu.", id_);
     initialized_ = false;
     return;
   }
 
-  // Load each subsystem from file.
-  for (const auto& file : file_names) {
-    subsystems_.push_back(SubsystemValueFunction::Create(
-      PRECOMPUTATION_DIR + directory + file));
-    initialized_ &= subsystems_.back()->IsInitialized();
-  }
+  for (const auto& subsystem : subsystems_)
+    initialized_ &= subsystem->IsInitialized();
 
   // Set max planner speed and check consistency.
   for (size_t ii = 0; ii < 3; ii++) {
@@ -150,7 +201,7 @@ double ValueFunction::VelocityExpansion(size_t dimension) const {
 
 // Combine values of different subsystems.
 double ValueFunction::Value(const VectorXd& state) const {
-  ROS_ERROR("Calling ValueFunction::Value.");
+  ROS_ERROR_ONCE("Calling ValueFunction::Value.");
   double max_value = -std::numeric_limits<double>::infinity();
 
   for (const auto& subsystem : subsystems_)
@@ -161,21 +212,55 @@ double ValueFunction::Value(const VectorXd& state) const {
 
 // Combine gradients from different subsystems.
 VectorXd ValueFunction::Gradient(const VectorXd& state) const {
-  ROS_ERROR("Calling ValueFunction::Gradient.");
+  ROS_ERROR_ONCE("Calling ValueFunction::Gradient.");
   VectorXd gradient(state.size());
 
-  for (const auto& subsystem : subsystems_) {
-    const VectorXd subsystem_gradient = subsystem->Gradient(state);
-    const std::vector<size_t>& dims = subsystem->StateDimensions();
-
-    for (size_t ii = 0; ii < dims.size(); ii++) {
-      gradient(dims[ii]) = subsystem_gradient(ii);
-    }
-  }
+  // Each subsystem writes its own dimensions in place.
+  for (const auto& subsystem : subsystems_)
+    subsystem->Gradient(state, gradient);
 
   return gradient;
 }
 
+// Evaluate value, gradient, optimal control, and priority at once.
+void ValueFunction::Evaluate(const VectorXd& state, double& value,
+                             VectorXd& gradient, VectorXd& control,
+                             double& priority) const {
+  value = Value(state);
+  gradient = Gradient(state);
+  control = dynamics_->OptimalControl(state, gradient);
+  priority = Priority(state);
+}
+
+// Batch value over a structure-of-arrays block of states. The value is the
+// max over subsystems, so each subsystem folds its values in turn.
+void ValueFunction::
+ValueBatch(const double* states, size_t num_states, double* values) const {
+  std::fill(values, values + num_states,
+            -std::numeric_limits<double>::infinity());
+
+  for (const auto& subsystem : subsystems_)
+    subsystem->MaxValueBatch(states, num_states, values);
+}
+
+// Batch gradient. Each subsystem writes its own rows.
+void ValueFunction::
+GradientBatch(const double* states, size_t num_states,
+              double* gradients) const {
+  for (const auto& subsystem : subsystems_)
+    subsystem->GradientBatch(states, num_states, gradients);
+}
+
+// Batch optimal control, from the batch gradient.
+void ValueFunction::
+OptimalControlBatch(const double* states, size_t num_states,
+                    double* controls) const {
+  std::vector<double> gradients(x_dim_ * num_states);
+  GradientBatch(states, num_states, gradients.data());
+  dynamics_->OptimalControlBatch(states, gradients.data(), x_dim_,
+                                 num_states, controls);
+}
+
 // Get the tracking error bound in this spatial dimension.
 double ValueFunction::TrackingBound(size_t dimension) const {
   ROS_ERROR("Calling ValueFunction::TrackingBound.");
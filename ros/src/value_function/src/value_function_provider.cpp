@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2017, The Regents of the University of California (Regents).
+ * All rights reserved.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are
+ * met:
+ *
+ *    1. Redistributions of source code must retain the above copyright
+ *       notice, this list of conditions and the following disclaimer.
+ *
+ *    2. Redistributions in binary form must reproduce the above
+ *       copyright notice, this list of conditions and the following
+ *       disclaimer in the documentation and/or other materials provided
+ *       with the distribution.
+ *
+ *    3. Neither the name of the copyright holder nor the names of its
+ *       contributors may be used to endorse or promote products derived
+ *       from this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS AS IS
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS BE
+ * LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ * CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ * SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ * INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ * CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ * ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+ * POSSIBILITY OF SUCH DAMAGE.
+ *
+ * Please contact the author(s) of this library if you have any questions.
+ * Authors: David Fridovich-Keil   ( dfk@eecs.berkeley.edu )
+ */
+
+///////////////////////////////////////////////////////////////////////////////
+//
+// Defines the ValueFunctionProvider abstract class interface.
+//
+///////////////////////////////////////////////////////////////////////////////
+
+#include <value_function/value_function_provider.h>
+#include <value_function/local_value_function_provider.h>
+#include <value_function/remote_value_function_provider.h>
+
+namespace meta {
+
+// Factory method. Reads the "value_function/in_process" parameter and
+// creates/initializes either an in-process or a remote (service) backend.
+// Returns a null pointer on failure.
+ValueFunctionProvider::ConstPtr
+ValueFunctionProvider::Create(const ros::NodeHandle& n) {
+  ros::NodeHandle nl(n);
+
+  bool in_process = false;
+  nl.param("value_function/in_process", in_process, false);
+
+  ValueFunctionProvider::Ptr ptr;
+  if (in_process)
+    ptr = LocalValueFunctionProvider::Create();
+  else
+    ptr = RemoteValueFunctionProvider::Create();
+
+  if (!ptr->Initialize(n)) {
+    ROS_ERROR("%s: Failed to initialize %s value function provider.",
+              ros::this_node::getName().c_str(),
+              (in_process) ? "in-process" : "remote");
+    return nullptr;
+  }
+
+  return ptr;
+}
+
+// Optimal control and its priority at the given state, in one query.
+bool ValueFunctionProvider::
+OptimalControlAndPriority(ValueFunctionId id, const VectorXd& state,
+                          VectorXd& control, double& priority) const {
+  return OptimalControl(id, state, control) && Priority(id, state, priority);
+}
+
+} //\namespace meta
@@ -46,7 +46,8 @@
 
 namespace meta {
 
-// Initialize this class with all parameters and callbacks.
+// Initialize this class with all parameters and callbacks, and start
+// serving on both thread pools.
 bool ValueFunctionServer::Initialize(const ros::NodeHandle& n) {
   name_ = ros::names::append(n.getNamespace(), "value_function_server");
 
@@ -55,64 +56,26 @@ bool ValueFunctionServer::Initialize(const ros::NodeHandle& n) {
     return false;
   }
 
-  if (!RegisterCallbacks(n)) {
-    ROS_ERROR("%s: Failed to register callbacks.", name_.c_str());
+  // Load all value functions.
+  values_ = LocalValueFunctionProvider::Create();
+  if (!values_->Initialize(n)) {
+    ROS_ERROR("%s: Failed to load value functions.", name_.c_str());
     return false;
   }
 
-  // Convert control bounds to Eigen format.
-  VectorXd control_upper_vec(control_dim_);
-  VectorXd control_lower_vec(control_dim_);
-  for (size_t ii = 0; ii < control_dim_; ii++) {
-    control_upper_vec(ii) = control_upper_[ii];
-    control_lower_vec(ii) = control_lower_[ii];
-  }
-
-  // Set up dynamics.
-  NearHoverQuadNoYaw::ConstPtr dynamics =
-    NearHoverQuadNoYaw::Create(control_lower_vec, control_upper_vec);
-
-  // Create value functions.
-  if (numerical_mode_) {
-    for (size_t ii = 0; ii < value_dirs_.size(); ii++) {
-      const ValueFunction::ConstPtr value =
-        ValueFunction::Create(value_dirs_[ii], dynamics,
-                              state_dim_, control_dim_,
-                              static_cast<ValueFunctionId>(ii));
-
-      values_.push_back(value);
-    }
-  } else {
-    for (size_t ii = 0; ii < max_planner_speeds_.size(); ii++) {
-      // Generate inputs for AnalyticalPointMassValueFunction.
-      // SEMI-HACK! Manually feeding control/disturbance bounds.
-      const Vector3d max_planner_speed =
-        Vector3d::Constant(max_planner_speeds_[ii]);
-      const Vector3d max_velocity_disturbance =
-        Vector3d::Constant(max_velocity_disturbances_[ii]);
-      const Vector3d max_acceleration_disturbance =
-        Vector3d::Constant(max_acceleration_disturbances_[ii]);
-      const Vector3d velocity_expansion = Vector3d::Constant(0.1);
-
-      // Create analytical value function.
-      const AnalyticalPointMassValueFunction::ConstPtr value =
-        AnalyticalPointMassValueFunction::Create(max_planner_speed,
-                                                 max_velocity_disturbance,
-                                                 max_acceleration_disturbance,
-                                                 velocity_expansion,
-                                                 dynamics,
-                                                 static_cast<ValueFunctionId>(ii));
-
-      values_.push_back(value);
-    }
-  }
-
-  // Make sure value functions were provided in pairs.
-  if (values_.size() % 2 != 0) {
-    ROS_ERROR("%s: Must provide value functions in pairs.", name_.c_str());
+  if (!RegisterCallbacks(n)) {
+    ROS_ERROR("%s: Failed to register callbacks.", name_.c_str());
     return false;
   }
 
+  // Start serving.
+  control_spinner_.reset(
+    new ros::AsyncSpinner(num_control_threads_, &control_queue_));
+  planner_spinner_.reset(
+    new ros::AsyncSpinner(num_planner_threads_, &planner_queue_));
+  control_spinner_->start();
+  planner_spinner_->start();
+
   initialized_ = true;
   return true;
 }
@@ -122,9 +85,12 @@ bool ValueFunctionServer::OptimalControlCallback(
   value_function_srvs::OptimalControl::Request& req,
   value_function_srvs::OptimalControl::Response& res) {
   const VectorXd state = utils::Unpack(req.state);
-  const VectorXd control = values_[req.id]->OptimalControl(state);
-  res.control = utils::PackControl(control);
 
+  VectorXd control;
+  if (!values_->OptimalControl(req.id, state, control))
+    return false;
+
+  res.control = utils::PackControl(control);
   return true;
 }
 
@@ -132,10 +98,13 @@ bool ValueFunctionServer::OptimalControlCallback(
 bool ValueFunctionServer::TrackingBoundCallback(
   value_function_srvs::TrackingBoundBox::Request& req,
   value_function_srvs::TrackingBoundBox::Response& res) {
-  res.x = values_[req.id]->TrackingBound(0);
-  res.y = values_[req.id]->TrackingBound(1);
-  res.z = values_[req.id]->TrackingBound(2);
+  Vector3d bound;
+  if (!values_->TrackingBound(req.id, bound))
+    return false;
 
+  res.x = bound(0);
+  res.y = bound(1);
+  res.z = bound(2);
   return true;
 }
 
@@ -144,22 +113,13 @@ bool ValueFunctionServer::TrackingBoundCallback(
 bool ValueFunctionServer::SwitchingTrackingBoundCallback(
   value_function_srvs::SwitchingTrackingBoundBox::Request& req,
   value_function_srvs::SwitchingTrackingBoundBox::Response& res) {
-  // Check which mode we're in.
-  if (numerical_mode_) {
-    res.x = values_[req.to_id]->SwitchingTrackingBound(0, values_[req.from_id]);
-    res.y = values_[req.to_id]->SwitchingTrackingBound(1, values_[req.from_id]);
-    res.z = values_[req.to_id]->SwitchingTrackingBound(2, values_[req.from_id]);
-  } else {
-    const auto cast_to = std::static_pointer_cast<
-      const AnalyticalPointMassValueFunction>(values_[req.to_id]);
-    const auto cast_from = std::static_pointer_cast<
-      const AnalyticalPointMassValueFunction>(values_[req.from_id]);
-
-    res.x = cast_to->SwitchingTrackingBound(0, cast_from);
-    res.y = cast_to->SwitchingTrackingBound(1, cast_from);
-    res.z = cast_to->SwitchingTrackingBound(2, cast_from);
-  }
+  Vector3d bound;
+  if (!values_->SwitchingTrackingBound(req.from_id, req.to_id, bound))
+    return false;
 
+  res.x = bound(0);
+  res.y = bound(1);
+  res.z = bound(2);
   return true;
 }
 
@@ -168,22 +128,13 @@ bool ValueFunctionServer::SwitchingTrackingBoundCallback(
 bool ValueFunctionServer::GuaranteedSwitchingTimeCallback(
   value_function_srvs::GuaranteedSwitchingTime::Request& req,
   value_function_srvs::GuaranteedSwitchingTime::Response& res) {
-  // Check which mode we're in.
-  if (numerical_mode_) {
-    res.x = values_[req.to_id]->GuaranteedSwitchingTime(0, values_[req.from_id]);
-    res.y = values_[req.to_id]->GuaranteedSwitchingTime(1, values_[req.from_id]);
-    res.z = values_[req.to_id]->GuaranteedSwitchingTime(2, values_[req.from_id]);
-  } else {
-    const auto cast_to = std::static_pointer_cast<
-      const AnalyticalPointMassValueFunction>(values_[req.to_id]);
-    const auto cast_from = std::static_pointer_cast<
-      const AnalyticalPointMassValueFunction>(values_[req.from_id]);
-
-    res.x = cast_to->GuaranteedSwitchingTime(0, cast_from);
-    res.y = cast_to->GuaranteedSwitchingTime(1, cast_from);
-    res.z = cast_to->GuaranteedSwitchingTime(2, cast_from);
-  }
+  Vector3d time;
+  if (!values_->GuaranteedSwitchingTime(req.from_id, req.to_id, time))
+    return false;
 
+  res.x = time(0);
+  res.y = time(1);
+  res.z = time(2);
   return true;
 }
 
@@ -192,22 +143,13 @@ bool ValueFunctionServer::GuaranteedSwitchingTimeCallback(
 bool ValueFunctionServer::GuaranteedSwitchingDistanceCallback(
   value_function_srvs::GuaranteedSwitchingDistance::Request& req,
   value_function_srvs::GuaranteedSwitchingDistance::Response& res) {
-  // Check which mode we're in.
-  if (numerical_mode_) {
-    res.x = values_[req.to_id]->GuaranteedSwitchingDistance(0, values_[req.from_id]);
-    res.y = values_[req.to_id]->GuaranteedSwitchingDistance(1, values_[req.from_id]);
-    res.z = values_[req.to_id]->GuaranteedSwitchingDistance(2, values_[req.from_id]);
-  } else {
-    const auto cast_to = std::static_pointer_cast<
-      const AnalyticalPointMassValueFunction>(values_[req.to_id]);
-    const auto cast_from = std::static_pointer_cast<
-      const AnalyticalPointMassValueFunction>(values_[req.from_id]);
-
-    res.x = cast_to->GuaranteedSwitchingDistance(0, cast_from);
-    res.y = cast_to->GuaranteedSwitchingDistance(1, cast_from);
-    res.z = cast_to->GuaranteedSwitchingDistance(2, cast_from);
-  }
+  Vector3d distance;
+  if (!values_->GuaranteedSwitchingDistance(req.from_id, req.to_id, distance))
+    return false;
 
+  res.x = distance(0);
+  res.y = distance(1);
+  res.z = distance(2);
   return true;
 }
 
@@ -218,7 +160,21 @@ bool ValueFunctionServer::PriorityCallback(
   value_function_srvs::Priority::Request& req,
   value_function_srvs::Priority::Response& res) {
   const VectorXd state = utils::Unpack(req.state);
-  res.priority = values_[req.id]->Priority(state);
+  return values_->Priority(req.id, state, res.priority);
+}
+
+// Optimal control and its priority, from one fused evaluation.
+bool ValueFunctionServer::OptimalControlAndPriorityCallback(
+  value_function_srvs::OptimalControlAndPriority::Request& req,
+  value_function_srvs::OptimalControlAndPriority::Response& res) {
+  const VectorXd state = utils::Unpack(req.state);
+
+  VectorXd control;
+  if (!values_->OptimalControlAndPriority(req.id, state, control,
+                                          res.priority))
+    return false;
+
+  res.control = utils::PackControl(control);
   return true;
 }
 
@@ -226,9 +182,13 @@ bool ValueFunctionServer::PriorityCallback(
 bool ValueFunctionServer::MaxPlannerSpeedCallback(
   value_function_srvs::GeometricPlannerSpeed::Request& req,
   value_function_srvs::GeometricPlannerSpeed::Response& res) {
-  res.x = values_[req.id]->MaxPlannerSpeed(0);
-  res.y = values_[req.id]->MaxPlannerSpeed(1);
-  res.z = values_[req.id]->MaxPlannerSpeed(2);
+  Vector3d speed;
+  if (!values_->MaxPlannerSpeed(req.id, speed))
+    return false;
+
+  res.x = speed(0);
+  res.y = speed(1);
+  res.z = speed(2);
   return true;
 }
 
@@ -239,56 +199,131 @@ bool ValueFunctionServer::BestPossibleTimeCallback(
   value_function_srvs::GeometricPlannerTime::Response& res) {
   const Vector3d start = utils::Unpack(req.start);
   const Vector3d stop = utils::Unpack(req.stop);
-  res.time = values_[req.id]->BestPossibleTime(start, stop);
+  return values_->BestPossibleTime(req.id, start, stop, res.time);
+}
 
+// Number of value functions held by this server.
+bool ValueFunctionServer::NumValueFunctionsCallback(
+  value_function_srvs::NumValueFunctions::Request& req,
+  value_function_srvs::NumValueFunctions::Response& res) {
+  res.num_values = values_->NumValueFunctions();
   return true;
 }
 
-// Load parameters.
-bool ValueFunctionServer::LoadParameters(const ros::NodeHandle& n) {
-  ros::NodeHandle nl(n);
+// Get the optimal control at each of a batch of states.
+bool ValueFunctionServer::OptimalControlBatchCallback(
+  value_function_srvs::OptimalControlBatch::Request& req,
+  value_function_srvs::OptimalControlBatch::Response& res) {
+  const size_t num_states = req.ids.size();
+  if (req.states.size() != num_states * req.state_dim) {
+    ROS_ERROR("%s: Expected %zu states of dimension %zu, got %zu entries.",
+              name_.c_str(), num_states, (size_t) req.state_dim,
+              req.states.size());
+    return false;
+  }
 
-  // Numerical mode flag and associated parameters for loading value functions.
-  if (!nl.getParam("numerical_mode", numerical_mode_)) return false;
-  if (!nl.getParam("planners/value_directories", value_dirs_)) return false;
+  VectorXd state(req.state_dim);
+  VectorXd control;
+  for (size_t ii = 0; ii < num_states; ii++) {
+    state = Eigen::Map<const VectorXd>(
+      req.states.data() + ii * req.state_dim, req.state_dim);
 
-  if (value_dirs_.size() == 0) {
-    ROS_ERROR("%s: Must specify at least one value function directory.",
-              name_.c_str());
+    if (!values_->OptimalControl(req.ids[ii], state, control))
+      return false;
+
+    // Size the output from the first control.
+    if (ii == 0) {
+      res.control_dim = control.size();
+      res.controls.resize(num_states * res.control_dim);
+    }
+
+    Eigen::Map<VectorXd>(res.controls.data() + ii * res.control_dim,
+                         res.control_dim) = control;
+  }
+
+  return true;
+}
+
+// Priority of the optimal control at each of a batch of states.
+bool ValueFunctionServer::PriorityBatchCallback(
+  value_function_srvs::PriorityBatch::Request& req,
+  value_function_srvs::PriorityBatch::Response& res) {
+  const size_t num_states = req.ids.size();
+  if (req.states.size() != num_states * req.state_dim) {
+    ROS_ERROR("%s: Expected %zu states of dimension %zu, got %zu entries.",
+              name_.c_str(), num_states, (size_t) req.state_dim,
+              req.states.size());
     return false;
   }
 
-  if (!nl.getParam("planners/max_speeds", max_planner_speeds_)) return false;
-  if (!nl.getParam("planners/max_velocity_disturbances",
-                   max_velocity_disturbances_)) return false;
-  if (!nl.getParam("planners/max_acceleration_disturbances",
-                   max_acceleration_disturbances_)) return false;
+  res.priorities.resize(num_states);
 
-  if (max_planner_speeds_.size() != max_velocity_disturbances_.size() ||
-      max_planner_speeds_.size() != max_acceleration_disturbances_.size()) {
-    ROS_ERROR("%s: Must specify max speed/velocity/acceleration disturbances.",
-              name_.c_str());
+  VectorXd state(req.state_dim);
+  for (size_t ii = 0; ii < num_states; ii++) {
+    state = Eigen::Map<const VectorXd>(
+      req.states.data() + ii * req.state_dim, req.state_dim);
+
+    if (!values_->Priority(req.ids[ii], state, res.priorities[ii]))
+      return false;
+  }
+
+  return true;
+}
+
+// Shortest possible time for each of a batch of (start, stop) pairs.
+bool ValueFunctionServer::BestPossibleTimeBatchCallback(
+  value_function_srvs::GeometricPlannerTimeBatch::Request& req,
+  value_function_srvs::GeometricPlannerTimeBatch::Response& res) {
+  const size_t num_pairs = req.ids.size();
+  if (req.starts.size() != 3 * num_pairs || req.stops.size() != 3 * num_pairs) {
+    ROS_ERROR("%s: Expected %zu start and stop points.",
+              name_.c_str(), num_pairs);
     return false;
   }
 
-  // Dimensions and control bounds.
-  int dimension = 1;
-  if (!nl.getParam("control/dim", dimension)) return false;
-  control_dim_ = static_cast<size_t>(dimension);
+  res.times.resize(num_pairs);
+  for (size_t ii = 0; ii < num_pairs; ii++) {
+    const Vector3d start(
+      Eigen::Map<const Vector3d>(req.starts.data() + 3 * ii));
+    const Vector3d stop(
+      Eigen::Map<const Vector3d>(req.stops.data() + 3 * ii));
 
-  if (!nl.getParam("state/dim", dimension)) return false;
-  state_dim_ = static_cast<size_t>(dimension);
+    if (!values_->BestPossibleTime(req.ids[ii], start, stop, res.times[ii]))
+      return false;
+  }
 
-  if (!nl.getParam("control/upper", control_upper_)) return false;
-  if (!nl.getParam("control/lower", control_lower_)) return false;
+  return true;
+}
 
-  if (control_upper_.size() != control_dim_ ||
-      control_lower_.size() != control_dim_) {
-    ROS_ERROR("%s: Upper and/or lower bounds are in the wrong dimension.",
-              name_.c_str());
+// Switching tracking error bound for each of a batch of ID pairs.
+bool ValueFunctionServer::SwitchingTrackingBoundBatchCallback(
+  value_function_srvs::SwitchingTrackingBoundBoxBatch::Request& req,
+  value_function_srvs::SwitchingTrackingBoundBoxBatch::Response& res) {
+  const size_t num_pairs = req.from_ids.size();
+  if (req.to_ids.size() != num_pairs) {
+    ROS_ERROR("%s: Got %zu from IDs but %zu to IDs.",
+              name_.c_str(), num_pairs, req.to_ids.size());
     return false;
   }
 
+  res.bounds.resize(3 * num_pairs);
+
+  Vector3d bound;
+  for (size_t ii = 0; ii < num_pairs; ii++) {
+    if (!values_->SwitchingTrackingBound(
+          req.from_ids[ii], req.to_ids[ii], bound))
+      return false;
+
+    Eigen::Map<Vector3d>(res.bounds.data() + 3 * ii) = bound;
+  }
+
+  return true;
+}
+
+// Load parameters.
+bool ValueFunctionServer::LoadParameters(const ros::NodeHandle& n) {
+  ros::NodeHandle nl(n);
+
   // Names of all services.
   if (!nl.getParam("srv/optimal_control", optimal_control_name_)) return false;
   if (!nl.getParam("srv/tracking_bound", tracking_bound_name_)) return false;
@@ -299,41 +334,87 @@ bool ValueFunctionServer::LoadParameters(const ros::NodeHandle& n) {
   if (!nl.getParam("srv/guaranteed_switching_distance",
                    guaranteed_switching_distance_name_)) return false;
   if (!nl.getParam("srv/priority", priority_name_)) return false;
+  if (!nl.getParam("srv/optimal_control_and_priority",
+                   optimal_control_and_priority_name_)) return false;
   if (!nl.getParam("srv/max_planner_speed",
                    max_planner_speed_name_)) return false;
   if (!nl.getParam("srv/best_possible_time",
                    best_possible_time_name_)) return false;
+  if (!nl.getParam("srv/num_values", num_values_name_)) return false;
+  if (!nl.getParam("srv/optimal_control_batch",
+                   optimal_control_batch_name_)) return false;
+  if (!nl.getParam("srv/priority_batch", priority_batch_name_)) return false;
+  if (!nl.getParam("srv/best_possible_time_batch",
+                   best_possible_time_batch_name_)) return false;
+  if (!nl.getParam("srv/switching_tracking_bound_batch",
+                   switching_tracking_bound_batch_name_)) return false;
+
+  // Thread pool sizes.
+  nl.param("threads/control", num_control_threads_, 2);
+  nl.param("threads/planner", num_planner_threads_, 1);
+
+  if (num_control_threads_ < 1 || num_planner_threads_ < 1) {
+    ROS_ERROR("%s: Each thread pool needs at least one thread.",
+              name_.c_str());
+    return false;
+  }
 
   return true;
 }
 
-// Set up all servers.
+// Set up all servers. Control services go on the control queue, and
+// everything else goes on the planner queue.
 bool ValueFunctionServer::RegisterCallbacks(const ros::NodeHandle& n) {
-  ros::NodeHandle nl(n);
+  ros::NodeHandle nc(n);
+  nc.setCallbackQueue(&control_queue_);
+
+  ros::NodeHandle np(n);
+  np.setCallbackQueue(&planner_queue_);
 
-  optimal_control_srv_ = nl.advertiseService(
+  // Control services.
+  optimal_control_srv_ = nc.advertiseService(
     optimal_control_name_,
     &ValueFunctionServer::OptimalControlCallback, this);
-  tracking_bound_srv_ = nl.advertiseService(
+  priority_srv_ = nc.advertiseService(
+    priority_name_, &ValueFunctionServer::PriorityCallback, this);
+  optimal_control_and_priority_srv_ = nc.advertiseService(
+    optimal_control_and_priority_name_,
+    &ValueFunctionServer::OptimalControlAndPriorityCallback, this);
+  optimal_control_batch_srv_ = nc.advertiseService(
+    optimal_control_batch_name_,
+    &ValueFunctionServer::OptimalControlBatchCallback, this);
+  priority_batch_srv_ = nc.advertiseService(
+    priority_batch_name_,
+    &ValueFunctionServer::PriorityBatchCallback, this);
+
+  // Planner services.
+  tracking_bound_srv_ = np.advertiseService(
     tracking_bound_name_,
     &ValueFunctionServer::TrackingBoundCallback, this);
-  switching_tracking_bound_srv_ = nl.advertiseService(
+  switching_tracking_bound_srv_ = np.advertiseService(
     switching_tracking_bound_name_,
     &ValueFunctionServer::SwitchingTrackingBoundCallback, this);
-  guaranteed_switching_time_srv_ = nl.advertiseService(
+  guaranteed_switching_time_srv_ = np.advertiseService(
     guaranteed_switching_time_name_,
     &ValueFunctionServer::GuaranteedSwitchingTimeCallback, this);
-  guaranteed_switching_distance_srv_ = nl.advertiseService(
+  guaranteed_switching_distance_srv_ = np.advertiseService(
     guaranteed_switching_distance_name_,
     &ValueFunctionServer::GuaranteedSwitchingDistanceCallback, this);
-  priority_srv_ = nl.advertiseService(
-    priority_name_, &ValueFunctionServer::PriorityCallback, this);
-  max_planner_speed_srv_ = nl.advertiseService(
+  max_planner_speed_srv_ = np.advertiseService(
     max_planner_speed_name_,
     &ValueFunctionServer::MaxPlannerSpeedCallback, this);
-  best_possible_time_srv_ = nl.advertiseService(
+  best_possible_time_srv_ = np.advertiseService(
     best_possible_time_name_,
     &ValueFunctionServer::BestPossibleTimeCallback, this);
+  num_values_srv_ = np.advertiseService(
+    num_values_name_,
+    &ValueFunctionServer::NumValueFunctionsCallback, this);
+  best_possible_time_batch_srv_ = np.advertiseService(
+    best_possible_time_batch_name_,
+    &ValueFunctionServer::BestPossibleTimeBatchCallback, this);
+  switching_tracking_bound_batch_srv_ = np.advertiseService(
+    switching_tracking_bound_batch_name_,
+    &ValueFunctionServer::SwitchingTrackingBoundBatchCallback, this);
 
   return true;
 }